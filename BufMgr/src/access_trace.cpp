@@ -0,0 +1,257 @@
+/**
+ * @author See Contributors.txt for code contributors and overview of BadgerDB.
+ *
+ * @section LICENSE
+ * Copyright (c) 2012 Database Group, Computer Sciences Department, University of Wisconsin-Madison.
+ */
+
+#include "access_trace.h"
+
+#include <cstring>
+
+#include "cycle_clock.h"
+#include "exceptions/file_not_found_exception.h"
+#include "file.h"
+
+namespace badgerdb {
+
+namespace {
+
+/**
+ * Source of tracer generations.
+ */
+std::atomic<std::uint64_t> next_generation(1);
+
+/**
+ * Rings of the calling thread, by generation of the tracer they belong to.
+ * Generations are never reused, so entries of destroyed tracers are never
+ * looked up again.
+ */
+thread_local std::map<std::uint64_t, void*> thread_rings;
+
+/**
+ * Ring of the calling thread in the tracer it last recorded into, which saves
+ * the lookup in thread_rings while a thread keeps to one tracer.
+ */
+thread_local std::uint64_t cached_generation = 0;
+thread_local void* cached_ring = NULL;
+
+/**
+ * Header of every block in a trace file.
+ */
+struct BlockHeader {
+  std::uint32_t type;
+  std::uint32_t length;
+};
+
+}
+
+const char AccessTracer::MAGIC[8] = {'B', 'D', 'B', 'T', 'R', 'C', '0', '1'};
+
+AccessTracer::AccessTracer(const std::string& path,
+                           const std::size_t ring_capacity)
+    : out_(std::fopen(path.c_str(), "wb")),
+      ring_capacity_(ring_capacity),
+      generation_(next_generation++),
+      next_file_number_(0),
+      records_written_(0),
+      stop_drain_(false) {
+  if (out_ == NULL) {
+    throw FileNotFoundException(path);
+  }
+  const double cycles_per_ns = badgerdb::cyclesPerNanosecond();
+  std::fwrite(MAGIC, sizeof(MAGIC), 1, out_);
+  std::fwrite(&cycles_per_ns, sizeof(cycles_per_ns), 1, out_);
+}
+
+AccessTracer::~AccessTracer() {
+  if (drain_thread_.joinable()) {
+    stop_drain_ = true;
+    drain_thread_.join();
+  }
+  flush();
+  std::fclose(out_);
+  for (std::size_t i = 0; i < rings_.size(); ++i) {
+    delete rings_[i];
+  }
+}
+
+void AccessTracer::record(const TraceOp op, const File* file,
+                          const PageId page, const std::uint8_t flags) {
+  ThreadRing* ring = ringForThisThread();
+  const std::uint64_t head = ring->head.load(std::memory_order_relaxed);
+  if (head - ring->tail.load(std::memory_order_acquire) == ring_capacity_) {
+    // Ring is full and nobody has drained it; drain it ourselves rather than
+    // drop events.
+    drain(ring);
+  }
+  // Files are told apart by id, as a new File object may live at the
+  // address of a destroyed one.
+  if (file->id() != ring->last_file_id) {
+    std::map<std::uint64_t, std::uint32_t>::iterator known =
+        ring->file_numbers.find(file->id());
+    if (known == ring->file_numbers.end()) {
+      known = ring->file_numbers.insert(
+          std::make_pair(file->id(), fileNumber(file))).first;
+    }
+    ring->last_file_number = known->second;
+    ring->last_file_id = file->id();
+  }
+
+  TraceRecord& record = ring->records[head % ring_capacity_];
+  record.timestamp = readCycleCounter();
+  record.thread = ring->thread;
+  record.file = ring->last_file_number;
+  record.page = page;
+  record.op = static_cast<std::uint8_t>(op);
+  record.flags = flags;
+  record.reserved = 0;
+  ring->head.store(head + 1, std::memory_order_release);
+}
+
+void AccessTracer::flush() {
+  std::vector<ThreadRing*> rings;
+  {
+    std::lock_guard<std::mutex> lock(registry_mutex_);
+    rings = rings_;
+  }
+  for (std::size_t i = 0; i < rings.size(); ++i) {
+    drain(rings[i]);
+  }
+  std::lock_guard<std::mutex> lock(file_mutex_);
+  std::fflush(out_);
+}
+
+void AccessTracer::startBackgroundDrain(
+    const std::chrono::milliseconds interval) {
+  if (drain_thread_.joinable()) {
+    return;
+  }
+  drain_thread_ = std::thread([this, interval]() {
+    while (!stop_drain_) {
+      std::this_thread::sleep_for(interval);
+      flush();
+    }
+  });
+}
+
+AccessTracer::ThreadRing* AccessTracer::ringForThisThread() {
+  if (cached_generation == generation_) {
+    return static_cast<ThreadRing*>(cached_ring);
+  }
+  void*& thread_ring = thread_rings[generation_];
+  if (thread_ring == NULL) {
+    std::lock_guard<std::mutex> lock(registry_mutex_);
+    thread_ring = new ThreadRing(rings_.size(), ring_capacity_);
+    rings_.push_back(static_cast<ThreadRing*>(thread_ring));
+  }
+  cached_generation = generation_;
+  cached_ring = thread_ring;
+  return static_cast<ThreadRing*>(thread_ring);
+}
+
+std::uint32_t AccessTracer::fileNumber(const File* file) {
+  std::lock_guard<std::mutex> lock(registry_mutex_);
+  std::map<std::uint64_t, std::uint32_t>::iterator iter =
+      file_numbers_.find(file->id());
+  if (iter != file_numbers_.end()) {
+    return iter->second;
+  }
+
+  const std::uint32_t number = next_file_number_++;
+  file_numbers_[file->id()] = number;
+  std::vector<char> block(sizeof(number) + file->filename().size());
+  std::memcpy(&block[0], &number, sizeof(number));
+  std::memcpy(&block[sizeof(number)], file->filename().data(),
+              file->filename().size());
+  std::lock_guard<std::mutex> file_lock(file_mutex_);
+  writeBlock(BLOCK_FILE, &block[0], block.size());
+  return number;
+}
+
+void AccessTracer::drain(ThreadRing* ring) {
+  std::lock_guard<std::mutex> lock(ring->drain_mutex);
+  const std::uint64_t tail = ring->tail.load(std::memory_order_relaxed);
+  const std::uint64_t head = ring->head.load(std::memory_order_acquire);
+  if (head == tail) {
+    return;
+  }
+
+  // The buffered records may wrap around the end of the ring.
+  const std::size_t first = tail % ring_capacity_;
+  const std::size_t count = head - tail;
+  const std::size_t first_count =
+      count < ring_capacity_ - first ? count : ring_capacity_ - first;
+  {
+    std::lock_guard<std::mutex> file_lock(file_mutex_);
+    const BlockHeader header = {BLOCK_EVENTS,
+                                static_cast<std::uint32_t>(
+                                    count * sizeof(TraceRecord))};
+    std::fwrite(&header, sizeof(header), 1, out_);
+    std::fwrite(&ring->records[first], sizeof(TraceRecord), first_count, out_);
+    std::fwrite(&ring->records[0], sizeof(TraceRecord), count - first_count,
+                out_);
+  }
+  records_written_ += count;
+  ring->tail.store(head, std::memory_order_release);
+}
+
+void AccessTracer::writeBlock(const std::uint32_t type, const void* data,
+                              const std::uint32_t length) {
+  const BlockHeader header = {type, length};
+  std::fwrite(&header, sizeof(header), 1, out_);
+  std::fwrite(data, 1, length, out_);
+}
+
+AccessTraceReader::AccessTraceReader(const std::string& path)
+    : in_(std::fopen(path.c_str(), "rb")),
+      cycles_per_ns_(1.0),
+      records_left_(0) {
+  char magic[sizeof(AccessTracer::MAGIC)];
+  if (in_ == NULL ||
+      std::fread(magic, sizeof(magic), 1, in_) != 1 ||
+      std::memcmp(magic, AccessTracer::MAGIC, sizeof(magic)) != 0 ||
+      std::fread(&cycles_per_ns_, sizeof(cycles_per_ns_), 1, in_) != 1) {
+    if (in_ != NULL) {
+      std::fclose(in_);
+    }
+    throw FileNotFoundException(path);
+  }
+}
+
+AccessTraceReader::~AccessTraceReader() {
+  std::fclose(in_);
+}
+
+bool AccessTraceReader::next(TraceEvent& event) {
+  while (records_left_ == 0) {
+    BlockHeader header;
+    if (std::fread(&header, sizeof(header), 1, in_) != 1) {
+      return false;
+    }
+    if (header.type == AccessTracer::BLOCK_EVENTS) {
+      records_left_ = header.length / sizeof(TraceRecord);
+    } else if (header.type == AccessTracer::BLOCK_FILE &&
+               header.length >= sizeof(std::uint32_t)) {
+      std::uint32_t number;
+      std::string name(header.length - sizeof(number), '\0');
+      if (std::fread(&number, sizeof(number), 1, in_) != 1 ||
+          (!name.empty() &&
+           std::fread(&name[0], name.size(), 1, in_) != 1)) {
+        return false;
+      }
+      filenames_[number] = name;
+    } else {
+      std::fseek(in_, header.length, SEEK_CUR);
+    }
+  }
+
+  if (std::fread(&event.record, sizeof(event.record), 1, in_) != 1) {
+    return false;
+  }
+  --records_left_;
+  event.filename = filenames_[event.record.file];
+  return true;
+}
+
+}
@@ -0,0 +1,340 @@
+/**
+ * @author See Contributors.txt for code contributors and overview of BadgerDB.
+ *
+ * @section LICENSE
+ * Copyright (c) 2012 Database Group, Computer Sciences Department, University of Wisconsin-Madison.
+ */
+
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdint>
+#include <map>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "types.h"
+
+namespace badgerdb {
+
+class File;
+
+/**
+ * @brief Buffer manager calls recorded in an access trace.
+ */
+enum TraceOp {
+  TRACE_READ = 0,
+  TRACE_ALLOC = 1,
+  TRACE_UNPIN = 2,
+  TRACE_DISPOSE = 3
+};
+
+/**
+ * Set in TraceRecord::flags if a read found the page in the buffer pool.
+ */
+const std::uint8_t TRACE_HIT = 0x1;
+
+/**
+ * Set in TraceRecord::flags if an unpin marked the page dirty.
+ */
+const std::uint8_t TRACE_DIRTY = 0x2;
+
+/**
+ * @brief One buffer manager call as stored in a trace file.
+ */
+struct TraceRecord {
+  /**
+   * Cycle counter value when the call was made.
+   */
+  std::uint64_t timestamp;
+
+  /**
+   * Number of the recording thread, assigned in order of first event.
+   */
+  std::uint32_t thread;
+
+  /**
+   * Number of the file, resolved to a name by the file table of the trace.
+   */
+  std::uint32_t file;
+
+  /**
+   * Page number within the file.
+   */
+  PageId page;
+
+  /**
+   * One of TraceOp.
+   */
+  std::uint8_t op;
+
+  /**
+   * Combination of TRACE_HIT and TRACE_DIRTY.
+   */
+  std::uint8_t flags;
+
+  /**
+   * Unused; keeps records 8-byte aligned.
+   */
+  std::uint16_t reserved;
+};
+
+static_assert(sizeof(TraceRecord) == 24, "Trace records must stay compact.");
+
+/**
+ * @brief Records buffer manager calls into a compact binary trace file.
+ *
+ * Every recording thread gets its own single-producer ring buffer, so
+ * recording an event is a few stores and no locks.  Rings are drained to the
+ * trace file by flush(), by an optional background thread, or by the
+ * recording thread itself when its ring fills up.  Because rings are drained
+ * independently, records of different threads are interleaved in blocks
+ * rather than in strict time order; sort by timestamp when replaying.
+ *
+ * The trace file starts with a header holding a magic string and the cycle
+ * counter rate, followed by blocks.  Each block starts with a type and a
+ * length: file blocks map a file number to its name, and event blocks hold
+ * TraceRecords.
+ */
+class AccessTracer {
+ public:
+  /**
+   * Creates a trace file and starts recording into it.
+   *
+   * @param path            Name of trace file to create.
+   * @param ring_capacity   Number of records each thread buffers before the
+   *                        ring must be drained.
+   * @throws  FileNotFoundException   If the trace file cannot be created.
+   */
+  explicit AccessTracer(const std::string& path,
+                        const std::size_t ring_capacity = 1 << 14);
+
+  /**
+   * Drains all rings, stops the background thread and closes the trace file.
+   */
+  ~AccessTracer();
+
+  /**
+   * Records one buffer manager call made by the current thread.
+   *
+   * @param op        Kind of call.
+   * @param file      File the call was made on.
+   * @param page      Page number within the file.
+   * @param flags     Combination of TRACE_HIT and TRACE_DIRTY.
+   */
+  void record(const TraceOp op, const File* file, const PageId page,
+              const std::uint8_t flags);
+
+  /**
+   * Writes all buffered records of all threads to the trace file.
+   */
+  void flush();
+
+  /**
+   * Starts a thread which drains all rings every interval.
+   *
+   * @param interval  Time between drains.
+   */
+  void startBackgroundDrain(const std::chrono::milliseconds interval);
+
+  /**
+   * Returns the number of records written to the trace file so far.
+   *
+   * @return  Number of records written.
+   */
+  std::uint64_t recordsWritten() const { return records_written_; }
+
+  /**
+   * Block holding the name of a file.
+   */
+  static const std::uint32_t BLOCK_FILE = 1;
+
+  /**
+   * Block holding trace records.
+   */
+  static const std::uint32_t BLOCK_EVENTS = 2;
+
+  /**
+   * Magic string at the start of every trace file.
+   */
+  static const char MAGIC[8];
+
+ private:
+  /**
+   * Single-producer ring of records of one thread.
+   */
+  struct ThreadRing {
+    ThreadRing(const std::uint32_t thread_number, const std::size_t capacity)
+        : thread(thread_number), records(capacity), head(0), tail(0),
+          last_file_id(0), last_file_number(0) {}
+
+    std::uint32_t thread;
+    std::vector<TraceRecord> records;
+    std::atomic<std::uint64_t> head;
+    std::atomic<std::uint64_t> tail;
+    std::mutex drain_mutex;
+    std::uint64_t last_file_id;
+    std::uint32_t last_file_number;
+
+    /**
+     * Numbers of the files this thread has recorded, by File::id(), so that
+     * switching between them needs no lock.
+     */
+    std::map<std::uint64_t, std::uint32_t> file_numbers;
+  };
+
+  /**
+   * Returns the ring of the calling thread, registering one on first use.
+   */
+  ThreadRing* ringForThisThread();
+
+  /**
+   * Returns the number of a file, writing its name to the trace the first
+   * time it is seen.
+   */
+  std::uint32_t fileNumber(const File* file);
+
+  /**
+   * Writes the buffered records of one ring to the trace file.
+   */
+  void drain(ThreadRing* ring);
+
+  /**
+   * Writes a block to the trace file.  Caller must hold file_mutex_.
+   */
+  void writeBlock(const std::uint32_t type, const void* data,
+                  const std::uint32_t length);
+
+  /**
+   * Trace file being written.
+   */
+  std::FILE* out_;
+
+  /**
+   * Number of records per thread ring.
+   */
+  std::size_t ring_capacity_;
+
+  /**
+   * Identifies this tracer in threads' cached ring pointers, so that a new
+   * tracer allocated at the address of a destroyed one is told apart.
+   */
+  std::uint64_t generation_;
+
+  /**
+   * Serializes writes to the trace file.
+   */
+  std::mutex file_mutex_;
+
+  /**
+   * Guards rings_ and file_numbers_.
+   */
+  std::mutex registry_mutex_;
+
+  /**
+   * Rings of all threads that have recorded events.
+   */
+  std::vector<ThreadRing*> rings_;
+
+  /**
+   * Numbers assigned to files seen so far, by File::id().
+   */
+  std::map<std::uint64_t, std::uint32_t> file_numbers_;
+
+  /**
+   * Number assigned to the next file seen.
+   */
+  std::uint32_t next_file_number_;
+
+  /**
+   * Number of records written to the trace file.
+   */
+  std::atomic<std::uint64_t> records_written_;
+
+  /**
+   * Background drain thread, if started.
+   */
+  std::thread drain_thread_;
+
+  /**
+   * Tells the background drain thread to stop.
+   */
+  std::atomic<bool> stop_drain_;
+};
+
+/**
+ * @brief One event read back from a trace file.
+ */
+struct TraceEvent {
+  /**
+   * Record as stored in the trace.
+   */
+  TraceRecord record;
+
+  /**
+   * Name of the file the event refers to.
+   */
+  std::string filename;
+};
+
+/**
+ * @brief Reads events back from a trace file written by AccessTracer.
+ */
+class AccessTraceReader {
+ public:
+  /**
+   * Opens a trace file for reading.
+   *
+   * @param path  Name of trace file.
+   * @throws  FileNotFoundException   If the file cannot be opened or is not a
+   *                                  trace file.
+   */
+  explicit AccessTraceReader(const std::string& path);
+
+  /**
+   * Closes the trace file.
+   */
+  ~AccessTraceReader();
+
+  /**
+   * Reads the next event in file order.
+   *
+   * @param event   Filled in with the event.
+   * @return  False at the end of the trace.
+   */
+  bool next(TraceEvent& event);
+
+  /**
+   * Returns the cycle counter rate of the machine that recorded the trace.
+   *
+   * @return  Cycle counter ticks per nanosecond.
+   */
+  double cyclesPerNanosecond() const { return cycles_per_ns_; }
+
+ private:
+  /**
+   * Trace file being read.
+   */
+  std::FILE* in_;
+
+  /**
+   * Cycle counter rate stored in the trace header.
+   */
+  double cycles_per_ns_;
+
+  /**
+   * Records left in the current event block.
+   */
+  std::uint32_t records_left_;
+
+  /**
+   * Names of files seen so far, by number.
+   */
+  std::map<std::uint32_t, std::string> filenames_;
+};
+
+}
@@ -7,7 +7,15 @@
 
 #include <memory>
 #include <iostream>
+#include <fstream>
+#include <functional>
+#include <sstream>
+#include <algorithm>
+#include <map>
+#include <set>
+#include <cstdio>
 #include "buffer.h"
+#include "cycle_clock.h"
 #include "exceptions/buffer_exceeded_exception.h"
 #include "exceptions/page_not_pinned_exception.h"
 #include "exceptions/page_pinned_exception.h"
@@ -16,12 +24,17 @@
 #include "exceptions/file_not_found_exception.h"
 #include "exceptions/hash_already_present_exception.h"
 #include "exceptions/hash_table_exception.h"
+#include "exceptions/invalid_page_exception.h"
 
 
 namespace badgerdb
 {
 
-    BufMgr::BufMgr(std::uint32_t bufs) : numBufs(bufs)
+    const std::uint32_t BufMgr::MAX_WRITE_BATCH;
+    const std::uint32_t BufMgr::POOL_DUMP_SLICE;
+
+    BufMgr::BufMgr(std::uint32_t bufs)
+            : numBufs(bufs), latencyTracking(false), tracer(NULL), mrcEstimator(NULL), poolDumpInterval(0), accessesSinceDump(0), poolDumpPos(0), restorePos(0), restoreFrame(0)
     {
         bufDescTable = new BufDesc[bufs];
         for (FrameId i = 0; i < bufs; i++)
@@ -31,6 +44,8 @@ namespace badgerdb
         }
 
         bufPool = new Page[bufs];
+        loggedImages.resize(bufs);
+        cleanImages.resize(bufs);
 
         int htsize = ((((int) (bufs * 1.2)) * 2) / 2) + 1;
         hashTable = new BufHashTbl(htsize);  // allocate the buffer hash table
@@ -41,27 +56,99 @@ namespace badgerdb
 
     BufMgr::~BufMgr()
     {
-        for (std::uint32_t i = 0; i < numBufs; i++)
+        // Dumping the resident pages so that the next run can warm up from them
+        if (!poolDumpFile.empty())
         {
-            if (bufDescTable[i].valid && bufDescTable[i].dirty)
-            {
-                // Flushing all dirty pages to file
-
-                bufDescTable[i].file->writePage(bufPool[i]);
-                bufDescTable[i].dirty = false;
-            }
+            dumpPool(poolDumpFile);
         }
 
+        // Flushing all dirty pages to file
+        checkpoint();
+
         // Deallocating the buffer pool, buffer description table
         // and the hash table
         delete[] bufPool;
         delete[] bufDescTable;
         delete hashTable;
+        delete mrcEstimator;
     }
 
-    void BufMgr::advanceClock()
+    void BufMgr::recordLatency(const BufOp op, const std::uint64_t startCycles)
     {
-        clockHand = (clockHand + 1) % numBufs;
+        if (latencyTracking)
+        {
+            latency[op].record(readCycleCounter() - startCycles);
+        }
+    }
+
+    void BufMgr::readFrame(File *file, const PageId pageNo, const FrameId frameNo)
+    {
+        const std::uint64_t start = latencyTracking ? readCycleCounter() : 0;
+        bufPool[frameNo] = file->readPage(pageNo);
+        rememberLoggedImage(file, frameNo);
+        recordLatency(FILE_READ, start);
+        bufStats.diskreads++;
+    }
+
+    void BufMgr::writeFrame(const FrameId frameNo)
+    {
+        writeFrames(bufDescTable[frameNo].file, std::vector<FrameId>(1, frameNo));
+    }
+
+    void BufMgr::writeFrames(File *file, const std::vector<FrameId> &frames)
+    {
+        if (frames.empty())
+        {
+            return;
+        }
+        const std::uint64_t start = latencyTracking ? readCycleCounter() : 0;
+        std::vector<const Page *> pages;
+        pages.reserve(frames.size());
+        Lsn lsn = 0;
+        for (std::size_t i = 0; i < frames.size(); i++)
+        {
+            pages.push_back(&bufPool[frames[i]]);
+            lsn = std::max(lsn, bufPool[frames[i]].lsn());
+        }
+        // Write-ahead rule: the log records of the pages go to disk before the pages do
+        if (file->log() != NULL)
+        {
+            file->log()->flushTo(lsn);
+        }
+        file->writePages(pages);
+        recordLatency(FILE_WRITE, start);
+        bufStats.diskwrites += frames.size();
+    }
+
+    std::vector<FrameId> BufMgr::collectWriteBatch(const FrameId victim) const
+    {
+        std::vector<FrameId> batch(1, victim);
+        const File *file = bufDescTable[victim].file;
+        for (FrameId i = 0; i < numBufs && batch.size() < MAX_WRITE_BATCH; i++)
+        {
+            if (i != victim && bufDescTable[i].valid && bufDescTable[i].file == file &&
+                bufDescTable[i].dirty && bufDescTable[i].pinCnt == 0)
+            {
+                batch.push_back(i);
+            }
+        }
+        return batch;
+    }
+
+    void BufMgr::rememberLoggedImage(File *file, const FrameId frameNo)
+    {
+        if (file->log() == NULL)
+        {
+            return;
+        }
+        if (!loggedImages[frameNo])
+        {
+            loggedImages[frameNo].reset(new Page(bufPool[frameNo]));
+        }
+        else
+        {
+            *loggedImages[frameNo] = bufPool[frameNo];
+        }
     }
 
     /**
@@ -72,92 +159,86 @@ namespace badgerdb
      */
     void BufMgr::allocBuf(FrameId &frame)
     {
-        std::uint32_t numPinnedPages = 0;
-        for (;;)
+        const std::uint64_t start = latencyTracking ? readCycleCounter() : 0;
+
+        // Sweeping the clock hand until it finds a frame which is
+        // free, or unpinned and not recently referenced
+        FrameTable frames(bufDescTable, numBufs);
+        VictimSearchStats search;
+        FrameId victim;
+        const bool found = clockFindVictim(frames, clockHand, victim, search);
+        bufStats.clockSweeps += search.frames_examined;
+        bufStats.pinnedSkips += search.pinned_skipped;
+        if (!found)
         {
-            // Advancing clock pointer to the next frame
-            advanceClock();
+            // Every page is pinned, i.e. used by some user
+            bufStats.pinWaits++;
+            throw BufferExceededException();
+        }
 
-            // Checking if the page is valid
-            if (bufDescTable[clockHand].valid)
+        // Checking if the frame holds a page which has to be evicted
+        if (bufDescTable[victim].valid)
+        {
+            // Checking if dirty bit is set
+            if (bufDescTable[victim].dirty)
             {
-                // Page is valid
-                // Checking if refbit is set
-                if (!bufDescTable[clockHand].refbit)
+                // Page is dirty. Flush page to disk
+                if (bufDescTable[victim].file->usesDoublewrite())
                 {
-                    // Refbit is not set
-                    // Checking if pincount is 0 (i.e. the page
-                    // is not used by any user)
-                    if (bufDescTable[clockHand].pinCnt == 0)
-                    {
-                        // Page is not pinned, i.e. it is not
-                        // used by any user
-
-                        // Checking if dirty bit is set
-                        if (bufDescTable[clockHand].dirty)
-                        {
-                            // Page is dirty. Flush page to disk
-                            bufDescTable[clockHand].file->writePage(bufPool[clockHand]);
-                            try
-                            {
-                                hashTable->remove(bufDescTable[clockHand].file, bufDescTable[clockHand].pageNo);
-                            }
-                            catch (HashNotFoundException hnfe)
-                            {
-                                std::cerr << hnfe.message() << std::endl;
-                                return;
-                            }
-                            catch (HashTableException hte)
-                            {
-                                std::cerr << hte.message() << std::endl;
-                                return;
-                            }
-                        }
-
-                        // Clearing the frame (i.e. pinCnt = 0, dirty = false;
-                        // valid = false and refbit = false
-                        bufDescTable[clockHand].Clear();
-                        // Use the frame. Returning frame by reference
-                        frame = bufDescTable[clockHand].frameNo;
-                        return;
-                    }
-                    else if (bufDescTable[clockHand].pinCnt > 0)
+                    // Other dirty pages of the file share the syncs of the batch and stay resident, clean
+                    const std::vector<FrameId> batch = collectWriteBatch(victim);
+                    writeFrames(bufDescTable[victim].file, batch);
+                    for (std::size_t i = 1; i < batch.size(); i++)
                     {
-                        // Page is pinned, i.e it is used,then
-                        // it can't be used. Skip to next frame
-                        numPinnedPages++;
-                        if (numPinnedPages == numBufs)
-                        {
-                            throw BufferExceededException();
-                        }
-                        else
-                        {
-                            continue;
-                        }
+                        bufDescTable[batch[i]].dirty = false;
                     }
+                    bufStats.batchedWrites += batch.size() - 1;
                 }
                 else
                 {
-                    // Setting the refbit to false if set
-                    bufDescTable[clockHand].refbit = false;
-                    continue;
+                    writeFrame(victim);
                 }
+                bufStats.evictionWrites++;
+                bufStats.dirtyEvictions++;
             }
             else
             {
-                // Page is not valid
-                // Setting up the frame (i.e. pinCnt = 1, dirty = false;
-                // valid = true and refbit = true
-                bufDescTable[clockHand].Set(bufDescTable[clockHand].file, bufDescTable[clockHand].pageNo);
+                bufStats.cleanEvictions++;
+            }
 
-                // Use the frame. Returning frame by reference
-                frame = bufDescTable[clockHand].frameNo;
+            // Removing the evicted page's entry from hashtable
+            try
+            {
+                hashTable->remove(bufDescTable[victim].file, bufDescTable[victim].pageNo);
+            }
+            catch (HashNotFoundException hnfe)
+            {
+                std::cerr << hnfe.message() << std::endl;
+                return;
+            }
+            catch (HashTableException hte)
+            {
+                std::cerr << hte.message() << std::endl;
                 return;
             }
+
+            // Clearing the frame (i.e. pinCnt = 0, dirty = false;
+            // valid = false and refbit = false
+            bufDescTable[victim].Clear();
+            recordLatency(EVICT, start);
         }
+
+        // Use the frame. Returning frame by reference. The caller
+        // sets the frame up once the page is in it.
+        frame = bufDescTable[victim].frameNo;
     }
 
     void BufMgr::readPage(File *file, const PageId pageNo, Page *&page)
+    {
+        pinPage(file, pageNo, page, false);
+    }
+
+    void BufMgr::pinPage(File *file, const PageId pageNo, Page *&page, const bool snapshot)
     {
         // Checking if file is valid
         if (file == NULL)
@@ -165,7 +246,14 @@ namespace badgerdb
             return;
         }
 
+        const std::uint64_t start = latencyTracking ? readCycleCounter() : 0;
         FrameId frameNo;
+        notePageAccess();
+        bufStats.accesses++;
+        if (mrcEstimator != NULL)
+        {
+            mrcEstimator->recordAccess(file, pageNo);
+        }
 
         //page = new Page;
         // Checking if the page is present in Hashtable
@@ -200,7 +288,8 @@ namespace badgerdb
             }
 
             //Reading the page
-            bufPool[frameNo] = file->readPage(pageNo);
+            readFrame(file, pageNo, frameNo);
+            bufStats.misses++;
 
             // Inserting the read page into hashtable
             try
@@ -221,31 +310,105 @@ namespace badgerdb
             // Setting up the frame (i.e. pinCnt = 1, dirty = false;
             // valid = true and refbit = true
             bufDescTable[frameNo].Set(file, pageNo);
+            if (snapshot)
+            {
+                bufDescTable[frameNo].snapshotCnt = 1;
+            }
 
             // Assigning the frame to the page, i.e. page points to the frame
             // and returning page by reference
             page = &bufPool[frameNo];
+            recordLatency(READ_MISS, start);
+            if (tracer != NULL)
+            {
+                tracer->record(TRACE_READ, file, pageNo, 0);
+            }
         }
         else // Page is present in the buffer pool
         {
+            // Snapshot readers never share a frame with anyone else
+            const BufDesc &current = bufDescTable[frameNo];
+            if ((snapshot ? current.pinCnt > current.snapshotCnt : current.snapshotCnt > 0) &&
+                !splitVersion(file, pageNo, frameNo, snapshot))
+            {
+                return;
+            }
+
             // Setting the refbit to true
             bufDescTable[frameNo].refbit = true;
+            bufDescTable[frameNo].accessCnt++;
+            bufStats.hits++;
 
             //Incrementing the pin count of the page
             bufDescTable[frameNo].pinCnt++;
+            if (snapshot)
+            {
+                bufDescTable[frameNo].snapshotCnt++;
+            }
 
             // Assigning the frame to the page, i.e. page points to the frame
             // and returning page by reference
             page = &bufPool[frameNo];
+            recordLatency(READ_HIT, start);
+            if (tracer != NULL)
+            {
+                tracer->record(TRACE_READ, file, pageNo, TRACE_HIT);
+            }
         }
     }
 
+    bool BufMgr::splitVersion(File *file, const PageId pageNo, FrameId &frameNo, const bool snapshot)
+    {
+        FrameId copyFrame;
+        try
+        {
+            allocBuf(copyFrame);
+        }
+        catch (BufferExceededException bee)
+        {
+            std::cerr << bee.message() << std::endl;
+            return false;
+        }
+
+        BufDesc &old = bufDescTable[frameNo];
+        if (snapshot)
+        {
+            // The reader gets the page as it was before the writers holding it changed it,
+            // in a frame of its own which is not in the hash table
+            bufPool[copyFrame] = old.cleanImage ? *cleanImages[frameNo] : bufPool[frameNo];
+            bufDescTable[copyFrame].Set(file, pageNo);
+            bufDescTable[copyFrame].pinCnt = 0;
+            bufDescTable[copyFrame].version = true;
+        }
+        else
+        {
+            // The caller gets a copy to change, which becomes the current version of the page,
+            // and the frame the readers hold becomes an old version
+            bufPool[copyFrame] = bufPool[frameNo];
+            loggedImages[copyFrame].swap(loggedImages[frameNo]);
+            hashTable->remove(file, pageNo);
+            hashTable->insert(file, pageNo, copyFrame);
+
+            bufDescTable[copyFrame].Set(file, pageNo);
+            bufDescTable[copyFrame].pinCnt = 0;
+            bufDescTable[copyFrame].dirty = old.dirty;
+            bufDescTable[copyFrame].accessCnt = old.accessCnt;
+            // The copy carries the unwritten changes, so the old version is never written back
+            old.dirty = false;
+            old.version = true;
+        }
+        bufStats.versionCopies++;
+        frameNo = copyFrame;
+        return true;
+    }
+
     void BufMgr::unPinPage(File *file, const PageId pageNo, const bool dirty)
     {
         if (file == NULL)
         {
             return;
         }
+        const std::uint64_t start = latencyTracking ? readCycleCounter() : 0;
         FrameId frameNo;
 
         // Checking if the page is present in hash table
@@ -254,7 +417,8 @@ namespace badgerdb
         {
             if (hashTable->lookup(file, pageNo, frameNo))
             {
-                if (bufDescTable[frameNo].pinCnt > 0)
+                // Pins of snapshot readers are released by releaseSnapshot()
+                if (bufDescTable[frameNo].pinCnt > bufDescTable[frameNo].snapshotCnt)
                 {
                     // Decrement the pin count
                     bufDescTable[frameNo].pinCnt--;
@@ -263,11 +427,39 @@ namespace badgerdb
                     if (dirty)
                     {
                         bufDescTable[frameNo].dirty = true;
+                        // Log the changes made since the page was last logged
+                        if (file->log() != NULL &&
+                            file->log()->logPage(*loggedImages[frameNo], bufPool[frameNo]) != 0)
+                        {
+                            *loggedImages[frameNo] = bufPool[frameNo];
+                        }
+                    }
+
+                    // Only writers change pages, so a dirty unpin ends a writer's change. A pin left over once
+                    // the others are gone cannot be a writer's either.
+                    BufDesc &desc = bufDescTable[frameNo];
+                    if (desc.writerCnt > 0 && (dirty || desc.writerCnt > desc.pinCnt))
+                    {
+                        desc.writerCnt--;
+                    }
+
+                    // Snapshot readers arriving later see the page as the last writer left it, but never while
+                    // another writer may be part way through a change
+                    if (desc.cleanImage)
+                    {
+                        if (desc.pinCnt == 0)
+                        {
+                            desc.cleanImage = false;
+                        }
+                        else if (dirty && desc.writerCnt == 0)
+                        {
+                            *cleanImages[frameNo] = bufPool[frameNo];
+                        }
                     }
                 }
-                else if (bufDescTable[frameNo].pinCnt == 0)
+                else
                 {
-                    // Pin count is already 0
+                    // No pin left to release
                     // Throw exception
                     throw PageNotPinnedException(file->filename(), pageNo, frameNo);
                 }
@@ -278,6 +470,69 @@ namespace badgerdb
             std::cerr << hnfe.message() << std::endl;
             return;
         }
+        recordLatency(UNPIN, start);
+        if (tracer != NULL)
+        {
+            tracer->record(TRACE_UNPIN, file, pageNo, dirty ? TRACE_DIRTY : 0);
+        }
+    }
+
+    void BufMgr::readPageSnapshot(File *file, const PageId pageNo, const Page *&page)
+    {
+        Page *current = NULL;
+        pinPage(file, pageNo, current, true);
+        if (current != NULL)
+        {
+            page = current;
+        }
+    }
+
+    void BufMgr::releaseSnapshot(const Page *page)
+    {
+        if (std::less<const Page *>()(page, bufPool) || !std::less<const Page *>()(page, bufPool + numBufs))
+        {
+            throw PageNotPinnedException("", Page::INVALID_NUMBER, numBufs);
+        }
+        const FrameId frameNo = page - bufPool;
+        BufDesc &desc = bufDescTable[frameNo];
+        if (desc.snapshotCnt == 0)
+        {
+            throw PageNotPinnedException(desc.file != NULL ? desc.file->filename() : "", page->page_number(), frameNo);
+        }
+        desc.snapshotCnt--;
+        desc.pinCnt--;
+        // An old version is of no use once its last reader is gone
+        if (desc.version && desc.pinCnt == 0)
+        {
+            desc.Clear();
+        }
+    }
+
+    void BufMgr::readPageForUpdate(File *file, const PageId pageNo, Page *&page)
+    {
+        Page *current = NULL;
+        readPage(file, pageNo, current);
+        if (current == NULL)
+        {
+            return;
+        }
+
+        // Keeping the page as it is before the change for snapshot readers arriving meanwhile
+        const FrameId frameNo = current - bufPool;
+        if (!bufDescTable[frameNo].cleanImage)
+        {
+            if (!cleanImages[frameNo])
+            {
+                cleanImages[frameNo].reset(new Page(bufPool[frameNo]));
+            }
+            else
+            {
+                *cleanImages[frameNo] = bufPool[frameNo];
+            }
+            bufDescTable[frameNo].cleanImage = true;
+        }
+        bufDescTable[frameNo].writerCnt++;
+        page = current;
     }
 
     void BufMgr::flushFile(const File *file)
@@ -286,7 +541,11 @@ namespace badgerdb
         {
             return;
         }
+        const std::uint64_t start = latencyTracking ? readCycleCounter() : 0;
 
+        // Checking every frame of the file before writing, so that the dirty pages
+        // can be written back as one batch
+        std::vector<FrameId> dirtyFrames;
         for (std::uint32_t i = 0; i < numBufs; i++)
         {
             // If page is valid is present in the given file
@@ -302,32 +561,10 @@ namespace badgerdb
                                                   bufDescTable[i].pageNo,
                                                   bufDescTable[i].frameNo);
                     }
-
-                    // If page is dirty, flush it to file and
-                    // set dirty bit to false
                     if (bufDescTable[i].dirty)
                     {
-                        bufDescTable[i].file->writePage(bufPool[i]);
-                        bufDescTable[i].dirty = false;
+                        dirtyFrames.push_back(i);
                     }
-
-                    // Removing the page's entry from hashtable
-                    try
-                    {
-                        hashTable->remove(file, bufDescTable[i].pageNo);
-                    }
-                    catch (HashNotFoundException hnfe)
-                    {
-                        std::cerr << hnfe.message() << std::endl;
-                        return;
-                    }
-                    catch (HashTableException hte)
-                    {
-                        std::cerr << hte.message() << std::endl;
-                        return;
-                    }
-                    // Clearing the frame
-                    bufDescTable[i].Clear();
                 }
                 else
                 {
@@ -340,6 +577,75 @@ namespace badgerdb
                 }
             }
         }
+        if (!dirtyFrames.empty())
+        {
+            writeFrames(bufDescTable[dirtyFrames[0]].file, dirtyFrames);
+            bufStats.flushWrites += dirtyFrames.size();
+        }
+
+        for (std::uint32_t i = 0; i < numBufs; i++)
+        {
+            if (bufDescTable[i].file == file)
+            {
+                // Removing the page's entry from hashtable
+                try
+                {
+                    hashTable->remove(file, bufDescTable[i].pageNo);
+                }
+                catch (HashNotFoundException hnfe)
+                {
+                    std::cerr << hnfe.message() << std::endl;
+                    return;
+                }
+                catch (HashTableException hte)
+                {
+                    std::cerr << hte.message() << std::endl;
+                    return;
+                }
+                // Clearing the frame
+                bufDescTable[i].Clear();
+            }
+        }
+        // The file header is only written back on request
+        file->sync();
+        // Every logged change to the file has been written back
+        file->checkpointLog();
+        recordLatency(FLUSH, start);
+    }
+
+    void BufMgr::checkpoint()
+    {
+        std::set<File *> files;
+        // Dirty pages are grouped by file, so that each file gets one batch
+        std::map<File *, std::vector<FrameId> > dirtyFrames;
+        for (std::uint32_t i = 0; i < numBufs; i++)
+        {
+            if (bufDescTable[i].valid && bufDescTable[i].dirty)
+            {
+                dirtyFrames[bufDescTable[i].file].push_back(i);
+            }
+            if (bufDescTable[i].valid)
+            {
+                files.insert(bufDescTable[i].file);
+            }
+        }
+        for (std::map<File *, std::vector<FrameId> >::const_iterator iter = dirtyFrames.begin();
+             iter != dirtyFrames.end(); ++iter)
+        {
+            writeFrames(iter->first, iter->second);
+            for (std::size_t i = 0; i < iter->second.size(); i++)
+            {
+                bufDescTable[iter->second[i]].dirty = false;
+            }
+            bufStats.checkpointWrites += iter->second.size();
+        }
+        // Persist the headers of the files too, so that the files on disk
+        // are complete
+        for (std::set<File *>::const_iterator iter = files.begin(); iter != files.end(); ++iter)
+        {
+            (*iter)->sync();
+            (*iter)->checkpointLog();
+        }
     }
 
     void BufMgr::allocPage(File *file, PageId &pageNo, Page *&page)
@@ -350,10 +656,14 @@ namespace badgerdb
             return;
         }
 
+        const std::uint64_t start = latencyTracking ? readCycleCounter() : 0;
         FrameId frameNo;
+        notePageAccess();
+        bufStats.accesses++;
 
         // Creating a new page in the file
         Page new_page = file->allocatePage();
+        bufStats.diskreads++;
 
         // Returning pageNo by reference
         pageNo = new_page.page_number();
@@ -361,6 +671,7 @@ namespace badgerdb
         // Allocating a buffer for the page in the buffer pool
         allocBuf(frameNo);
         bufPool[frameNo] = new_page;
+        rememberLoggedImage(file, frameNo);
 
         // Entering the (file, PageNo) key into the hashtable
         try
@@ -385,6 +696,15 @@ namespace badgerdb
         // Assigning the frame to the page, i.e. page points to the frame
         // and returning page by reference
         page = &bufPool[frameNo];
+        recordLatency(ALLOC, start);
+        if (tracer != NULL)
+        {
+            tracer->record(TRACE_ALLOC, file, pageNo, 0);
+        }
+        if (mrcEstimator != NULL)
+        {
+            mrcEstimator->recordAccess(file, pageNo);
+        }
     }
 
     void BufMgr::disposePage(File *file, const PageId PageNo)
@@ -429,6 +749,14 @@ namespace badgerdb
 
         // Deleting the page from the file
         file->deletePage(PageNo);
+        if (tracer != NULL)
+        {
+            tracer->record(TRACE_DISPOSE, file, PageNo, 0);
+        }
+        if (mrcEstimator != NULL)
+        {
+            mrcEstimator->forget(file, PageNo);
+        }
     }
 
     void BufMgr::printSelf(void)
@@ -448,4 +776,293 @@ namespace badgerdb
 
         std::cout << "Total Number of Valid Frames:" << validFrames << "\n";
     }
-}
\ No newline at end of file
+
+    std::map<std::string, FileFrameStats> BufMgr::collectFileFrameStats() const
+    {
+        std::map<std::string, FileFrameStats> stats;
+        for (std::uint32_t i = 0; i < numBufs; i++)
+        {
+            if (bufDescTable[i].valid && bufDescTable[i].file != NULL)
+            {
+                FileFrameStats &fileStats = stats[bufDescTable[i].file->filename()];
+                fileStats.residentPages++;
+                if (bufDescTable[i].dirty)
+                {
+                    fileStats.dirtyPages++;
+                }
+                if (bufDescTable[i].pinCnt > 0)
+                {
+                    fileStats.pinnedPages++;
+                }
+            }
+        }
+        return stats;
+    }
+
+    void BufMgr::enableMrcEstimation(const double samplingRate)
+    {
+        delete mrcEstimator;
+        mrcEstimator = samplingRate > 0.0 ? new MrcEstimator(samplingRate) : NULL;
+    }
+
+    double BufMgr::predictedHitRatio(const std::uint32_t frames) const
+    {
+        if (mrcEstimator == NULL)
+        {
+            return 0.0;
+        }
+        return mrcEstimator->hitRatio(frames);
+    }
+
+    void BufMgr::setLatencyTracking(const bool enabled)
+    {
+        latencyTracking = enabled;
+    }
+
+    void BufMgr::clearLatencyHistograms()
+    {
+        for (int op = 0; op < NUM_BUF_OPS; op++)
+        {
+            latency[op].clear();
+        }
+    }
+
+    double BufMgr::latencyPercentile(const BufOp op, const double percentile) const
+    {
+        return latency[op].percentileNanos(percentile);
+    }
+
+    void BufMgr::notePageAccess()
+    {
+        if (poolDumpInterval == 0 || poolDumpFile.empty())
+        {
+            return;
+        }
+
+        // A periodic dump is written a slice of frames at a time, so that no access pays for the whole pool
+        if (poolDumpOut.is_open())
+        {
+            const FrameId last = std::min<FrameId>(poolDumpPos + POOL_DUMP_SLICE, numBufs);
+            writePoolDumpEntries(poolDumpOut, poolDumpPos, last);
+            poolDumpPos = last;
+            if (poolDumpPos == numBufs)
+            {
+                poolDumpOut.close();
+                std::rename((poolDumpFile + ".tmp").c_str(), poolDumpFile.c_str());
+            }
+            return;
+        }
+
+        if (++accessesSinceDump >= poolDumpInterval)
+        {
+            accessesSinceDump = 0;
+            poolDumpPos = 0;
+            poolDumpOut.open((poolDumpFile + ".tmp").c_str(), std::ios::out | std::ios::trunc);
+            if (!poolDumpOut.is_open())
+            {
+                std::cerr << "Unable to write buffer pool dump " << poolDumpFile << ".tmp" << std::endl;
+            }
+        }
+    }
+
+    void BufMgr::abandonPoolDump()
+    {
+        if (poolDumpOut.is_open())
+        {
+            poolDumpOut.close();
+            std::remove((poolDumpFile + ".tmp").c_str());
+        }
+    }
+
+    void BufMgr::setPoolDump(const std::string &dumpFile, const std::uint32_t interval)
+    {
+        abandonPoolDump();
+        poolDumpFile = dumpFile;
+        poolDumpInterval = interval;
+        accessesSinceDump = 0;
+    }
+
+    void BufMgr::dumpPool(const std::string &dumpFile)
+    {
+        // A full dump supersedes a periodic one in progress, which may be writing to the same temporary file
+        abandonPoolDump();
+
+        // Writing to a temporary file first so that a crash midway
+        // leaves the previous dump intact
+        const std::string tmpFile = dumpFile + ".tmp";
+        {
+            std::ofstream out(tmpFile.c_str(), std::ios::out | std::ios::trunc);
+            if (!out)
+            {
+                std::cerr << "Unable to write buffer pool dump " << tmpFile << std::endl;
+                return;
+            }
+
+            writePoolDumpEntries(out, 0, numBufs);
+        }
+
+        std::rename(tmpFile.c_str(), dumpFile.c_str());
+    }
+
+    void BufMgr::writePoolDumpEntries(std::ostream &out, const FrameId first, const FrameId last) const
+    {
+        for (FrameId i = first; i < last; i++)
+        {
+            // Old versions kept for snapshot readers are not worth reloading
+            if (bufDescTable[i].valid && bufDescTable[i].file != NULL && !bufDescTable[i].version)
+            {
+                out << bufDescTable[i].file->filename() << '\t'
+                    << bufDescTable[i].pageNo << '\t'
+                    << bufDescTable[i].accessCnt << '\n';
+            }
+        }
+    }
+
+    std::uint32_t BufMgr::loadPoolDump(const std::string &dumpFile, const std::vector<File *> &files)
+    {
+        std::ifstream in(dumpFile.c_str());
+        if (!in)
+        {
+            return 0;
+        }
+
+        std::map<std::string, File *> filesByName;
+        for (std::size_t i = 0; i < files.size(); i++)
+        {
+            filesByName[files[i]->filename()] = files[i];
+        }
+
+        // Reading the entries of the dump, skipping those of unknown files
+        std::vector<PoolDumpEntry> entries;
+        std::string line;
+        while (std::getline(in, line))
+        {
+            const std::string::size_type pageSep = line.find('\t');
+            if (pageSep == std::string::npos)
+            {
+                continue;
+            }
+
+            PoolDumpEntry entry;
+            entry.filename = line.substr(0, pageSep);
+            std::istringstream fields(line.substr(pageSep + 1));
+            if (!(fields >> entry.pageNo >> entry.hotness) ||
+                filesByName.find(entry.filename) == filesByName.end())
+            {
+                continue;
+            }
+            entries.push_back(entry);
+        }
+
+        // If the pool has shrunk since the dump was taken, keeping only the hottest pages
+        if (entries.size() > numBufs)
+        {
+            std::nth_element(entries.begin(), entries.begin() + numBufs, entries.end(),
+                             [](const PoolDumpEntry &a, const PoolDumpEntry &b)
+                             {
+                                 return a.hotness > b.hotness;
+                             });
+            entries.resize(numBufs);
+        }
+
+        // Sorting by file and page number so that pages are reloaded sequentially
+        std::sort(entries.begin(), entries.end(),
+                  [](const PoolDumpEntry &a, const PoolDumpEntry &b)
+                  {
+                      return a.filename != b.filename ? a.filename < b.filename : a.pageNo < b.pageNo;
+                  });
+
+        restoreQueue.clear();
+        for (std::size_t i = 0; i < entries.size(); i++)
+        {
+            restoreQueue.push_back(std::make_pair(filesByName[entries[i].filename], entries[i].pageNo));
+        }
+        restorePos = 0;
+        restoreFrame = 0;
+
+        return restoreQueue.size();
+    }
+
+    bool BufMgr::findFreeFrame(FrameId &frame)
+    {
+        for (; restoreFrame < numBufs; restoreFrame++)
+        {
+            if (!bufDescTable[restoreFrame].valid)
+            {
+                frame = restoreFrame++;
+                return true;
+            }
+        }
+        return false;
+    }
+
+    std::uint32_t BufMgr::restorePool(const std::uint32_t maxPages)
+    {
+        std::uint32_t loaded = 0;
+        while (loaded < maxPages && isRestorePending())
+        {
+            File *file = restoreQueue[restorePos].first;
+            const PageId first = restoreQueue[restorePos].second;
+
+            // Skipping pages that a foreground read has already brought in
+            FrameId residentFrame;
+            if (hashTable->lookup(file, first, residentFrame))
+            {
+                restorePos++;
+                continue;
+            }
+
+            // Extending the run over the queued pages which follow in the file, as far as free frames allow
+            std::vector<FrameId> frames;
+            FrameId frameNo;
+            while (loaded + frames.size() < maxPages && findFreeFrame(frameNo))
+            {
+                frames.push_back(frameNo);
+                const std::size_t next = restorePos + frames.size();
+                if (next == restoreQueue.size() || restoreQueue[next].first != file ||
+                    restoreQueue[next].second != first + frames.size() ||
+                    hashTable->lookup(file, restoreQueue[next].second, residentFrame))
+                {
+                    break;
+                }
+            }
+            if (frames.empty())
+            {
+                // No free frames are left, so foreground reads have filled the pool.
+                // Restoring the rest would only evict their pages.
+                restoreQueue.clear();
+                restorePos = 0;
+                break;
+            }
+            restorePos += frames.size();
+
+            const std::uint64_t start = latencyTracking ? readCycleCounter() : 0;
+            const std::vector<Page> pages = file->readPageRun(first, frames.size());
+            recordLatency(FILE_READ, start);
+            bufStats.diskreads += frames.size();
+
+            // Pages deleted or damaged since the dump was taken are missing from the run
+            for (std::size_t i = 0; i < pages.size(); i++)
+            {
+                frameNo = frames[i];
+                const PageId pageNo = pages[i].page_number();
+                bufPool[frameNo] = pages[i];
+                rememberLoggedImage(file, frameNo);
+                hashTable->insert(file, pageNo, frameNo);
+
+                // Restored pages are unpinned and not recently referenced,
+                // so they are the first to go if foreground reads need room
+                bufDescTable[frameNo].Set(file, pageNo);
+                bufDescTable[frameNo].pinCnt = 0;
+                bufDescTable[frameNo].refbit = false;
+                loaded++;
+            }
+            // Frames left over are searched again from the first of them
+            if (pages.size() < frames.size())
+            {
+                restoreFrame = frames[pages.size()];
+            }
+        }
+        return loaded;
+    }
+}
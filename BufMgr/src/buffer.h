@@ -7,8 +7,18 @@
 
 #pragma once
 
+#include <fstream>
+#include <iostream>
+#include <map>
+#include <memory>
+#include <string>
+#include <vector>
 #include "file.h"
 #include "bufHashTbl.h"
+#include "access_trace.h"
+#include "latency_histogram.h"
+#include "mrc_estimator.h"
+#include "replacement_policy.h"
 
 namespace badgerdb
 {
@@ -47,6 +57,29 @@ namespace badgerdb
          */
         int pinCnt;
 
+        /**
+       * Number of the pins counted in pinCnt which belong to snapshot readers
+         */
+        int snapshotCnt;
+
+        /**
+       * True if the frame holds an old version of a page, kept for its snapshot readers after a writer moved on
+       * to a copy. Version frames are not in the hash table and are freed when their last reader releases them.
+         */
+        bool version;
+
+        /**
+       * True if the frame is pinned by a writer and BufMgr::cleanImages holds the page as it was before the
+       * writer's changes, for snapshot readers arriving meanwhile
+         */
+        bool cleanImage;
+
+        /**
+       * Number of the pins counted in pinCnt which may belong to writers still changing the page. Pins taken with
+       * readPageForUpdate() count until unpinned dirty, or until fewer pins are left than are counted here.
+         */
+        int writerCnt;
+
         /**
        * True if page is dirty;  false otherwise
          */
@@ -62,17 +95,28 @@ namespace badgerdb
          */
         bool refbit;
 
+        /**
+       * Number of times the page has been accessed since it was brought into this frame.
+       * Used as the page's hotness when the buffer pool is dumped.
+         */
+        std::uint32_t accessCnt;
+
         /**
        * Initialize buffer frame for a new user
          */
         void Clear()
         {
             pinCnt = 0;
+            snapshotCnt = 0;
+            version = false;
+            cleanImage = false;
+            writerCnt = 0;
             file = NULL;
             pageNo = Page::INVALID_NUMBER;
             dirty = false;
             refbit = false;
             valid = false;
+            accessCnt = 0;
         };
 
         /**
@@ -87,9 +131,14 @@ namespace badgerdb
             file = filePtr;
             pageNo = pageNum;
             pinCnt = 1;
+            snapshotCnt = 0;
+            version = false;
+            cleanImage = false;
+            writerCnt = 0;
             dirty = false;
             valid = true;
             refbit = true;
+            accessCnt = 1;
         }
 
         void Print()
@@ -104,8 +153,11 @@ namespace badgerdb
 
             std::cout << "valid:" << valid << " ";
             std::cout << "pinCnt:" << pinCnt << " ";
+            std::cout << "snapshotCnt:" << snapshotCnt << " ";
+            std::cout << "version:" << version << " ";
             std::cout << "dirty:" << dirty << " ";
-            std::cout << "refbit:" << refbit << "\n";
+            std::cout << "refbit:" << refbit << " ";
+            std::cout << "accessCnt:" << accessCnt << "\n";
         }
 
         /**
@@ -120,30 +172,132 @@ namespace badgerdb
 
 /**
 * @brief Class to maintain statistics of buffer usage 
+*
+* The buffer manager is single threaded, so the counters are plain integers owned by the pool and cost one
+* increment each. A snapshot is simply a copy, and the difference of two snapshots gives the activity in between.
 */
     struct BufStats
     {
         /**
        * Total number of accesses to buffer pool
          */
-        int accesses;
+        std::uint64_t accesses;
+
+        /**
+       * Number of readPage() calls which found the page in the buffer pool
+         */
+        std::uint64_t hits;
+
+        /**
+       * Number of readPage() calls which had to read the page from disk
+         */
+        std::uint64_t misses;
 
         /**
        * Number of pages read from disk (including allocs)
          */
-        int diskreads;
+        std::uint64_t diskreads;
 
         /**
        * Number of pages written back to disk
          */
-        int diskwrites;
+        std::uint64_t diskwrites;
+
+        /**
+       * Number of clean pages evicted to make room for another page
+         */
+        std::uint64_t cleanEvictions;
+
+        /**
+       * Number of dirty pages evicted to make room for another page
+         */
+        std::uint64_t dirtyEvictions;
+
+        /**
+       * Number of pages written back because they were evicted
+         */
+        std::uint64_t evictionWrites;
+
+        /**
+       * Number of pages written back by flushFile()
+         */
+        std::uint64_t flushWrites;
+
+        /**
+       * Number of pages written back by checkpoint()
+         */
+        std::uint64_t checkpointWrites;
+
+        /**
+       * Number of dirty pages written back early, in the same batch as an evicted page of a doublewrite file
+         */
+        std::uint64_t batchedWrites;
+
+        /**
+       * Number of pages copied to a new frame so that a writer could proceed while snapshot readers kept the old version
+         */
+        std::uint64_t versionCopies;
+
+        /**
+       * Number of frame allocations which found every frame pinned and would have had to wait for an unpin
+         */
+        std::uint64_t pinWaits;
+
+        /**
+       * Number of pinned frames passed over by the clock hand
+         */
+        std::uint64_t pinnedSkips;
+
+        /**
+       * Total distance travelled by the clock hand while looking for victims
+         */
+        std::uint64_t clockSweeps;
 
         /**
        * Clear all values
          */
         void clear()
         {
-            accesses = diskreads = diskwrites = 0;
+            accesses = hits = misses = diskreads = diskwrites = 0;
+            cleanEvictions = dirtyEvictions = 0;
+            evictionWrites = flushWrites = checkpointWrites = batchedWrites = 0;
+            pinWaits = pinnedSkips = clockSweeps = 0;
+            versionCopies = 0;
+        }
+
+        /**
+         * Returns the activity between an earlier snapshot and this one.
+         *
+         * @param since	Earlier snapshot of the same buffer pool
+         * @return		Counters holding the difference of each value
+         */
+        BufStats delta(const BufStats &since) const
+        {
+            BufStats d;
+            d.accesses = accesses - since.accesses;
+            d.hits = hits - since.hits;
+            d.misses = misses - since.misses;
+            d.diskreads = diskreads - since.diskreads;
+            d.diskwrites = diskwrites - since.diskwrites;
+            d.cleanEvictions = cleanEvictions - since.cleanEvictions;
+            d.dirtyEvictions = dirtyEvictions - since.dirtyEvictions;
+            d.evictionWrites = evictionWrites - since.evictionWrites;
+            d.flushWrites = flushWrites - since.flushWrites;
+            d.checkpointWrites = checkpointWrites - since.checkpointWrites;
+            d.batchedWrites = batchedWrites - since.batchedWrites;
+            d.pinWaits = pinWaits - since.pinWaits;
+            d.pinnedSkips = pinnedSkips - since.pinnedSkips;
+            d.clockSweeps = clockSweeps - since.clockSweeps;
+            d.versionCopies = versionCopies - since.versionCopies;
+            return d;
+        }
+
+        /**
+         * Returns the fraction of readPage() calls served from the buffer pool.
+         */
+        double hitRatio() const
+        {
+            return hits + misses == 0 ? 0.0 : (double) hits / (double) (hits + misses);
         }
 
         /**
@@ -156,11 +310,90 @@ namespace badgerdb
     };
 
 
+/**
+* @brief Frames of the buffer pool held by one file
+*/
+    struct FileFrameStats
+    {
+        /**
+       * Number of pages of the file resident in the buffer pool
+         */
+        std::uint32_t residentPages;
+
+        /**
+       * Number of resident pages of the file which are dirty
+         */
+        std::uint32_t dirtyPages;
+
+        /**
+       * Number of resident pages of the file which are pinned
+         */
+        std::uint32_t pinnedPages;
+
+        /**
+       * Constructor of FileFrameStats class
+         */
+        FileFrameStats() : residentPages(0), dirtyPages(0), pinnedPages(0)
+        {
+        }
+    };
+
+
+/**
+* @brief Buffer manager operations whose latencies are recorded in histograms
+*/
+    enum BufOp
+    {
+        READ_HIT,	///< readPage() of a page already in the buffer pool
+        READ_MISS,	///< readPage() of a page which had to be read from disk
+        ALLOC,		///< allocPage()
+        UNPIN,		///< unPinPage()
+        FLUSH,		///< flushFile()
+        EVICT,		///< Finding and evicting a victim frame, including its write-back
+        FILE_READ,	///< Underlying File::readPage() call
+        FILE_WRITE,	///< Underlying File::writePage() call
+        NUM_BUF_OPS
+    };
+
+
+/**
+* @brief A page recorded in a buffer pool dump together with how hot it was when the dump was taken
+*/
+    struct PoolDumpEntry
+    {
+        /**
+       * Name of the file to which the page belongs
+         */
+        std::string filename;
+
+        /**
+       * Page number within the file
+         */
+        PageId pageNo;
+
+        /**
+       * Number of accesses to the page while it was resident
+         */
+        std::uint32_t hotness;
+    };
+
+
 /**
 * @brief The central class which manages the buffer pool including frame allocation and deallocation to pages in the file 
 */
     class BufMgr
     {
+    public:
+        /**
+       * Largest number of pages written back in one batch when a page of a doublewrite file is evicted
+         */
+        static const std::uint32_t MAX_WRITE_BATCH = 64;
+
+        /**
+       * Number of frames a periodic dump of the buffer pool writes per page access
+         */
+        static const std::uint32_t POOL_DUMP_SLICE = 64;
+
     private:
         /**
        * Current position of clockhand in our buffer pool
@@ -188,9 +421,221 @@ namespace badgerdb
         BufStats bufStats;
 
         /**
-       * Advance clock to next frame in the buffer pool
+       * True if latencies of buffer operations are being recorded
+         */
+        bool latencyTracking;
+
+        /**
+       * Latency histogram of each buffer operation, in cycle counter ticks
+         */
+        LatencyHistogram latency[NUM_BUF_OPS];
+
+        /**
+       * Recorder of page accesses, or NULL if accesses are not traced
+         */
+        AccessTracer *tracer;
+
+        /**
+       * Estimator of the hit ratio at other pool sizes, or NULL if estimation is disabled
+         */
+        MrcEstimator *mrcEstimator;
+
+        /**
+       * File the buffer pool is dumped to at shutdown and every poolDumpInterval accesses. Empty if disabled.
+         */
+        std::string poolDumpFile;
+
+        /**
+       * Number of page accesses between periodic dumps of the buffer pool. 0 means dump only at shutdown.
+         */
+        std::uint32_t poolDumpInterval;
+
+        /**
+       * Number of page accesses since the buffer pool was last dumped
+         */
+        std::uint32_t accessesSinceDump;
+
+        /**
+       * Temporary file a periodic dump is being written to, a slice of frames per page access. Closed if no
+       * periodic dump is in progress.
+         */
+        std::ofstream poolDumpOut;
+
+        /**
+       * Next frame to be written by the periodic dump in progress
+         */
+        FrameId poolDumpPos;
+
+        /**
+       * Pages waiting to be reloaded by restorePool(), sorted by file and page number
+         */
+        std::vector<std::pair<File *, PageId> > restoreQueue;
+
+        /**
+       * Position of the next page in restoreQueue to be reloaded
+         */
+        std::uint32_t restorePos;
+
+        /**
+       * Frame from which restorePool() continues its search for free frames
+         */
+        FrameId restoreFrame;
+
+        /**
+       * Contents of each frame holding a page of a logged file as of its last log record, which the changes made
+       * to the page are compared against when it is unpinned dirty. Allocated the first time a frame holds such a page.
+         */
+        std::vector<std::unique_ptr<Page> > loggedImages;
+
+        /**
+       * Contents of each frame pinned by writers as of before their changes, valid while BufDesc::cleanImage is set.
+       * Allocated the first time a writer pins a page in the frame.
+         */
+        std::vector<std::unique_ptr<Page> > cleanImages;
+
+        /**
+         * @brief View of the frame table in the form clockFindVictim() expects
+         */
+        class FrameTable
+        {
+        public:
+            FrameTable(BufDesc *descTable, std::uint32_t frameCount) : descs(descTable), numFrames(frameCount)
+            {
+            }
+
+            std::uint32_t size() const
+            {
+                return numFrames;
+            }
+
+            bool valid(FrameId frame) const
+            {
+                return descs[frame].valid;
+            }
+
+            int pinCount(FrameId frame) const
+            {
+                return descs[frame].pinCnt;
+            }
+
+            bool refbit(FrameId frame) const
+            {
+                return descs[frame].refbit;
+            }
+
+            void clearRefbit(FrameId frame)
+            {
+                descs[frame].refbit = false;
+            }
+
+        private:
+            BufDesc *descs;
+            std::uint32_t numFrames;
+        };
+
+        /**
+         * Records the latency of an operation if latency tracking is enabled.
+         *
+         * @param op			Operation whose latency is recorded
+         * @param startCycles	Cycle counter value when the operation started
+         */
+        void recordLatency(const BufOp op, const std::uint64_t startCycles);
+
+        /**
+         * Reads a page from its file into a frame.
+         *
+         * @param file   	File object
+         * @param pageNo  	Page number in the file
+         * @param frameNo 	Frame the page is read into
+         */
+        void readFrame(File *file, const PageId pageNo, const FrameId frameNo);
+
+        /**
+         * Writes the page held in a frame back to its file. The dirty bit is left untouched.
+         *
+         * @param frameNo 	Frame whose page is written
+         */
+        void writeFrame(const FrameId frameNo);
+
+        /**
+         * Writes the pages held in several frames back to their file as one batch, which a doublewrite file
+         * makes durable with two syncs in all. The log is forced once for the whole batch. The dirty bits are
+         * left untouched.
+         *
+         * @param file   	File the pages belong to
+         * @param frames 	Frames whose pages are written
+         */
+        void writeFrames(File *file, const std::vector<FrameId> &frames);
+
+        /**
+         * Returns the dirty, unpinned frames of a file other than the given one, up to one batch in all.
+         * Evicting a page of a doublewrite file writes these back along with it.
+         *
+         * @param victim 	Frame being evicted
+         * @return  		Victim followed by the frames to write back with it
+         */
+        std::vector<FrameId> collectWriteBatch(const FrameId victim) const;
+
+        /**
+         * Remembers the contents of a frame just filled with a page of a logged file, so that changes to it can be
+         * logged. Does nothing for files which are not logged.
+         *
+         * @param file   	File object
+         * @param frameNo 	Frame holding the page
+         */
+        void rememberLoggedImage(File *file, const FrameId frameNo);
+
+        /**
+         * Pins a page, reading it into a frame if it is not in the buffer pool. Frames pinned by snapshot readers
+         * are never shared with other callers: a snapshot reader of a page pinned by others gets a version frame
+         * of its own, and any other caller of a page pinned by snapshot readers moves the page to a new frame.
+         *
+         * @param file   	File object
+         * @param pageNo  	Page number in the file
+         * @param page  	Reference to page pointer, set to the pinned page. Left untouched if no frame is free.
+         * @param snapshot	True if the pin belongs to a snapshot reader
+         */
+        void pinPage(File *file, const PageId pageNo, Page *&page, const bool snapshot);
+
+        /**
+         * Gives a caller which may not share the frame holding a page a frame of its own. For a snapshot reader
+         * this is a version frame holding the page as it was before any writer pinned it. For anyone else the new
+         * frame becomes the current version of the page and the old frame is left to its snapshot readers.
+         *
+         * @param file   	File object
+         * @param pageNo  	Page number in the file
+         * @param frameNo 	Frame currently holding the page, set to the new frame
+         * @param snapshot	True if the caller is a snapshot reader
+         * @return  		false if every frame is pinned
+         */
+        bool splitVersion(File *file, const PageId pageNo, FrameId &frameNo, const bool snapshot);
+
+        /**
+         * Records a page access and dumps the buffer pool if the periodic dump interval has elapsed.
          */
-        void advanceClock();
+        void notePageAccess();
+
+        /**
+         * Finds a frame which does not hold any page without evicting anything.
+         *
+         * @param frame   	Frame reference, frame ID of the free frame returned via this variable
+         * @return  		true if a free frame was found. Else false.
+         */
+        bool findFreeFrame(FrameId &frame);
+
+        /**
+         * Writes the dump entries of a range of frames.
+         *
+         * @param out   	Stream to write to
+         * @param first 	First frame of the range
+         * @param last  	Frame just past the range
+         */
+        void writePoolDumpEntries(std::ostream &out, const FrameId first, const FrameId last) const;
+
+        /**
+         * Drops a periodic dump in progress, leaving the previous dump in place.
+         */
+        void abandonPoolDump();
 
         /**
          * Allocate a free frame.
@@ -220,6 +665,7 @@ namespace badgerdb
          * Reads the given page from the file into a frame and returns the pointer to page.
          * If the requested page is already present in the buffer pool pointer to that frame is returned
          * otherwise a new frame is allocated from the buffer pool for reading the page.
+         * If snapshot readers hold the page, it is moved to a new frame first, as readPageForUpdate() does.
          *
          * @param file   	File object
          * @param PageNo  Page number in the file to be read
@@ -237,6 +683,43 @@ namespace badgerdb
          */
         void unPinPage(File *file, const PageId PageNo, const bool dirty);
 
+        /**
+         * Pins a page for a snapshot reader, which sees the page as it is now for as long as it holds the pin.
+         * Snapshot readers never share a frame with anyone else, so the reader is never blocked and never sees a
+         * change: callers pinning the page afterwards get a copy of it to work on, and if writers hold the page
+         * already, the reader gets a copy of the page as it was before their changes. A frame pinned through
+         * readPage() counts as unchanged unless readPageForUpdate() has pinned it too.
+         * Release the pin with releaseSnapshot(), not unPinPage().
+         *
+         * @param file   	File object
+         * @param PageNo  Page number in the file to be read
+         * @param page  	Reference to page pointer. The version of the page seen by the reader is returned via this
+         * 					reference. Left untouched if a frame is needed and every frame is pinned.
+         */
+        void readPageSnapshot(File *file, const PageId PageNo, const Page *&page);
+
+        /**
+         * Releases the pin of a snapshot reader. An old version of a page is dropped from the buffer pool once its
+         * last reader has released it.
+         *
+         * @param page  	Page returned by readPageSnapshot()
+       * @throws  PageNotPinnedException If the page is not in the buffer pool or not pinned by a snapshot reader
+         */
+        void releaseSnapshot(const Page *page);
+
+        /**
+         * Pins a page which the caller is going to change, as readPage() does, and keeps a copy of the page as it
+         * was before the change for snapshot readers arriving while writers hold the page. The copy is brought up
+         * to date when the last writer unpins the page dirty while others still hold it, so that it never holds a
+         * change another writer is part way through. Other writers share the frame with this one as usual.
+         *
+         * @param file   	File object
+         * @param PageNo  Page number in the file to be read
+         * @param page  	Reference to page pointer. The current version of the page is returned via this reference.
+         * 					Left untouched if a frame is needed and every frame is pinned.
+         */
+        void readPageForUpdate(File *file, const PageId PageNo, Page *&page);
+
         /**
          * Allocates a new, empty page in the file and returns the Page object.
          * The newly allocated page is also assigned a frame in the buffer pool.
@@ -248,7 +731,8 @@ namespace badgerdb
         void allocPage(File *file, PageId &PageNo, Page *&page);
 
         /**
-         * Writes out all dirty pages of the file to disk.
+         * Writes out all dirty pages of the file to disk, followed by the file header.
+         * The write-ahead log of a logged file is emptied afterwards.
          * All the frames assigned to the file need to be unpinned from buffer pool before this function can be successfully called.
          * Otherwise Error returned.
          *
@@ -272,6 +756,148 @@ namespace badgerdb
          */
         void printSelf();
 
+        /**
+       * Returns the number of frames in the buffer pool
+         */
+        std::uint32_t numFrames() const
+        {
+            return numBufs;
+        }
+
+        /**
+         * Counts the resident, dirty and pinned pages of every file which has pages in the buffer pool.
+         * This walks the whole frame table, so it is meant for occasional introspection rather than hot paths.
+         *
+         * @return  Map from file name to the frames held by that file
+         */
+        std::map<std::string, FileFrameStats> collectFileFrameStats() const;
+
+        /**
+         * Writes the (file, page) ids of all resident pages together with their hotness to the given file.
+         * The dump is written to a temporary file first and renamed over dumpFile, so a crash while dumping
+         * never leaves a truncated dump behind.
+         *
+         * @param dumpFile	Name of the dump file
+         */
+        void dumpPool(const std::string &dumpFile);
+
+        /**
+         * Enables dumping of the buffer pool to the given file when the buffer manager is destroyed and,
+         * if interval is non-zero, after every interval page accesses. A periodic dump is written
+         * POOL_DUMP_SLICE frames per page access rather than all at once, so that no access waits for the whole
+         * pool to be written; pages may change while it is written, which only matters as much as a stale hint.
+         *
+         * @param dumpFile	Name of the dump file. An empty name disables dumping.
+         * @param interval	Number of page accesses between periodic dumps. 0 dumps only at shutdown.
+         */
+        void setPoolDump(const std::string &dumpFile, const std::uint32_t interval);
+
+        /**
+         * Reads a dump written by dumpPool() and queues its pages to be reloaded by restorePool().
+         * If the dump holds more pages than there are frames, only the hottest pages are kept.
+         * The queued pages are sorted by file and page number so that they are reloaded with sequential reads.
+         * Pages of files not present in files are ignored.
+         *
+         * @param dumpFile	Name of the dump file
+         * @param files		Open files whose pages may be reloaded
+         * @return  		Number of pages queued for reloading
+         */
+        std::uint32_t loadPoolDump(const std::string &dumpFile, const std::vector<File *> &files);
+
+        /**
+         * Reloads up to maxPages queued pages into frames which are currently free. Pages are loaded unpinned and
+         * with their refbit cleared, and no page is ever evicted to make room for them, so foreground reads always
+         * take priority. Runs of queued pages which follow each other in a file are read with a single read.
+         * Pages which were deleted or damaged since the dump was taken are skipped.
+         * Call this repeatedly while the system is idle until isRestorePending() returns false.
+         *
+         * @param maxPages	Maximum number of pages to read in this call
+         * @return  		Number of pages actually read
+         */
+        std::uint32_t restorePool(const std::uint32_t maxPages);
+
+        /**
+         * Returns true if pages queued by loadPoolDump() are still waiting to be reloaded.
+         */
+        bool isRestorePending() const
+        {
+            return restorePos < restoreQueue.size();
+        }
+
+        /**
+         * Writes out all dirty pages in the buffer pool without evicting them,
+         * and the headers of the files they belong to.
+         * Unlike flushFile(), pinned pages are written too and all pages stay resident.
+         */
+        void checkpoint();
+
+        /**
+         * Enables or disables recording of operation latencies. Disabled by default.
+         *
+         * @param enabled	True to record latencies
+         */
+        void setLatencyTracking(const bool enabled);
+
+        /**
+         * Returns the latency histogram of a buffer operation. Histograms are in cycle counter ticks and can be
+         * merged with those of other buffer managers.
+         *
+         * @param op	Buffer operation
+         */
+        const LatencyHistogram &getLatencyHistogram(const BufOp op) const
+        {
+            return latency[op];
+        }
+
+        /**
+         * Returns the latency of a buffer operation at the given percentile, in nanoseconds.
+         *
+         * @param op			Buffer operation
+         * @param percentile	Fraction between 0 and 1, e.g. 0.999 for p999
+         */
+        double latencyPercentile(const BufOp op, const double percentile) const;
+
+        /**
+         * Discards all recorded latencies.
+         */
+        void clearLatencyHistograms();
+
+        /**
+         * Starts or stops recording every readPage(), allocPage(), unPinPage() and disposePage() call.
+         * The tracer is not owned by the buffer manager and must outlive its use.
+         *
+         * @param accessTracer	Recorder of page accesses, or NULL to stop tracing
+         */
+        void setAccessTracer(AccessTracer *accessTracer)
+        {
+            tracer = accessTracer;
+        }
+
+        /**
+         * Starts estimating the miss ratio curve of the page accesses from now on, replacing any earlier
+         * estimate. Reads and allocations of a sample of the pages are tracked, so that predictedHitRatio()
+         * can tell how the pool would do with a different number of frames.
+         *
+         * @param samplingRate	Fraction of pages to track, e.g. 0.01. 0 disables estimation.
+         */
+        void enableMrcEstimation(const double samplingRate);
+
+        /**
+         * Returns the hit ratio the buffer pool would have had with the given number of frames, estimated from
+         * the accesses since enableMrcEstimation(). Returns 0 if estimation is disabled.
+         *
+         * @param frames	Number of frames in the hypothetical pool
+         */
+        double predictedHitRatio(const std::uint32_t frames) const;
+
+        /**
+         * Returns the miss ratio curve estimator, or NULL if estimation is disabled.
+         */
+        const MrcEstimator *getMrcEstimator() const
+        {
+            return mrcEstimator;
+        }
+
         /**
        * Get buffer pool usage statistics
          */
@@ -280,6 +906,15 @@ namespace badgerdb
             return bufStats;
         }
 
+        /**
+       * Get a copy of the buffer pool usage statistics. Use BufStats::delta() on two snapshots to get the
+       * activity in between.
+         */
+        BufStats snapshotBufStats() const
+        {
+            return bufStats;
+        }
+
         /**
        * Clear buffer pool usage statistics
          */
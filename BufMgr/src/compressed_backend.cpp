@@ -0,0 +1,270 @@
+/**
+ * @author See Contributors.txt for code contributors and overview of BadgerDB.
+ *
+ * @section LICENSE
+ * Copyright (c) 2012 Database Group, Computer Sciences Department, University of Wisconsin-Madison.
+ */
+
+#include "compressed_backend.h"
+
+#include <algorithm>
+#include <cstddef>
+#include <cstring>
+
+#include "crc32c.h"
+#include "lz_codec.h"
+
+namespace badgerdb {
+
+const std::size_t CompressedBackend::SLOT_UNIT;
+const std::uint32_t CompressedBackend::FREE_BLOCK;
+
+CompressedBackend::CompressedBackend(std::shared_ptr<FileBackend> backend,
+                                     const std::uint64_t prefix_size,
+                                     const std::size_t block_size,
+                                     const bool create)
+    : backend_(backend),
+      prefix_size_(prefix_size),
+      block_size_(block_size),
+      num_units_(0),
+      generation_(0),
+      damaged_(false) {
+  if (create) {
+    const std::uint64_t num_units = 0;
+    backend_->write(prefix_size_, reinterpret_cast<const char*>(&num_units),
+                    sizeof(num_units));
+  } else {
+    scanSlots();
+  }
+}
+
+void CompressedBackend::read(const std::uint64_t offset, char* data,
+                             const std::size_t length) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  std::size_t done = 0;
+  if (offset < prefix_size_) {
+    done = std::min<std::uint64_t>(length, prefix_size_ - offset);
+    backend_->read(offset, data, done);
+  }
+  std::vector<char> block;
+  while (done < length) {
+    const std::uint64_t position = offset + done - prefix_size_;
+    const std::uint32_t number =
+        static_cast<std::uint32_t>(position / block_size_);
+    const std::size_t within = position % block_size_;
+    const std::size_t count = std::min(length - done, block_size_ - within);
+    if (count == block_size_) {
+      readBlock(number, data + done);
+    } else {
+      block.resize(block_size_);
+      readBlock(number, &block[0]);
+      std::memcpy(data + done, &block[within], count);
+    }
+    done += count;
+  }
+}
+
+void CompressedBackend::write(const std::uint64_t offset, const char* data,
+                              const std::size_t length) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  std::size_t done = 0;
+  if (offset < prefix_size_) {
+    done = std::min<std::uint64_t>(length, prefix_size_ - offset);
+    backend_->write(offset, data, done);
+  }
+  std::vector<char> block;
+  while (done < length) {
+    const std::uint64_t position = offset + done - prefix_size_;
+    const std::uint32_t number =
+        static_cast<std::uint32_t>(position / block_size_);
+    const std::size_t within = position % block_size_;
+    const std::size_t count = std::min(length - done, block_size_ - within);
+    if (count == block_size_) {
+      writeBlock(number, data + done);
+    } else {
+      block.resize(block_size_);
+      readBlock(number, &block[0]);
+      std::memcpy(&block[within], data + done, count);
+      writeBlock(number, &block[0]);
+    }
+    done += count;
+  }
+}
+
+void CompressedBackend::flush() {
+  backend_->flush();
+}
+
+void CompressedBackend::sync() {
+  backend_->sync();
+}
+
+void CompressedBackend::scanSlots() {
+  std::uint64_t num_units = 0;
+  backend_->read(prefix_size_, reinterpret_cast<char*>(&num_units),
+                 sizeof(num_units));
+  num_units_ = static_cast<std::uint32_t>(num_units);
+  std::uint32_t unit = 0;
+  while (unit < num_units_) {
+    SlotHeader header;
+    backend_->read(unitPosition(unit), reinterpret_cast<char*>(&header),
+                   sizeof(header));
+    const Slot found = {unit, header.units, header.length, header.generation,
+                        header.checksum};
+    if (!headerValid(header, num_units_ - unit)) {
+      // The size of the slot is lost with its header, so look for the next
+      // slot one unit at a time.  The units skipped are never reused.
+      damaged_ = true;
+      ++unit;
+      continue;
+    }
+    generation_ = std::max(generation_, header.generation);
+    if (header.block == FREE_BLOCK) {
+      if (free_slots_.size() <= header.units) {
+        free_slots_.resize(header.units + 1);
+      }
+      free_slots_[header.units].push_back(unit);
+    } else {
+      if (header.block >= slots_.size()) {
+        slots_.resize(header.block + 1, Slot());
+      }
+      Slot& slot = slots_[header.block];
+      if (slot.units == 0) {
+        slot = found;
+      } else {
+        // A crash while the block was rewritten left it in two slots.  The
+        // newer copy wins unless its write was torn.
+        const Slot newer = slot.generation < found.generation ? found : slot;
+        const Slot older = slot.generation < found.generation ? slot : found;
+        const bool newer_intact = slotIntact(newer);
+        slot = newer_intact ? newer : older;
+        const Slot& loser = newer_intact ? older : newer;
+        freeSlot(loser.first_unit, loser.units);
+      }
+    }
+    unit += header.units;
+  }
+}
+
+std::uint32_t CompressedBackend::headerChecksum(const SlotHeader& header) {
+  return crc32c(reinterpret_cast<const char*>(&header),
+                offsetof(SlotHeader, header_checksum));
+}
+
+bool CompressedBackend::headerValid(const SlotHeader& header,
+                                    const std::uint32_t units) const {
+  if (header.header_checksum != headerChecksum(header) ||
+      header.units == 0 || header.units > units) {
+    return false;
+  }
+  if (header.block == FREE_BLOCK) {
+    return header.length == 0 && header.generation == 0 &&
+        header.checksum == 0;
+  }
+  return header.length != 0 && header.length <= block_size_ &&
+      sizeof(SlotHeader) + header.length <=
+          static_cast<std::uint64_t>(header.units) * SLOT_UNIT;
+}
+
+bool CompressedBackend::slotIntact(const Slot& slot) {
+  std::vector<char> stored(slot.length);
+  backend_->read(unitPosition(slot.first_unit) + sizeof(SlotHeader),
+                 &stored[0], slot.length);
+  return crc32c(&stored[0], slot.length) == slot.checksum;
+}
+
+void CompressedBackend::readBlock(const std::uint32_t block, char* data) {
+  if (block >= slots_.size() || slots_[block].units == 0) {
+    // Not zeros if the block may have been in a slot with a damaged header,
+    // which File would take for a page never written, so that page
+    // checksums catch the damage.
+    std::memset(data, damaged_ ? 0xff : 0, block_size_);
+    return;
+  }
+  const Slot& slot = slots_[block];
+  const std::uint64_t position = unitPosition(slot.first_unit) +
+      sizeof(SlotHeader);
+  if (slot.length == block_size_) {
+    backend_->read(position, data, block_size_);
+    if (crc32c(data, block_size_) != slot.checksum) {
+      std::memset(data, 0xff, block_size_);
+    }
+    return;
+  }
+  std::vector<char> stored(slot.length);
+  backend_->read(position, &stored[0], slot.length);
+  if (crc32c(&stored[0], slot.length) != slot.checksum ||
+      !lzDecompress(&stored[0], slot.length, data, block_size_)) {
+    std::memset(data, 0xff, block_size_);
+  }
+}
+
+void CompressedBackend::writeBlock(const std::uint32_t block,
+                                   const char* data) {
+  std::vector<char> stored(sizeof(SlotHeader) + block_size_);
+  std::size_t length = lzCompress(data, block_size_,
+                                  &stored[sizeof(SlotHeader)], block_size_ - 1);
+  if (length == 0) {
+    length = block_size_;
+    std::memcpy(&stored[sizeof(SlotHeader)], data, block_size_);
+  }
+  std::uint32_t units = static_cast<std::uint32_t>(
+      (sizeof(SlotHeader) + length + SLOT_UNIT - 1) / SLOT_UNIT);
+
+  if (block >= slots_.size()) {
+    slots_.resize(block + 1, Slot());
+  }
+  // Never rewritten in place, so that a torn write leaves the old copy.
+  Slot& slot = slots_[block];
+  const Slot old_slot = slot;
+  const std::uint32_t old_num_units = num_units_;
+  slot.first_unit = allocateSlot(units);
+  slot.units = units;
+  slot.length = static_cast<std::uint32_t>(length);
+  slot.generation = ++generation_;
+  slot.checksum = crc32c(&stored[sizeof(SlotHeader)], length);
+  SlotHeader header = {block, slot.generation, slot.length, slot.units,
+                       slot.checksum, 0 /* header_checksum */};
+  header.header_checksum = headerChecksum(header);
+  std::memcpy(&stored[0], &header, sizeof(header));
+  backend_->write(unitPosition(slot.first_unit), &stored[0],
+                  sizeof(SlotHeader) + length);
+  if (num_units_ != old_num_units) {
+    // Written after the slot so that the slots counted are always there.
+    const std::uint64_t num_units = num_units_;
+    backend_->write(prefix_size_, reinterpret_cast<const char*>(&num_units),
+                    sizeof(num_units));
+  }
+  if (old_slot.units != 0) {
+    freeSlot(old_slot.first_unit, old_slot.units);
+  }
+}
+
+std::uint32_t CompressedBackend::allocateSlot(std::uint32_t& units) {
+  for (std::uint32_t size = units; size < free_slots_.size(); ++size) {
+    if (!free_slots_[size].empty()) {
+      const std::uint32_t first_unit = free_slots_[size].back();
+      free_slots_[size].pop_back();
+      units = size;
+      return first_unit;
+    }
+  }
+  const std::uint32_t first_unit = num_units_;
+  num_units_ += units;
+  return first_unit;
+}
+
+void CompressedBackend::freeSlot(const std::uint32_t first_unit,
+                                 const std::uint32_t units) {
+  SlotHeader header = {FREE_BLOCK, 0 /* generation */, 0 /* length */,
+                       units, 0 /* checksum */, 0 /* header_checksum */};
+  header.header_checksum = headerChecksum(header);
+  backend_->write(unitPosition(first_unit),
+                  reinterpret_cast<const char*>(&header), sizeof(header));
+  if (free_slots_.size() <= units) {
+    free_slots_.resize(units + 1);
+  }
+  free_slots_[units].push_back(first_unit);
+}
+
+}
@@ -0,0 +1,222 @@
+/**
+ * @author See Contributors.txt for code contributors and overview of BadgerDB.
+ *
+ * @section LICENSE
+ * Copyright (c) 2012 Database Group, Computer Sciences Department, University of Wisconsin-Madison.
+ */
+
+#pragma once
+
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+#include "file_backend.h"
+
+namespace badgerdb {
+
+/**
+ * @brief Backend decorator which stores fixed-size blocks compressed.
+ *
+ * The storage seen through the decorator is a prefix of prefix_size bytes
+ * followed by blocks of block_size bytes, which is how File lays out its
+ * header and pages.  The prefix is stored as it is at the start of the wrapped
+ * backend.  Each block is compressed with lzCompress() (or kept as it is if
+ * it does not compress) and stored in a slot of whole SLOT_UNIT byte units
+ * after it.  Blocks never written read as zeros and take no space.
+ *
+ * The slot of each block is found through an indirection map kept in memory.
+ * Every slot starts with a SlotHeader naming its block, so the map is rebuilt
+ * when the storage is opened by reading the slot headers.  A block which is
+ * rewritten moves to a free slot of the right size or to the end of the
+ * storage, and only then is the slot it leaves marked free and reused, so
+ * that a crash during the write leaves the older copy to fall back on.
+ *
+ * Blocks whose stored bytes do not match the checksum in their slot header
+ * read as 0xff bytes rather than zeros, which File would take for a page never
+ * written, so that page checksums catch the damage.  A damaged slot header
+ * hides which block the slot held, so once one is found every block without a
+ * slot reads that way too.
+ *
+ * Writes of part of a block, such as File makes to page links, read, patch
+ * and recompress the whole block.
+ */
+class CompressedBackend : public FileBackend {
+ public:
+  /**
+   * Unit of slot sizes, in bytes.
+   */
+  static const std::size_t SLOT_UNIT = 512;
+
+  /**
+   * Wraps a backend.
+   *
+   * @param backend       Backend storing the compressed data.
+   * @param prefix_size   Number of bytes at the start stored uncompressed.
+   * @param block_size    Size of the blocks after the prefix.
+   * @param create        Whether the backend is empty, rather than holding
+   *                      blocks stored earlier.
+   */
+  CompressedBackend(std::shared_ptr<FileBackend> backend,
+                    const std::uint64_t prefix_size,
+                    const std::size_t block_size, const bool create);
+
+  virtual void read(const std::uint64_t offset, char* data,
+                    const std::size_t length);
+  virtual void write(const std::uint64_t offset, const char* data,
+                     const std::size_t length);
+  virtual void flush();
+  virtual void sync();
+
+  /**
+   * Ignores the reservation; blocks do not map to fixed ranges of the
+   * wrapped storage.
+   */
+  virtual void reserve(const std::uint64_t /* offset */,
+                       const std::uint64_t /* length */) {}
+
+ private:
+  /**
+   * Header at the start of every slot.
+   */
+  struct SlotHeader {
+    /**
+     * Number of the block stored in the slot, or FREE_BLOCK.
+     */
+    std::uint32_t block;
+
+    /**
+     * Value of a counter incremented on every block write, so that the
+     * newest copy wins if a crash leaves a block in two slots.
+     */
+    std::uint32_t generation;
+
+    /**
+     * Number of bytes stored after the header; block_size if the block is
+     * not compressed.
+     */
+    std::uint32_t length;
+
+    /**
+     * Size of the slot in units.
+     */
+    std::uint32_t units;
+
+    /**
+     * CRC-32C of the bytes stored after the header.
+     */
+    std::uint32_t checksum;
+
+    /**
+     * CRC-32C of the fields above, so that a damaged header is not taken
+     * for a slot of some other size or block.
+     */
+    std::uint32_t header_checksum;
+  };
+
+  /**
+   * Entry of the indirection map.
+   */
+  struct Slot {
+    std::uint32_t first_unit;
+    std::uint32_t units;
+    std::uint32_t length;
+    std::uint32_t generation;
+    std::uint32_t checksum;
+  };
+
+  static const std::uint32_t FREE_BLOCK = 0xffffffff;
+
+  /**
+   * Rebuilds the indirection map and free lists from the slot headers.
+   */
+  void scanSlots();
+
+  /**
+   * Returns the checksum of the fields of a slot header before its
+   * header_checksum.
+   */
+  static std::uint32_t headerChecksum(const SlotHeader& header);
+
+  /**
+   * Returns whether a slot header is intact and can describe a slot, which
+   * does not mean that the bytes after it are intact.
+   *
+   * @param header  Header read from the start of a unit.
+   * @param units   Number of units from the start of the slot to the end of
+   *                the storage.
+   */
+  bool headerValid(const SlotHeader& header, const std::uint32_t units) const;
+
+  /**
+   * Returns whether the bytes stored in a slot match their checksum.
+   */
+  bool slotIntact(const Slot& slot);
+
+  /**
+   * Reads a block, or zeros if it has never been written.
+   */
+  void readBlock(const std::uint32_t block, char* data);
+
+  /**
+   * Compresses and stores a block.
+   */
+  void writeBlock(const std::uint32_t block, const char* data);
+
+  /**
+   * Finds a slot of at least the given size, taking the smallest free slot
+   * which is large enough or else growing the storage.
+   *
+   * @param units   Size of slot needed; set to the size of the slot found.
+   * @return  First unit of the slot.
+   */
+  std::uint32_t allocateSlot(std::uint32_t& units);
+
+  /**
+   * Marks a slot free on disk and adds it to the free lists.
+   */
+  void freeSlot(const std::uint32_t first_unit, const std::uint32_t units);
+
+  /**
+   * Returns the position of a unit in the wrapped storage.
+   */
+  std::uint64_t unitPosition(const std::uint32_t unit) const {
+    return prefix_size_ + sizeof(std::uint64_t) +
+        static_cast<std::uint64_t>(unit) * SLOT_UNIT;
+  }
+
+  std::shared_ptr<FileBackend> backend_;
+  const std::uint64_t prefix_size_;
+  const std::size_t block_size_;
+
+  /**
+   * Protects everything below.
+   */
+  std::mutex mutex_;
+
+  /**
+   * Slot of every block, indexed by block number; blocks without a slot have
+   * no units.
+   */
+  std::vector<Slot> slots_;
+
+  /**
+   * First units of free slots, indexed by their size in units.
+   */
+  std::vector<std::vector<std::uint32_t> > free_slots_;
+
+  /**
+   * Number of units in use or free, stored after the prefix.
+   */
+  std::uint32_t num_units_;
+
+  std::uint32_t generation_;
+
+  /**
+   * Whether a slot header was found damaged when the storage was opened.
+   */
+  bool damaged_;
+};
+
+}
@@ -0,0 +1,98 @@
+/**
+ * @author See Contributors.txt for code contributors and overview of BadgerDB.
+ *
+ * @section LICENSE
+ * Copyright (c) 2012 Database Group, Computer Sciences Department, University of Wisconsin-Madison.
+ */
+
+#include "crc32c.h"
+
+#include <cstring>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#endif
+
+namespace badgerdb {
+
+namespace {
+
+/**
+ * CRC-32C polynomial, bit reversed.
+ */
+const std::uint32_t POLYNOMIAL = 0x82f63b78;
+
+struct Crc32cTable {
+  Crc32cTable() {
+    for (std::uint32_t byte = 0; byte < 256; ++byte) {
+      std::uint32_t crc = byte;
+      for (int bit = 0; bit < 8; ++bit) {
+        crc = (crc >> 1) ^ ((crc & 1) ? POLYNOMIAL : 0);
+      }
+      entries[byte] = crc;
+    }
+  }
+
+  std::uint32_t entries[256];
+};
+
+std::uint32_t crc32cTable(const char* data, std::size_t length,
+                          std::uint32_t crc) {
+  static const Crc32cTable table;
+  const unsigned char* bytes = reinterpret_cast<const unsigned char*>(data);
+  while (length-- > 0) {
+    crc = table.entries[(crc ^ *bytes++) & 0xff] ^ (crc >> 8);
+  }
+  return crc;
+}
+
+#if defined(__x86_64__) || defined(__i386__)
+__attribute__((target("sse4.2")))
+std::uint32_t crc32cHardware(const char* data, std::size_t length,
+                             std::uint32_t crc) {
+#if defined(__x86_64__)
+  std::uint64_t crc64 = crc;
+  while (length >= sizeof(std::uint64_t)) {
+    std::uint64_t word;
+    std::memcpy(&word, data, sizeof(word));
+    crc64 = _mm_crc32_u64(crc64, word);
+    data += sizeof(word);
+    length -= sizeof(word);
+  }
+  crc = static_cast<std::uint32_t>(crc64);
+#endif
+  while (length >= sizeof(std::uint32_t)) {
+    std::uint32_t word;
+    std::memcpy(&word, data, sizeof(word));
+    crc = _mm_crc32_u32(crc, word);
+    data += sizeof(word);
+    length -= sizeof(word);
+  }
+  while (length-- > 0) {
+    crc = _mm_crc32_u8(crc, static_cast<unsigned char>(*data++));
+  }
+  return crc;
+}
+#endif
+
+typedef std::uint32_t (*Crc32cFunction)(const char*, std::size_t,
+                                        std::uint32_t);
+
+Crc32cFunction selectCrc32c() {
+#if defined(__x86_64__) || defined(__i386__)
+  if (__builtin_cpu_supports("sse4.2")) {
+    return crc32cHardware;
+  }
+#endif
+  return crc32cTable;
+}
+
+}
+
+std::uint32_t crc32c(const char* data, const std::size_t length,
+                     const std::uint32_t crc) {
+  static const Crc32cFunction function = selectCrc32c();
+  return ~function(data, length, ~crc);
+}
+
+}
@@ -0,0 +1,31 @@
+/**
+ * @author See Contributors.txt for code contributors and overview of BadgerDB.
+ *
+ * @section LICENSE
+ * Copyright (c) 2012 Database Group, Computer Sciences Department, University of Wisconsin-Madison.
+ */
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+namespace badgerdb {
+
+/**
+ * Computes the CRC-32C (Castagnoli) checksum of a buffer.  The SSE4.2 crc32
+ * instruction is used when the CPU supports it, which is checked once at run
+ * time; otherwise a lookup table is used.  Both give the same result.
+ *
+ * A checksum can be computed over several buffers by passing the result for
+ * the earlier ones as the initial value for the next.
+ *
+ * @param data    Bytes to checksum.
+ * @param length  Number of bytes.
+ * @param crc     Checksum of the bytes preceding data, or 0 to start.
+ * @return  Checksum of all bytes so far.
+ */
+std::uint32_t crc32c(const char* data, const std::size_t length,
+                     const std::uint32_t crc = 0);
+
+}
@@ -0,0 +1,39 @@
+/**
+ * @author See Contributors.txt for code contributors and overview of BadgerDB.
+ *
+ * @section LICENSE
+ * Copyright (c) 2012 Database Group, Computer Sciences Department, University of Wisconsin-Madison.
+ */
+
+#include "cycle_clock.h"
+
+namespace badgerdb {
+
+namespace {
+
+double calibrateCyclesPerNanosecond() {
+#if defined(__x86_64__) || defined(__i386__)
+  const std::chrono::steady_clock::time_point start_time =
+      std::chrono::steady_clock::now();
+  const std::uint64_t start_cycles = readCycleCounter();
+  std::chrono::steady_clock::time_point now_time;
+  do {
+    now_time = std::chrono::steady_clock::now();
+  } while (now_time - start_time < std::chrono::milliseconds(10));
+  const std::uint64_t elapsed_cycles = readCycleCounter() - start_cycles;
+  const double elapsed_ns = std::chrono::duration_cast<std::chrono::nanoseconds>(
+      now_time - start_time).count();
+  return elapsed_cycles / elapsed_ns;
+#else
+  return 1.0;
+#endif
+}
+
+}
+
+double cyclesPerNanosecond() {
+  static const double cycles_per_ns = calibrateCyclesPerNanosecond();
+  return cycles_per_ns;
+}
+
+}
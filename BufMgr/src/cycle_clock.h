@@ -0,0 +1,43 @@
+/**
+ * @author See Contributors.txt for code contributors and overview of BadgerDB.
+ *
+ * @section LICENSE
+ * Copyright (c) 2012 Database Group, Computer Sciences Department, University of Wisconsin-Madison.
+ */
+
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#endif
+
+namespace badgerdb {
+
+/**
+ * Returns the current value of the CPU cycle counter.  On platforms without a
+ * usable cycle counter the monotonic clock in nanoseconds is returned instead.
+ *
+ * @return  Current cycle count.
+ */
+inline std::uint64_t readCycleCounter() {
+#if defined(__x86_64__) || defined(__i386__)
+  return __rdtsc();
+#else
+  return std::chrono::duration_cast<std::chrono::nanoseconds>(
+      std::chrono::steady_clock::now().time_since_epoch()).count();
+#endif
+}
+
+/**
+ * Returns how many cycle counter ticks elapse per nanosecond.  The rate is
+ * calibrated against the monotonic clock on the first call, which takes a few
+ * milliseconds; later calls return the cached value.
+ *
+ * @return  Cycle counter ticks per nanosecond.
+ */
+double cyclesPerNanosecond();
+
+}
@@ -0,0 +1,22 @@
+/**
+ * @author See Contributors.txt for code contributors and overview of BadgerDB.
+ *
+ * @section LICENSE
+ * Copyright (c) 2012 Database Group, Computer Sciences Department, University of Wisconsin-Madison.
+ */
+
+#include "log_write_exception.h"
+
+#include <sstream>
+#include <string>
+
+namespace badgerdb {
+
+LogWriteException::LogWriteException(const std::string& name)
+    : BadgerDbException(""), filename_(name) {
+  std::stringstream ss;
+  ss << "Could not write log file: " << filename_;
+  message_.assign(ss.str());
+}
+
+}
@@ -0,0 +1,50 @@
+/**
+ * @author See Contributors.txt for code contributors and overview of BadgerDB.
+ *
+ * @section LICENSE
+ * Copyright (c) 2012 Database Group, Computer Sciences Department, University of Wisconsin-Madison.
+ */
+
+#pragma once
+
+#include <string>
+
+#include "badgerdb_exception.h"
+
+namespace badgerdb {
+
+/**
+ * @brief An exception that is thrown when the log of a file cannot be opened,
+ *        written or synced.
+ *
+ * Records the log did not manage to make durable are not counted as durable,
+ * so pages depending on them are not written back either.
+ */
+class LogWriteException : public BadgerDbException {
+ public:
+  /**
+   * Constructs a log write exception for the given log file.
+   *
+   * @param name  Name of log file that could not be written.
+   */
+  explicit LogWriteException(const std::string& name);
+
+  /**
+   * Destroys the exception.  Does nothing special; just included to make the
+   * compiler happy.
+   */
+  virtual ~LogWriteException() throw() {}
+
+  /**
+   * Returns the name of the file that caused this exception.
+   */
+  virtual const std::string& filename() const { return filename_; }
+
+ protected:
+  /**
+   * Name of file that caused this exception.
+   */
+  const std::string filename_;
+};
+
+}
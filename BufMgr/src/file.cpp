@@ -13,7 +13,16 @@
 #include <string>
 #include <cstdio>
 #include <cassert>
-
+#include <cstring>
+#include <cstddef>
+#include <algorithm>
+#include <set>
+#include <vector>
+#include <sys/stat.h>
+
+#include "compressed_backend.h"
+#include "crc32c.h"
+#include "exceptions/checksum_mismatch_exception.h"
 #include "exceptions/file_exists_exception.h"
 #include "exceptions/file_not_found_exception.h"
 #include "exceptions/file_open_exception.h"
@@ -23,15 +32,40 @@
 
 namespace badgerdb {
 
-File::StreamMap File::open_streams_;
-File::CountMap File::open_counts_;
+namespace {
+
+/**
+ * Header at the start of the doublewrite file.  It is followed by num_pages
+ * entries, each the number of a page and the page as it is laid out on disk.
+ * The checksum covers num_pages and the entries, so a batch torn by a crash is
+ * recognized and ignored; the pages in place have not been touched yet then.
+ */
+struct DoublewriteHeader {
+  std::uint32_t num_pages;
+  std::uint32_t checksum;
+};
+
+const std::size_t DOUBLEWRITE_ENTRY_SIZE = sizeof(PageId) + Page::SIZE;
 
-File File::create(const std::string& filename) {
-  return File(filename, true /* create_new */);
+}
+
+File::OpenFileMap File::open_files_;
+File::BackendMap File::memory_files_;
+BackendDecorator File::backend_decorator_;
+std::uint64_t File::next_open_file_id_ = 1;
+const std::uint64_t File::DEFAULT_EXTENT_SIZE;
+const std::uint32_t File::MAX_DOUBLEWRITE_PAGES;
+PageId File::extent_pages_ = File::DEFAULT_EXTENT_SIZE / Page::SIZE;
+bool File::verify_checksums_ = true;
+
+File File::create(const std::string& filename, const bool in_memory,
+                  const std::uint32_t format) {
+  return File(filename, true /* create_new */, in_memory, format);
 }
 
 File File::open(const std::string& filename) {
-  return File(filename, false /* create_new */);
+  return File(filename, false /* create_new */, false /* in_memory */,
+              FORMAT_DEFAULT);
 }
 
 void File::remove(const std::string& filename) {
@@ -41,39 +75,71 @@ void File::remove(const std::string& filename) {
   if (isOpen(filename)) {
     throw FileOpenException(filename);
   }
-  std::remove(filename.c_str());
+  if (memory_files_.erase(filename) == 0) {
+    std::remove(filename.c_str());
+  }
+  std::remove(LogManager::filenameFor(filename).c_str());
+  std::remove(doublewriteFilename(filename).c_str());
 }
 
 bool File::isOpen(const std::string& filename) {
   if (!exists(filename)) {
     return false;
   }
-  return open_counts_.find(filename) != open_counts_.end();
+  return open_files_.find(filename) != open_files_.end();
 }
 
 bool File::exists(const std::string& filename) {
-	std::fstream file(filename);
-	if(file)
+	if (memory_files_.find(filename) != memory_files_.end())
 	{
-		file.close();
 		return true;
 	}
+	struct stat status;
+	return ::stat(filename.c_str(), &status) == 0;
+}
 
-	return false;
+void File::setBackendDecorator(const BackendDecorator& decorator) {
+  backend_decorator_ = decorator;
+}
+
+void File::setExtentSize(const std::uint64_t bytes) {
+  extent_pages_ = std::max<std::uint64_t>(bytes / Page::SIZE, 1);
+}
+
+void File::setChecksumVerification(const bool verify) {
+  verify_checksums_ = verify;
+}
+
+std::map<std::string, FileStats> File::openFileStats() {
+  std::map<std::string, FileStats> stats;
+  for (OpenFileMap::const_iterator iter = open_files_.begin();
+       iter != open_files_.end();
+       ++iter) {
+    stats[iter->first] = *iter->second->stats;
+  }
+  return stats;
 }
 
 File::File(const File& other)
   : filename_(other.filename_),
-    stream_(open_streams_[filename_]) {
-  ++open_counts_[filename_];
+    open_file_(other.open_file_),
+    backend_(other.backend_),
+    stats_(other.stats_),
+    space_map_(other.space_map_) {
+  ++open_file_->open_count;
 }
 
 File& File::operator=(const File& rhs) {
-  // This accounts for self-assignment and assignment of a File object for the
-  // same file.
+  // Taking a reference to the new file before closing accounts for
+  // self-assignment and assignment of a File object for the same file.
+  const std::shared_ptr<OpenFile> open_file = rhs.open_file_;
+  ++open_file->open_count;
   close();	//close my file and associate me with the new one
   filename_ = rhs.filename_;
-  openIfNeeded(false /* create_new */);
+  open_file_ = open_file;
+  backend_ = open_file_->backend;
+  stats_ = open_file_->stats;
+  space_map_ = open_file_->space_map;
   return *this;
 }
 
@@ -83,64 +149,78 @@ File::~File() {
 
 Page File::allocatePage() {
   FileHeader header = readHeader();
+  // Records logged for an earlier page with the same number must not be
+  // replayed onto the new one.
+  const Lsn start_lsn = open_file_->log ? open_file_->log->endLsn() : 0;
   Page new_page;
-  Page existing_page;
+  if (space_map_) {
+    PageId page_number = Page::INVALID_NUMBER;
+    if (header.num_free_pages > 0) {
+      page_number = space_map_->findFree(header.num_pages);
+      assert(page_number != Page::INVALID_NUMBER);
+      --header.num_free_pages;
+    } else {
+      reserveExtent(header);
+      if (SpaceMap::isMapPage(header.num_pages)) {
+        // The file has grown into a new group, which starts with its map page.
+        space_map_->resize(header.num_pages + 1);
+        space_map_->set(header.num_pages);
+        writeSpaceMapPage(header.num_pages);
+        ++header.num_pages;
+        reserveExtent(header);
+      }
+      page_number = header.num_pages;
+      ++header.num_pages;
+      space_map_->resize(header.num_pages);
+    }
+    space_map_->set(page_number);
+    new_page.set_page_number(page_number);
+    new_page.set_lsn(start_lsn);
+    if (open_file_->log) {
+      open_file_->log->startPage(page_number);
+    }
+    ++stats_->pages_allocated;
+    writePage(page_number, new_page);
+    writeSpaceMapWord(page_number);
+    writeHeader(header);
+    return new_page;
+  }
   if (header.num_free_pages > 0) {
     new_page = readPage(header.first_free_page, true /* allow_free */);
     new_page.set_page_number(header.first_free_page);
     header.first_free_page = new_page.next_page_number();
     --header.num_free_pages;
-
-    if (header.first_used_page == Page::INVALID_NUMBER ||
-        header.first_used_page > new_page.page_number()) {
-      // Either have no pages used or the head of the used list is a page later
-      // than the one we just allocated, so add the new page to the head.
-      if (header.first_used_page > new_page.page_number()) {
-        new_page.set_next_page_number(header.first_used_page);
-      }
-      header.first_used_page = new_page.page_number();
-    } else {
-      // New page is reused from somewhere after the beginning, so we need to
-      // find where in the used list to insert it.
-      PageId next_page_number = Page::INVALID_NUMBER;
-      for (FileIterator iter = begin(); iter != end(); ++iter) {
-        next_page_number = (*iter).next_page_number();
-        if (next_page_number > new_page.page_number() ||
-            next_page_number == Page::INVALID_NUMBER) {
-          existing_page = *iter;
-          break;
-        }
-      }
-      existing_page.set_next_page_number(new_page.page_number());
-      new_page.set_next_page_number(next_page_number);
-    }
-
     assert((header.num_free_pages == 0) ==
            (header.first_free_page == Page::INVALID_NUMBER));
   } else {
+    reserveExtent(header);
     new_page.set_page_number(header.num_pages);
-    if (header.first_used_page == Page::INVALID_NUMBER) {
-      header.first_used_page = new_page.page_number();
-    } else {
-      // If we have pages allocated, we need to add the new page to the tail
-      // of the linked list.
-      for (FileIterator iter = begin(); iter != end(); ++iter) {
-        if ((*iter).next_page_number() == Page::INVALID_NUMBER) {
-          existing_page = *iter;
-          break;
-        }
-      }
-      assert(existing_page.isUsed());
-      existing_page.set_next_page_number(new_page.page_number());
-    }
     ++header.num_pages;
   }
+  // Reused pages still point at the rest of the free list.  Either way the new
+  // page joins the used list at its tail.
+  new_page.set_next_page_number(Page::INVALID_NUMBER);
+  new_page.set_prev_page_number(header.last_used_page);
+  new_page.set_lsn(start_lsn);
+  if (open_file_->log) {
+    open_file_->log->startPage(new_page.page_number());
+  }
+  ++stats_->pages_allocated;
   writePage(new_page.page_number(), new_page);
-  if (existing_page.page_number() != Page::INVALID_NUMBER) {
-    // If we updated an existing page by inserting the new page into the
-    // used list, we need to write it out.
-    writePage(existing_page.page_number(), existing_page);
+  rememberLinks(new_page.page_number(), Page::INVALID_NUMBER,
+                header.last_used_page);
+  if (header.last_used_page == Page::INVALID_NUMBER) {
+    header.first_used_page = new_page.page_number();
+  } else {
+    writeLink(header.last_used_page, offsetof(PageHeader, next_page_number),
+              new_page.page_number());
+    PageLinks tail_links;
+    if (recallLinks(header.last_used_page, tail_links)) {
+      rememberLinks(header.last_used_page, new_page.page_number(),
+                    tail_links.prev_page_number);
+    }
   }
+  header.last_used_page = new_page.page_number();
   writeHeader(header);
 
   return new_page;
@@ -148,123 +228,382 @@ Page File::allocatePage() {
 
 Page File::readPage(const PageId page_number) const {
   FileHeader header = readHeader();
-  if (page_number >= header.num_pages) {
+  if (page_number >= header.num_pages ||
+      (space_map_ && !space_map_->isUsed(page_number))) {
     throw InvalidPageException(page_number, filename_);
   }
   return readPage(page_number, false /* allow_free */);
 }
 
-Page File::readPage(const PageId page_number, const bool allow_free) const {
+std::vector<Page> File::readPageRun(const PageId first,
+                                   const PageId count) const {
+  std::vector<Page> pages;
+  const PageId num_pages = readHeader().num_pages;
+  if (first == Page::INVALID_NUMBER || first >= num_pages) {
+    return pages;
+  }
+  const PageId run = std::min(count, num_pages - first);
+  std::vector<char> buffer(static_cast<std::size_t>(run) * Page::SIZE);
+  stats_->page_reads += run;
+  backend_->read(pagePosition(first), &buffer[0], buffer.size());
+  pages.reserve(run);
+  for (PageId i = 0; i < run; ++i) {
+    if (space_map_ && !space_map_->isUsed(first + i)) {
+      continue;
+    }
+    try {
+      pages.push_back(decodePage(first + i, &buffer[i * Page::SIZE],
+                                 false /* allow_free */,
+                                 true /* verify_checksum */));
+    } catch (const InvalidPageException&) {
+    } catch (const ChecksumMismatchException&) {
+    }
+  }
+  return pages;
+}
+
+Page File::readPage(const PageId page_number, const bool allow_free,
+                    const bool verify_checksum) const {
+  char buffer[Page::SIZE];
+  ++stats_->page_reads;
+  backend_->read(pagePosition(page_number), buffer, Page::SIZE);
+  return decodePage(page_number, buffer, allow_free, verify_checksum);
+}
+
+Page File::decodePage(const PageId page_number, const char* buffer,
+                      const bool allow_free,
+                      const bool verify_checksum) const {
   Page page;
-  stream_->seekg(pagePosition(page_number), std::ios::beg);
-  stream_->read(reinterpret_cast<char*>(&page.header_), sizeof(page.header_));
-  stream_->read(reinterpret_cast<char*>(&page.data_[0]), Page::DATA_SIZE);
+  std::memcpy(&page.header_, buffer, sizeof(page.header_));
+  if (verify_checksum && verify_checksums_ && !pageIntact(buffer)) {
+    throw ChecksumMismatchException(page_number, filename_);
+  }
+  std::memcpy(&page.data_[0], buffer + sizeof(page.header_), Page::DATA_SIZE);
   if (!allow_free && !page.isUsed()) {
     throw InvalidPageException(page_number, filename_);
   }
+  if (!space_map_ && page.isUsed()) {
+    rememberLinks(page_number, page.next_page_number(),
+                  page.prev_page_number());
+  }
 
   return page;
 }
 
 void File::writePage(const Page& new_page) {
-  PageHeader header = readPageHeader(new_page.page_number());
-  if (header.current_page_number == Page::INVALID_NUMBER) {
-    // Page has been deleted since it was read.
-    throw InvalidPageException(new_page.page_number(), filename_);
+  if (open_file_->doublewrite) {
+    writePages(std::vector<const Page*>(1, &new_page));
+    return;
+  }
+  writePage(new_page.page_number(), headerForWrite(new_page), new_page);
+}
+
+void File::writePages(const std::vector<const Page*>& pages) {
+  if (!open_file_->doublewrite) {
+    for (std::size_t i = 0; i < pages.size(); ++i) {
+      writePage(*pages[i]);
+    }
+    return;
+  }
+  if (pages.empty()) {
+    return;
+  }
+  if (pages.size() > MAX_DOUBLEWRITE_PAGES) {
+    for (std::size_t first = 0; first < pages.size();
+         first += MAX_DOUBLEWRITE_PAGES) {
+      const std::size_t last =
+          std::min<std::size_t>(first + MAX_DOUBLEWRITE_PAGES, pages.size());
+      writePages(std::vector<const Page*>(pages.begin() + first,
+                                          pages.begin() + last));
+    }
+    return;
+  }
+  // The whole batch is laid out behind its header so that it goes to the
+  // doublewrite file with one sequential write.
+  std::vector<char> batch(sizeof(DoublewriteHeader) +
+                          pages.size() * DOUBLEWRITE_ENTRY_SIZE);
+  char* entries = &batch[sizeof(DoublewriteHeader)];
+  for (std::size_t i = 0; i < pages.size(); ++i) {
+    char* entry = entries + i * DOUBLEWRITE_ENTRY_SIZE;
+    const PageId page_number = pages[i]->page_number();
+    std::memcpy(entry, &page_number, sizeof(PageId));
+    layOutPage(headerForWrite(*pages[i]), *pages[i], entry + sizeof(PageId));
+  }
+  DoublewriteHeader header;
+  header.num_pages = static_cast<std::uint32_t>(pages.size());
+  header.checksum = crc32c(
+      entries, batch.size() - sizeof(header),
+      crc32c(reinterpret_cast<const char*>(&header.num_pages),
+             sizeof(header.num_pages)));
+  std::memcpy(&batch[0], &header, sizeof(header));
+  FileBackend& doublewrite = *open_file_->doublewrite;
+  doublewrite.write(0 /* offset */, &batch[0], batch.size());
+  doublewrite.sync();
+
+  for (std::size_t i = 0; i < pages.size(); ++i) {
+    const char* entry = entries + i * DOUBLEWRITE_ENTRY_SIZE;
+    ++stats_->page_writes;
+    backend_->write(pagePosition(pages[i]->page_number()),
+                    entry + sizeof(PageId), Page::SIZE);
   }
-  // Page on disk may have had its next page pointer updated since it was read;
-  // we don't modify that, but we do keep all the other modifications to the
-  // page header.
-  const PageId next_page_number = header.next_page_number;
-  header = new_page.header_;
-  header.next_page_number = next_page_number;
-  writePage(new_page.page_number(), header, new_page);
+  backend_->sync();
+  ++stats_->doublewrite_batches;
+
+  // If a crash loses this, the batch is found again on open.  Only pages
+  // failing their checksum are restored from it then, so pages written
+  // again since, bypassing the doublewrite file, keep their newer contents.
+  const DoublewriteHeader empty = {0 /* num_pages */, 0 /* checksum */};
+  doublewrite.write(0 /* offset */, reinterpret_cast<const char*>(&empty),
+                    sizeof(empty));
+  doublewrite.flush();
+}
+
+PageHeader File::headerForWrite(const Page& new_page) {
+  if (space_map_) {
+    // Pages of a space map file carry no links, so the page can be written
+    // as it is.
+    if (!space_map_->isUsed(new_page.page_number())) {
+      throw InvalidPageException(new_page.page_number(), filename_);
+    }
+    return new_page.header_;
+  }
+  // Page on disk may have had its next and previous page pointers updated
+  // since it was read; we don't modify those, but we do keep all the other
+  // modifications to the page header.  The links of every page read or
+  // allocated through this file are known, so this only has to go to disk
+  // for pages which have been deleted since.
+  PageLinks links;
+  if (!recallLinks(new_page.page_number(), links)) {
+    const PageHeader disk_header = readPageHeader(new_page.page_number());
+    if (disk_header.current_page_number == Page::INVALID_NUMBER) {
+      // Page has been deleted since it was read.
+      throw InvalidPageException(new_page.page_number(), filename_);
+    }
+    links.next_page_number = disk_header.next_page_number;
+    links.prev_page_number = disk_header.prev_page_number;
+    rememberLinks(new_page.page_number(), links.next_page_number,
+                  links.prev_page_number);
+  }
+  PageHeader header = new_page.header_;
+  header.next_page_number = links.next_page_number;
+  header.prev_page_number = links.prev_page_number;
+  return header;
 }
 
 void File::deletePage(const PageId page_number) {
   FileHeader header = readHeader();
-  Page existing_page = readPage(page_number);
-  Page previous_page;
-  // If this page is the head of the used list, update the header to point to
-  // the next page in line.
-  if (page_number == header.first_used_page) {
-    header.first_used_page = existing_page.next_page_number();
+  if (page_number >= header.num_pages) {
+    throw InvalidPageException(page_number, filename_);
+  }
+  if (space_map_) {
+    if (!space_map_->isUsed(page_number)) {
+      throw InvalidPageException(page_number, filename_);
+    }
+    space_map_->clear(page_number);
+    ++header.num_free_pages;
+    ++stats_->pages_deleted;
+    writePage(page_number, Page());
+    writeSpaceMapWord(page_number);
+    writeHeader(header);
+    return;
+  }
+  PageLinks links;
+  if (!recallLinks(page_number, links)) {
+    const PageHeader existing_header = readPageHeader(page_number);
+    if (existing_header.current_page_number == Page::INVALID_NUMBER) {
+      throw InvalidPageException(page_number, filename_);
+    }
+    links.next_page_number = existing_header.next_page_number;
+    links.prev_page_number = existing_header.prev_page_number;
+  }
+  forgetLinks(page_number);
+  // Unlink the page from its neighbours in the used list, or from the header
+  // if it is at either end.
+  const PageId next_page_number = links.next_page_number;
+  const PageId prev_page_number = links.prev_page_number;
+  PageLinks neighbour_links;
+  if (prev_page_number == Page::INVALID_NUMBER) {
+    header.first_used_page = next_page_number;
   } else {
-    // Walk the used list so we can update the page that points to this one.
-    for (FileIterator iter = begin(); iter != end(); ++iter) {
-      previous_page = *iter;
-      if (previous_page.next_page_number() == existing_page.page_number()) {
-        previous_page.set_next_page_number(existing_page.next_page_number());
-        break;
-      }
+    writeLink(prev_page_number, offsetof(PageHeader, next_page_number),
+              next_page_number);
+    if (recallLinks(prev_page_number, neighbour_links)) {
+      rememberLinks(prev_page_number, next_page_number,
+                    neighbour_links.prev_page_number);
+    }
+  }
+  if (next_page_number == Page::INVALID_NUMBER) {
+    header.last_used_page = prev_page_number;
+  } else {
+    writeLink(next_page_number, offsetof(PageHeader, prev_page_number),
+              prev_page_number);
+    if (recallLinks(next_page_number, neighbour_links)) {
+      rememberLinks(next_page_number, neighbour_links.next_page_number,
+                    prev_page_number);
     }
   }
   // Clear the page and add it to the head of the free list.
-  existing_page.initialize();
+  Page existing_page;
   existing_page.set_next_page_number(header.first_free_page);
   header.first_free_page = page_number;
   ++header.num_free_pages;
-  if (previous_page.isUsed()) {
-    writePage(previous_page.page_number(), previous_page);
-  }
+  ++stats_->pages_deleted;
   writePage(page_number, existing_page);
   writeHeader(header);
 }
 
 FileIterator File::begin() {
-  const FileHeader& header = readHeader();
-  return FileIterator(this, header.first_used_page);
+  return FileIterator(this, nextUsedPage(Page::INVALID_NUMBER));
 }
 
 FileIterator File::end() {
   return FileIterator(this, Page::INVALID_NUMBER);
 }
 
-File::File(const std::string& name, const bool create_new) : filename_(name) {
-  openIfNeeded(create_new);
+File::File(const std::string& name, const bool create_new,
+           const bool in_memory, const std::uint32_t format)
+    : filename_(name) {
+  openIfNeeded(create_new, in_memory, format);
+  if (!create_new && open_file_->open_count == 1) {
+    // Torn pages are repaired first, as replaying the log has to read them.
+    if (open_file_->doublewrite) {
+      repairTornPages();
+    }
+    if (open_file_->log) {
+      recover();
+    }
+  }
 
   if (create_new) {
     // File starts with 1 page (the header).
     FileHeader header = {1 /* num_pages */, 0 /* first_used_page */,
-                         0 /* num_free_pages */, 0 /* first_free_page */};
+                         0 /* num_free_pages */, 0 /* first_free_page */,
+                         0 /* last_used_page */, format,
+                         1 /* reserved_pages */};
     writeHeader(header);
+    sync();
+    if (format & FORMAT_SPACE_MAP) {
+      space_map_.reset(new SpaceMap());
+      open_file_->space_map = space_map_;
+    }
   }
 }
 
-void File::openIfNeeded(const bool create_new) {
-  if (open_counts_.find(filename_) != open_counts_.end()) {	//exists an entry already
-    ++open_counts_[filename_];
-    stream_ = open_streams_[filename_];
+void File::openIfNeeded(const bool create_new, const bool in_memory,
+                        const std::uint32_t format) {
+  OpenFileMap::const_iterator open_file = open_files_.find(filename_);
+  if (open_file != open_files_.end()) {	//exists an entry already
+    open_file_ = open_file->second;
+    ++open_file_->open_count;
+    backend_ = open_file_->backend;
+    stats_ = open_file_->stats;
+    space_map_ = open_file_->space_map;
   } else {
-    std::ios_base::openmode mode =
-        std::fstream::in | std::fstream::out | std::fstream::binary;
     const bool already_exists = exists(filename_);
     if (create_new) {
       // Error if we try to overwrite an existing file.
       if (already_exists) {
         throw FileExistsException(filename_);
       }
-      // New files have to be truncated on open.
-      mode = mode | std::fstream::trunc;
     } else {
       // Error if we try to open a file that doesn't exist.
       if (!already_exists) {
         throw FileNotFoundException(filename_);
       }
     }
-    stream_.reset(new std::fstream(filename_, mode));
-    open_streams_[filename_] = stream_;
-    open_counts_[filename_] = 1;
+    BackendMap::const_iterator memory_file = memory_files_.find(filename_);
+    if (create_new && in_memory) {
+      backend_.reset(new MemoryBackend());
+      memory_files_[filename_] = backend_;
+    } else if (memory_file != memory_files_.end()) {
+      backend_ = memory_file->second;
+    } else {
+      // New files have to be truncated on open.
+      backend_.reset(new StreamBackend(filename_, create_new /* truncate */));
+    }
+    if (backend_decorator_) {
+      backend_ = backend_decorator_(filename_, backend_);
+    }
+    stats_.reset(new FileStats());
+    open_file_.reset(new OpenFile());
+    open_file_->id = next_open_file_id_++;
+    open_file_->open_count = 1;
+    open_file_->stats = stats_;
+    open_file_->dirty = false;
+    if (!create_new) {
+      ++stats_->header_reads;
+      backend_->read(0 /* offset */,
+                     reinterpret_cast<char*>(&open_file_->header),
+                     sizeof(FileHeader));
+    }
+    const std::uint32_t file_format =
+        create_new ? format : open_file_->header.format;
+    if (file_format & FORMAT_COMPRESSED) {
+      // The file header is at the front of the compressed storage as it is,
+      // so it can be read before knowing the format.
+      backend_.reset(new CompressedBackend(backend_, sizeof(FileHeader),
+                                           Page::SIZE, create_new));
+    }
+    open_file_->backend = backend_;
+    if (file_format & FORMAT_LOGGED) {
+      open_file_->log.reset(
+          new LogManager(LogManager::filenameFor(filename_), create_new));
+      // Recovery only replays records of pages the header on disk counts, so
+      // a header changed by allocating pages has to be durable, together with
+      // the pages and links written with it, before the records are.  The
+      // log belongs to the open file, so the pointer outlives it.
+      OpenFile* const logged_file = open_file_.get();
+      open_file_->log->setBeforeFlush([logged_file]() {
+        if (!logged_file->dirty) {
+          return;
+        }
+        ++logged_file->stats->header_writes;
+        logged_file->backend->write(
+            0 /* offset */,
+            reinterpret_cast<const char*>(&logged_file->header),
+            sizeof(FileHeader));
+        logged_file->backend->sync();
+        logged_file->dirty = false;
+      });
+    }
+    if ((file_format & FORMAT_DOUBLEWRITE) &&
+        memory_files_.find(filename_) == memory_files_.end()) {
+      // Pages in memory cannot be torn, so only files on disk need a copy.
+      const std::string dw_filename = doublewriteFilename(filename_);
+      const bool new_dw = create_new || !exists(dw_filename);
+      open_file_->doublewrite.reset(new StreamBackend(dw_filename, new_dw));
+      if (new_dw) {
+        // The header is written right away so that reading it never runs
+        // past the end of the file.
+        const DoublewriteHeader empty = {0 /* num_pages */, 0 /* checksum */};
+        open_file_->doublewrite->write(0 /* offset */,
+                                       reinterpret_cast<const char*>(&empty),
+                                       sizeof(empty));
+        open_file_->doublewrite->flush();
+      }
+    }
+    space_map_.reset();
+    if (open_file_->header.format & FORMAT_SPACE_MAP) {
+      readSpaceMap();
+    }
+    open_file_->space_map = space_map_;
+    open_files_[filename_] = open_file_;
   }
 }
 
 void File::close() {
-  --open_counts_[filename_];
-  stream_.reset();
-  if (open_counts_[filename_] == 0) {
-    open_streams_.erase(filename_);
-    open_counts_.erase(filename_);
+  if (!open_file_) {
+    // Already closed, for example by an explicit call of the destructor.
+    return;
+  }
+  if (--open_file_->open_count == 0) {
+    sync();
+    open_files_.erase(filename_);
   }
+  open_file_.reset();
+  backend_.reset();
+  stats_.reset();
+  space_map_.reset();
 }
 
 void File::writePage(const PageId page_number, const Page& new_page) {
@@ -273,33 +612,259 @@ void File::writePage(const PageId page_number, const Page& new_page) {
 
 void File::writePage(const PageId page_number, const PageHeader& header,
                      const Page& new_page) {
-  stream_->seekp(pagePosition(page_number), std::ios::beg);
-  stream_->write(reinterpret_cast<const char*>(&header), sizeof(header));
-  stream_->write(reinterpret_cast<const char*>(&new_page.data_[0]),
-                 Page::DATA_SIZE);
-  stream_->flush();
+  // Assembled in one buffer so that the page goes to the backend as a single
+  // write.
+  char buffer[Page::SIZE];
+  layOutPage(header, new_page, buffer);
+  ++stats_->page_writes;
+  backend_->write(pagePosition(page_number), buffer, Page::SIZE);
+  backend_->flush();
 }
 
-FileHeader File::readHeader() const {
-  FileHeader header;
-  stream_->seekg(0 /* pos */, std::ios::beg);
-  stream_->read(reinterpret_cast<char*>(&header), sizeof(header));
+void File::layOutPage(const PageHeader& header, const Page& new_page,
+                      char* buffer) {
+  std::memcpy(buffer, &header, sizeof(header));
+  std::memcpy(buffer + sizeof(header), &new_page.data_[0], Page::DATA_SIZE);
+  const std::uint32_t checksum = pageChecksum(buffer);
+  std::memcpy(buffer + offsetof(PageHeader, checksum), &checksum,
+              sizeof(checksum));
+}
 
-  return header;
+void File::sync() const {
+  if (!open_file_->dirty) {
+    return;
+  }
+  ++stats_->header_writes;
+  backend_->write(0 /* offset */,
+                  reinterpret_cast<const char*>(&open_file_->header),
+                  sizeof(FileHeader));
+  backend_->flush();
+  open_file_->dirty = false;
+}
+
+void File::checkpointLog() const {
+  if (!open_file_->log) {
+    return;
+  }
+  sync();
+  backend_->sync();
+  open_file_->log->truncate();
+}
+
+FileHeader File::readHeader() const {
+  return open_file_->header;
 }
 
 void File::writeHeader(const FileHeader& header) {
-  stream_->seekp(0 /* pos */, std::ios::beg);
-  stream_->write(reinterpret_cast<const char*>(&header), sizeof(header));
-  stream_->flush();
+  open_file_->header = header;
+  open_file_->dirty = true;
+}
+
+bool File::pageIntact(const char* buffer) {
+  std::uint32_t checksum;
+  std::memcpy(&checksum, buffer + offsetof(PageHeader, checksum),
+              sizeof(checksum));
+  return checksum == pageChecksum(buffer) ||
+      std::count(buffer, buffer + Page::SIZE, 0) == Page::SIZE;
+}
+
+std::uint32_t File::pageChecksum(const char* buffer) {
+  PageHeader header;
+  std::memcpy(&header, buffer, sizeof(header));
+  header.next_page_number = Page::INVALID_NUMBER;
+  header.prev_page_number = Page::INVALID_NUMBER;
+  header.checksum = 0;
+  const std::uint32_t crc =
+      crc32c(reinterpret_cast<const char*>(&header), sizeof(header));
+  return crc32c(buffer + sizeof(header), Page::SIZE - sizeof(header), crc);
 }
 
 PageHeader File::readPageHeader(PageId page_number) const {
   PageHeader header;
-  stream_->seekg(pagePosition(page_number), std::ios::beg);
-  stream_->read(reinterpret_cast<char*>(&header), sizeof(header));
+  ++stats_->page_header_reads;
+  backend_->read(pagePosition(page_number), reinterpret_cast<char*>(&header),
+                 sizeof(header));
 
   return header;
 }
 
+void File::writeLink(const PageId page_number, const std::size_t offset,
+                     const PageId value) {
+  ++stats_->page_writes;
+  backend_->write(pagePosition(page_number) + offset,
+                  reinterpret_cast<const char*>(&value), sizeof(value));
+  backend_->flush();
+}
+
+bool File::recallLinks(const PageId page_number, PageLinks& links) const {
+  const std::vector<PageLinks>& all_links = open_file_->links;
+  if (page_number >= all_links.size() || !all_links[page_number].known) {
+    return false;
+  }
+  links = all_links[page_number];
+  return true;
+}
+
+void File::rememberLinks(const PageId page_number,
+                         const PageId next_page_number,
+                         const PageId prev_page_number) const {
+  std::vector<PageLinks>& all_links = open_file_->links;
+  if (page_number >= all_links.size()) {
+    const PageLinks unknown = {Page::INVALID_NUMBER, Page::INVALID_NUMBER,
+                               false};
+    all_links.resize(std::max<std::size_t>(page_number + 1,
+                                           2 * all_links.size()),
+                     unknown);
+  }
+  const PageLinks links = {next_page_number, prev_page_number, true};
+  all_links[page_number] = links;
+}
+
+void File::forgetLinks(const PageId page_number) const {
+  if (page_number < open_file_->links.size()) {
+    open_file_->links[page_number].known = false;
+  }
+}
+
+PageId File::nextUsedPage(const PageId page_number) const {
+  if (space_map_) {
+    return space_map_->nextUsed(page_number);
+  }
+  if (page_number == Page::INVALID_NUMBER) {
+    return readHeader().first_used_page;
+  }
+  return readPageHeader(page_number).next_page_number;
+}
+
+void File::reserveExtent(FileHeader& header) {
+  if (header.num_pages < header.reserved_pages) {
+    return;
+  }
+  ++stats_->extents_reserved;
+  backend_->reserve(pagePosition(header.reserved_pages),
+                    static_cast<std::uint64_t>(extent_pages_) * Page::SIZE);
+  header.reserved_pages += extent_pages_;
+}
+
+void File::repairTornPages() {
+  FileBackend& doublewrite = *open_file_->doublewrite;
+  DoublewriteHeader header = {0 /* num_pages */, 0 /* checksum */};
+  doublewrite.read(0 /* offset */, reinterpret_cast<char*>(&header),
+                   sizeof(header));
+  if (header.num_pages == 0) {
+    return;
+  }
+  // A damaged count is not trusted with the size of the read; no batch is
+  // larger than this.
+  std::vector<char> entries(
+      std::min(header.num_pages, MAX_DOUBLEWRITE_PAGES) *
+      DOUBLEWRITE_ENTRY_SIZE);
+  doublewrite.read(sizeof(header), &entries[0], entries.size());
+  if (header.num_pages <= MAX_DOUBLEWRITE_PAGES &&
+      crc32c(&entries[0], entries.size(),
+             crc32c(reinterpret_cast<const char*>(&header.num_pages),
+                    sizeof(header.num_pages))) == header.checksum) {
+    // The batch is intact, so its copies are complete where the crash may
+    // have torn pages in place.
+    const PageId num_pages = readHeader().num_pages;
+    char on_disk[Page::SIZE];
+    for (std::uint32_t i = 0; i < header.num_pages; ++i) {
+      const char* entry = &entries[i * DOUBLEWRITE_ENTRY_SIZE];
+      PageId page_number;
+      std::memcpy(&page_number, entry, sizeof(PageId));
+      if (page_number == Page::INVALID_NUMBER || page_number >= num_pages) {
+        continue;
+      }
+      ++stats_->page_reads;
+      backend_->read(pagePosition(page_number), on_disk, Page::SIZE);
+      if (!pageIntact(on_disk)) {
+        ++stats_->page_writes;
+        backend_->write(pagePosition(page_number), entry + sizeof(PageId),
+                        Page::SIZE);
+        ++stats_->pages_repaired;
+      }
+    }
+    backend_->sync();
+  }
+  const DoublewriteHeader empty = {0 /* num_pages */, 0 /* checksum */};
+  doublewrite.write(0 /* offset */, reinterpret_cast<const char*>(&empty),
+                    sizeof(empty));
+  doublewrite.flush();
+}
+
+void File::recover() {
+  const FileHeader header = readHeader();
+  // Pages are kept until the whole log has been replayed, so that each is
+  // read and written only once.
+  std::map<PageId, Page> pages;
+  std::set<PageId> changed;
+  // Pages which the crash tore while they were written back.  Their header
+  // cannot be trusted, so they are rebuilt from the first full image of them
+  // in the log.
+  std::set<PageId> torn;
+  open_file_->log->forEachRecord([&](const LogRecord& record) {
+    if (record.page_number >= header.num_pages) {
+      return;
+    }
+    std::map<PageId, Page>::iterator page = pages.find(record.page_number);
+    if (page == pages.end()) {
+      Page disk_page;
+      try {
+        disk_page = readPage(record.page_number, true /* allow_free */);
+      } catch (const ChecksumMismatchException&) {
+        disk_page = readPage(record.page_number, true /* allow_free */,
+                             false /* verify_checksum */);
+        torn.insert(record.page_number);
+      }
+      page = pages.insert(std::make_pair(record.page_number, disk_page)).first;
+    }
+    if (torn.count(record.page_number) != 0) {
+      if (!record.full_image) {
+        return;
+      }
+      page->second.set_page_number(record.page_number);
+      torn.erase(record.page_number);
+    } else if (!page->second.isUsed() || page->second.lsn() >= record.lsn) {
+      return;
+    }
+    LogManager::apply(record, page->second);
+    changed.insert(record.page_number);
+  });
+  for (std::set<PageId>::const_iterator iter = changed.begin();
+       iter != changed.end(); ++iter) {
+    writePage(*iter, pages[*iter]);
+    ++stats_->pages_recovered;
+  }
+}
+
+void File::readSpaceMap() {
+  space_map_.reset(new SpaceMap());
+  space_map_->resize(open_file_->header.num_pages);
+  for (PageId map_page = 1; map_page < open_file_->header.num_pages;
+       map_page += SpaceMap::PAGES_PER_MAP_PAGE) {
+    ++stats_->page_reads;
+    backend_->read(pagePosition(map_page),
+                   reinterpret_cast<char*>(space_map_->mapPageWords(map_page)),
+                   Page::SIZE);
+  }
+}
+
+void File::writeSpaceMapWord(const PageId page_number) {
+  const std::uint64_t word = space_map_->wordOf(page_number);
+  ++stats_->page_writes;
+  backend_->write(pagePosition(SpaceMap::mapPageOf(page_number)) +
+                      SpaceMap::wordOffset(page_number),
+                  reinterpret_cast<const char*>(&word), sizeof(word));
+  backend_->flush();
+}
+
+void File::writeSpaceMapPage(const PageId map_page) {
+  ++stats_->page_writes;
+  backend_->write(pagePosition(map_page),
+                  reinterpret_cast<const char*>(
+                      space_map_->mapPageWords(map_page)),
+                  Page::SIZE);
+  backend_->flush();
+}
+
 }
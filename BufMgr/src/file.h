@@ -11,13 +11,121 @@
 #include <string>
 #include <map>
 #include <memory>
+#include <unordered_map>
+#include <vector>
 
+#include "file_backend.h"
+#include "log_manager.h"
 #include "page.h"
+#include "space_map.h"
 
 namespace badgerdb {
 
 class FileIterator;
 
+/**
+ * @brief I/O counters of a file, shared by all File objects which refer to it.
+ */
+struct FileStats {
+  /**
+   * Number of pages read from the file.
+   */
+  std::uint64_t page_reads;
+
+  /**
+   * Number of page headers read on their own (without the page data).
+   */
+  std::uint64_t page_header_reads;
+
+  /**
+   * Number of pages written to the file.
+   */
+  std::uint64_t page_writes;
+
+  /**
+   * Number of times the file header was read.
+   */
+  std::uint64_t header_reads;
+
+  /**
+   * Number of times the file header was written.
+   */
+  std::uint64_t header_writes;
+
+  /**
+   * Number of pages allocated in the file.
+   */
+  std::uint64_t pages_allocated;
+
+  /**
+   * Number of pages deleted from the file.
+   */
+  std::uint64_t pages_deleted;
+
+  /**
+   * Number of extents of storage reserved ahead of the pages in them.
+   */
+  std::uint64_t extents_reserved;
+
+  /**
+   * Number of pages brought up to date from the write-ahead log when the file
+   * was opened.
+   */
+  std::uint64_t pages_recovered;
+
+  /**
+   * Number of batches of pages written through the doublewrite file.
+   */
+  std::uint64_t doublewrite_batches;
+
+  /**
+   * Number of pages restored from the doublewrite file when the file was
+   * opened, because a crash had left them torn.
+   */
+  std::uint64_t pages_repaired;
+};
+
+/**
+ * @brief Optional features of the format of a file, chosen when the file is
+ *        created.  Values may be combined with bitwise or.
+ */
+enum FileFormat {
+  /**
+   * Used and free pages are kept in linked lists threaded through the page
+   * headers.
+   */
+  FORMAT_DEFAULT = 0,
+
+  /**
+   * Used pages are recorded in allocation bitmap pages (see SpaceMap), which
+   * are cached in memory while the file is open.  Free pages are reused
+   * lowest numbered first and pages are iterated in page number order.
+   */
+  FORMAT_SPACE_MAP = 1 << 0,
+
+  /**
+   * Pages are stored compressed in variable-size slots (see
+   * CompressedBackend), so that mostly empty or repetitive pages take fewer
+   * bytes to read and write.
+   */
+  FORMAT_COMPRESSED = 1 << 1,
+
+  /**
+   * Changes made to pages through the buffer manager are recorded in a
+   * write-ahead log (see LogManager), which is replayed when the file is
+   * opened so that no committed change is lost in a crash.
+   */
+  FORMAT_LOGGED = 1 << 2,
+
+  /**
+   * Pages written back together by writePages() are first written in one
+   * batch to a doublewrite file and synced, and only then written in place.
+   * A page torn by a crash while it was written in place is restored from
+   * its copy when the file is opened.
+   */
+  FORMAT_DOUBLEWRITE = 1 << 3,
+};
+
 /**
  * @brief Header metadata for files on disk which contain pages.
  */
@@ -42,6 +150,24 @@ struct FileHeader {
    */
   PageId first_free_page;
 
+  /**
+   * Page number of the last used page in the file, so that new pages can be
+   * appended to the used list without walking it.
+   */
+  PageId last_used_page;
+
+  /**
+   * FileFormat flags the file was created with.
+   */
+  std::uint32_t format;
+
+  /**
+   * Number of pages (including the header) the file has storage reserved
+   * for.  Pages up to this high-water mark are handed out without growing
+   * the file.
+   */
+  PageId reserved_pages;
+
   /**
    * Returns true if this file header is equal to the other.
    *
@@ -52,7 +178,10 @@ struct FileHeader {
     return num_pages == rhs.num_pages &&
         num_free_pages == rhs.num_free_pages &&
         first_used_page == rhs.first_used_page &&
-        first_free_page == rhs.first_free_page;
+        first_free_page == rhs.first_free_page &&
+        last_used_page == rhs.last_used_page &&
+        format == rhs.format &&
+        reserved_pages == rhs.reserved_pages;
   }
 };
 
@@ -60,32 +189,53 @@ struct FileHeader {
  * @brief Class which represents a file in the filesystem containing database
  *        pages.
  *
- * The File class wraps a stream to an underlying file on disk.  Files contain
+ * The File class wraps a backend which stores the underlying file, by default
+ * a stream to a file on disk.  Files contain
  * fixed-sized pages, and they never deallocate space (though they do reuse
  * deleted pages if possible).  If multiple File objects refer to the same
- * underlying file, they will share the stream in memory.
+ * underlying file, they will share the backend in memory.
  * If a file that has already been opened (possibly by another query), then the File class
- * detects this (by looking in the open_streams_ map) and just returns a file object with
- * the already created stream for the file without actually opening the UNIX file again. 
+ * detects this (by looking in the open_files_ map) and just returns a file object with
+ * the already created backend for the file without actually opening the UNIX file again. 
+ * Copying a File object shares the state of the open file directly.
  *
  * @warning This class is not threadsafe.
  */
 class File {
  public:
+  /**
+   * Default size of the extents files grow by.
+   */
+  static const std::uint64_t DEFAULT_EXTENT_SIZE = 1024 * 1024;
+
+  /**
+   * Largest number of pages in one batch of the doublewrite file; larger
+   * batches given to writePages() are split.
+   */
+  static const std::uint32_t MAX_DOUBLEWRITE_PAGES = 256;
+
   /**
    * Creates a new file.
    *
+   * An in-memory file never touches the disk.  It can be closed and opened
+   * again like any other file and lasts until it is removed or the process
+   * exits, which makes it suitable for temporary data.
+   *
    * @param filename  Name of the file.
+   * @param in_memory Whether to keep the file in memory instead of on disk.
+   * @param format    FileFormat flags of the file.
    * @throws  FileExistsException     If the requested file already exists.
    */
-  static File create(const std::string& filename);
+  static File create(const std::string& filename,
+                     const bool in_memory = false,
+                     const std::uint32_t format = FORMAT_DEFAULT);
 
   /**
    * Opens the file named fileName and returns the corresponding File object.
-	 * It first checks if the file is already open. If so, then the new File object created uses the same input-output stream to read to or write fom
-	 * that already open file. Reference count (open_counts_ static variable inside the File object) is incremented whenever an already open file is
-	 * opened again. Otherwise the UNIX file is actually opened. The fileName and the stream associated with this File object are inserted into the
-	 * open_streams_ map.
+	 * It first checks if the file is already open. If so, then the new File object created uses the same backend to read to or write fom
+	 * that already open file. Reference count (open_count in the shared OpenFile state) is incremented whenever an already open file is
+	 * opened again. Otherwise the UNIX file is actually opened. The fileName and the state associated with this File object are inserted into the
+	 * open_files_ map.
    *
    * @param filename  Name of the file.
    * @throws  FileNotFoundException   If the requested file doesn't exist.
@@ -110,12 +260,50 @@ class File {
 
 
   /**
-   * Returns true if the file exists and is open.
+   * Returns true if the file exists, on disk or in memory.
    *
    * @param filename  Name of the file.
    */
   static bool exists(const std::string& filename);
 
+  /**
+   * Returns the I/O counters of every file which is currently open.
+   *
+   * @return  Map from file name to the counters of that file.
+   */
+  static std::map<std::string, FileStats> openFileStats();
+
+  /**
+   * Sets the decorator applied to the backend of every file opened from now
+   * on, for example to emulate the latency of a storage device.  Files which
+   * are already open keep their backend.
+   *
+   * @param decorator   Decorator to apply, or an empty function to use the
+   *                    plain backend.
+   */
+  static void setBackendDecorator(const BackendDecorator& decorator);
+
+  /**
+   * Sets the size of the extents files grow by.  When a file runs out of
+   * reserved storage, the next extent is reserved in one go (see
+   * FileBackend::reserve()) and pages are then handed out from it, so that
+   * the pages of a file which is loaded sequentially are contiguous on disk.
+   *
+   * @param bytes   Size of extents, rounded down to whole pages; at least
+   *                one page is reserved at a time.
+   */
+  static void setExtentSize(const std::uint64_t bytes);
+
+  /**
+   * Sets whether pages read from files are checked against their checksums.
+   * Checksums are always written; verification can be turned off when pages
+   * are known to be intact, for example when reloading pages which were only
+   * just written.  Verification is on by default.
+   *
+   * @param verify  Whether to verify checksums.
+   */
+  static void setChecksumVerification(const bool verify);
+
   /**
    * Copy constructor.
    * 
@@ -152,9 +340,22 @@ class File {
    * @return  The page.
    * @throws  InvalidPageException  If the page doesn't exist in the file or is
    *                                not currently used.
+   * @throws  ChecksumMismatchException   If the page read from disk does not
+   *                                      match its checksum.
    */
   Page readPage(const PageId page_number) const;
 
+  /**
+   * Reads a run of consecutive pages with a single read from the file.  Pages
+   * which readPage() would reject, because they do not exist, are not in use
+   * or do not match their checksum, are left out instead of throwing.
+   *
+   * @param first   Number of first page of the run.
+   * @param count   Number of pages in the run.
+   * @return  The pages read, in page number order.
+   */
+  std::vector<Page> readPageRun(const PageId first, const PageId count) const;
+
   /**
    * Writes a page into the file, replacing any existing contents.  The page
    * must have been already allocated in this file by a call to allocatePage().
@@ -164,13 +365,55 @@ class File {
    */
   void writePage(const Page& new_page);
 
+  /**
+   * Writes several pages into the file, as writePage() does for each.  In
+   * the doublewrite format the pages are written to the doublewrite file in
+   * one sequential write and synced first, and the file is synced after the
+   * pages have been written in place, so the cost of the extra copy is
+   * shared by the whole batch of up to MAX_DOUBLEWRITE_PAGES pages.
+   *
+   * @param pages   Pages to write.
+   */
+  void writePages(const std::vector<const Page*>& pages);
+
   /**
    * Deletes a page from the file.
    *
    * @param page_number   Number of page to delete.
+   * @throws  InvalidPageException  If the page doesn't exist in the file or is
+   *                                not currently used.
    */
   void deletePage(const PageId page_number);
 
+  /**
+   * Writes the file header to disk if it has changed since it was last
+   * written.  Pages are written to disk as soon as they are handed to the
+   * file, so afterwards the file on disk is up to date.  This happens
+   * automatically when the last File object for the file is closed.
+   */
+  void sync() const;
+
+  /**
+   * Empties the write-ahead log of the file, after making the pages written
+   * so far and the file header durable.  Call once every change in the log
+   * has been written back, as BufMgr::flushFile() does.  Does nothing for
+   * files which are not logged.
+   */
+  void checkpointLog() const;
+
+  /**
+   * Returns the write-ahead log of the file.
+   *
+   * @return  Log of file, or NULL if the file is not logged.
+   */
+  LogManager* log() const { return open_file_->log.get(); }
+
+  /**
+   * Returns true if pages written by writePages() go through a doublewrite
+   * file first.
+   */
+  bool usesDoublewrite() const { return open_file_->doublewrite != NULL; }
+
   /**
    * Returns the name of the file this object represents.
    *
@@ -178,6 +421,22 @@ class File {
    */
   const std::string& filename() const { return filename_; }
 
+  /**
+   * Returns a number identifying the opened file.  It is shared by every File
+   * object referring to the file while it stays open, and never given to
+   * another opened file, even one with the same name.
+   *
+   * @return Number of opened file.
+   */
+  std::uint64_t id() const { return open_file_->id; }
+
+  /**
+   * Returns the I/O counters of this file since it was opened.
+   *
+   * @return  I/O counters of file.
+   */
+  const FileStats& stats() const { return *stats_; }
+
   /**
    * Returns an iterator at the first page in the file.
    *
@@ -194,6 +453,26 @@ class File {
   FileIterator end();
 
  private:
+  /**
+   * @brief Links of a page in the used list of a file in the default format.
+   */
+  struct PageLinks {
+    /**
+     * Number of next used page.
+     */
+    PageId next_page_number;
+
+    /**
+     * Number of previous used page.
+     */
+    PageId prev_page_number;
+
+    /**
+     * Whether the links are known; if not, they have to be read from disk.
+     */
+    bool known;
+  };
+
   /**
    * Returns the position of the page with the given number in the file (as an
    * offset from the beginning of the file).
@@ -201,7 +480,7 @@ class File {
    * @param page_number   Number of page.
    * @return  Position of page in file.
    */
-  static std::streampos pagePosition(const PageId page_number) {
+  static std::uint64_t pagePosition(const PageId page_number) {
     return sizeof(FileHeader) + ((page_number - 1) * Page::SIZE);
   }
 
@@ -214,28 +493,34 @@ class File {
    * @see File::open()
    * @param name        Name of file.
    * @param create_new  Whether to create a new file.
+   * @param in_memory   Whether a new file is kept in memory.
+   * @param format      FileFormat flags of a new file.
    * @throws  FileExistsException     If the underlying file exists and
    *                                  create_new is true.
    * @throws  FileNotFoundException   If the underlying file doesn't exist and
    *                                  create_new is false.
    */
-  File(const std::string& name, const bool create_new);
+  File(const std::string& name, const bool create_new, const bool in_memory,
+       const std::uint32_t format);
 
   /**
    * Opens the underlying file named in filename_.
    * This method only opens the file if no other File objects exist that access
-   * the same filesystem file; otherwise, it reuses the existing stream.
+   * the same filesystem file; otherwise, it reuses the existing backend.
    *
    * @param create_new  Whether to create a new file.
+   * @param in_memory   Whether a new file is kept in memory.
+   * @param format      FileFormat flags of a new file.
    * @throws  FileExistsException     If the underlying file exists and
    *                                  create_new is true.
    * @throws  FileNotFoundException   If the underlying file doesn't exist and
    *                                  create_new is false.
    */
-  void openIfNeeded(const bool create_new);
+  void openIfNeeded(const bool create_new, const bool in_memory,
+                    const std::uint32_t format);
 
   /**
-   * Closes the underlying file stream in <stream_>.
+   * Closes the underlying file backend in <backend_>.
    * This method only closes the file if no other File objects exist that access
    * the same file.
    */
@@ -245,16 +530,57 @@ class File {
    * Reads a page from the file.  If <allow_free> is not set, an exception
    * will be thrown if the page read from disk is not currently in use.
    *
-   * No bounds checking is performed; the underlying file stream will throw
-   * an exception if the page is past the end of the file.
+   * No bounds checking is performed; the contents of a page past the end of
+   * the file are unspecified.
    *
-   * @param page_number   Number of page to read.
-   * @param allow_free    Whether to allow reading a free (unused) page.
+   * @param page_number       Number of page to read.
+   * @param allow_free        Whether to allow reading a free (unused) page.
+   * @param verify_checksum   Whether to check the page against its checksum,
+   *                          if checksums are verified at all.
    * @return  The page.
    * @throws  InvalidPageException  If the page is free (unused) and
    *                                allow_free is false.
+   * @throws  ChecksumMismatchException   If the page read from disk does not
+   *                                      match its checksum.
+   */
+  Page readPage(const PageId page_number, const bool allow_free,
+                const bool verify_checksum = true) const;
+
+  /**
+   * Turns the bytes of a page read from disk into a page, checking it as
+   * readPage() does.
+   *
+   * @param page_number       Number of page.
+   * @param buffer            Bytes of page as laid out on disk.
+   * @param allow_free        Whether to allow a free (unused) page.
+   * @param verify_checksum   Whether to check the page against its checksum,
+   *                          if checksums are verified at all.
+   * @return  The page.
+   * @throws  InvalidPageException  If the page is free (unused) and
+   *                                allow_free is false.
+   * @throws  ChecksumMismatchException   If the page does not match its
+   *                                      checksum.
+   */
+  Page decodePage(const PageId page_number, const char* buffer,
+                  const bool allow_free, const bool verify_checksum) const;
+
+  /**
+   * Computes the checksum of a page as laid out on disk.  The fields of the
+   * header which the checksum does not cover are ignored.
+   *
+   * @param buffer  Bytes of page.
+   * @return  Checksum of page.
    */
-  Page readPage(const PageId page_number, const bool allow_free) const;
+  static std::uint32_t pageChecksum(const char* buffer);
+
+  /**
+   * Returns true if a page as laid out on disk matches its checksum.  Pages
+   * reserved but never written read as zeros and have no checksum, so they
+   * count as intact.
+   *
+   * @param buffer  Bytes of page.
+   */
+  static bool pageIntact(const char* buffer);
 
   /**
    * Writes a page into the file at the given page number.  This does not
@@ -279,14 +605,51 @@ class File {
                  const Page& new_page);
 
   /**
-   * Reads the header for this file from disk.
+   * Returns the header with which a page handed to writePage() is written,
+   * with the links the file keeps for it.
+   *
+   * @param new_page  Page to write.
+   * @return  Header to write.
+   * @throws  InvalidPageException  If the page is not currently used.
+   */
+  PageHeader headerForWrite(const Page& new_page);
+
+  /**
+   * Lays a page out as it is stored on disk, setting its checksum.
+   *
+   * @param header    Header of page to write.
+   * @param new_page  Page to write.
+   * @param buffer    Buffer of Page::SIZE bytes the page is laid out in.
+   */
+  static void layOutPage(const PageHeader& header, const Page& new_page,
+                         char* buffer);
+
+  /**
+   * Returns the name of the doublewrite file of a file.
+   */
+  static std::string doublewriteFilename(const std::string& filename) {
+    return filename + ".dblwr";
+  }
+
+  /**
+   * Restores the pages of any batch left in the doublewrite file by a crash
+   * which fail their checksum, and empties the doublewrite file.  Intact
+   * pages are left alone even if they differ from their copy, as they may
+   * have been written again since the batch.
+   */
+  void repairTornPages();
+
+  /**
+   * Returns the header for this file.  The header is read from disk once when
+   * the file is opened and kept in memory afterwards.
    *
    * @return  The file header.
    */
   FileHeader readHeader() const;
 
   /**
-   * Writes the given header to the disk as the header for this file.
+   * Replaces the header for this file.  Only the copy kept in memory is
+   * changed; it is written to disk by sync().
    *
    * @param header  File header to write.
    */
@@ -301,19 +664,183 @@ class File {
    */
   PageHeader readPageHeader(const PageId page_number) const;
 
+  /**
+   * Writes one of the used list links in the header of the given page to
+   * disk, leaving the rest of the page alone.  No bounds checking is
+   * performed.
+   *
+   * @param page_number   Number of page whose link is to be written.
+   * @param offset        Offset of the link within PageHeader.
+   * @param value         Page number to link to.
+   */
+  void writeLink(const PageId page_number, const std::size_t offset,
+                 const PageId value);
+
+  /**
+   * Looks up the used list links of the given page, as last read from or
+   * written to disk.
+   *
+   * @param page_number   Number of page.
+   * @param links         Set to the links of the page if they are known.
+   * @return  True if the links are known.
+   */
+  bool recallLinks(const PageId page_number, PageLinks& links) const;
+
+  /**
+   * Records the used list links of the given page.
+   *
+   * @param page_number       Number of page.
+   * @param next_page_number  Number of next used page.
+   * @param prev_page_number  Number of previous used page.
+   */
+  void rememberLinks(const PageId page_number, const PageId next_page_number,
+                     const PageId prev_page_number) const;
+
+  /**
+   * Forgets the used list links of the given page, for example because it
+   * has been deleted.
+   *
+   * @param page_number   Number of page.
+   */
+  void forgetLinks(const PageId page_number) const;
+
+  /**
+   * Returns the number of the used page which follows the given one in
+   * iteration order.
+   *
+   * @param page_number   Number of used page, or Page::INVALID_NUMBER for
+   *                      the first used page.
+   * @return  Number of next used page, or Page::INVALID_NUMBER if there is
+   *          none.
+   */
+  PageId nextUsedPage(const PageId page_number) const;
+
+  /**
+   * Reserves the next extent of the file if the page about to be appended,
+   * header.num_pages, lies beyond the storage reserved so far.
+   *
+   * @param header  Header of the file, updated with the new high-water mark.
+   */
+  void reserveExtent(FileHeader& header);
+
+  /**
+   * Reads the map pages of a file in the space map format into space_map_.
+   */
+  void readSpaceMap();
+
+  /**
+   * Replays the write-ahead log of the file, applying every record with a
+   * higher LSN than the page it describes.
+   */
+  void recover();
+
+  /**
+   * Writes the word of the space map which holds the bit of the given page.
+   *
+   * @param page_number   Number of page whose bit changed.
+   */
+  void writeSpaceMapWord(const PageId page_number);
+
+  /**
+   * Writes a whole map page of the space map.
+   *
+   * @param map_page  Number of map page.
+   */
+  void writeSpaceMapPage(const PageId map_page);
+
+  /**
+   * @brief State of an open file, shared by all File objects which refer to
+   *        it.
+   */
+  struct OpenFile {
+    /**
+     * Number identifying the opened file, as returned by id().
+     */
+    std::uint64_t id;
+
+    /**
+     * Number of File objects referring to the file.
+     */
+    int open_count;
+
+    /**
+     * Backend storing the file.
+     */
+    std::shared_ptr<FileBackend> backend;
+
+    /**
+     * I/O counters of the file.
+     */
+    std::shared_ptr<FileStats> stats;
+
+    /**
+     * Space map of the file, or null if it is not in the space map format.
+     */
+    std::shared_ptr<SpaceMap> space_map;
+
+    /**
+     * Write-ahead log of the file, or null if it is not logged.
+     */
+    std::shared_ptr<LogManager> log;
+
+    /**
+     * Storage of the doublewrite file, or null if the file is not in the
+     * doublewrite format.
+     */
+    std::shared_ptr<FileBackend> doublewrite;
+
+    /**
+     * Current header.
+     */
+    FileHeader header;
+
+    /**
+     * Whether the header has changed since it was last written to disk.
+     */
+    bool dirty;
+
+    /**
+     * Used list links of the pages of the file, indexed by page number, so
+     * that pages can be written without first reading back their links.
+     * Filled in as pages are read, allocated and relinked.
+     */
+    std::vector<PageLinks> links;
+  };
+
   typedef std::map<std::string,
-                   std::shared_ptr<std::fstream> > StreamMap;
-  typedef std::map<std::string, int> CountMap;
+                   std::shared_ptr<FileBackend> > BackendMap;
+  typedef std::unordered_map<std::string,
+                             std::shared_ptr<OpenFile> > OpenFileMap;
+
+  /**
+   * Opened files.  Only consulted when a file is opened by name.
+   */
+  static OpenFileMap open_files_;
 
   /**
-   * Streams for opened files.
+   * Storage of in-memory files, whether open or not, without decorators.
    */
-  static StreamMap open_streams_;
+  static BackendMap memory_files_;
 
   /**
-   * Counts for opened files.
+   * Decorator applied to the backend of newly opened files.
    */
-  static CountMap open_counts_;
+  static BackendDecorator backend_decorator_;
+
+  /**
+   * Number given to the next opened file.
+   */
+  static std::uint64_t next_open_file_id_;
+
+  /**
+   * Number of pages in an extent.
+   */
+  static PageId extent_pages_;
+
+  /**
+   * Whether pages read from files are checked against their checksums.
+   */
+  static bool verify_checksums_;
 
   /**
    * Name of the file this object represents.
@@ -321,9 +848,25 @@ class File {
   std::string filename_;
 
   /**
-   * Stream for underlying filesystem object.
+   * State of underlying filesystem object, or null once closed.
+   */
+  std::shared_ptr<OpenFile> open_file_;
+
+  /**
+   * Backend storing the underlying file; open_file_->backend.
+   */
+  std::shared_ptr<FileBackend> backend_;
+
+  /**
+   * I/O counters of underlying filesystem object; open_file_->stats.
+   */
+  std::shared_ptr<FileStats> stats_;
+
+  /**
+   * Space map of underlying filesystem object, or null if the file is not in
+   * the space map format; open_file_->space_map.
    */
-  std::shared_ptr<std::fstream> stream_;
+  std::shared_ptr<SpaceMap> space_map_;
 
   friend class FileIterator;
   friend class FileTest;
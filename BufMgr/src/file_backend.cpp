@@ -0,0 +1,241 @@
+/**
+ * @author See Contributors.txt for code contributors and overview of BadgerDB.
+ *
+ * @section LICENSE
+ * Copyright (c) 2012 Database Group, Computer Sciences Department, University of Wisconsin-Madison.
+ */
+
+#include "file_backend.h"
+
+#include <algorithm>
+#include <cstring>
+#include <list>
+#include <mutex>
+#include <fcntl.h>
+#include <unistd.h>
+
+namespace badgerdb {
+
+namespace {
+
+/**
+ * Streams of all stream backends, of which at most a limited number are open
+ * at a time.
+ */
+class StreamCache {
+ public:
+  StreamCache() : limit_(StreamBackend::DEFAULT_OPEN_LIMIT), open_(0) {}
+
+  /**
+   * Registers a file and opens its stream.
+   *
+   * @return  ID under which the stream is found.
+   */
+  FileId add(const std::string& filename, const bool truncate) {
+    FileId id;
+    if (free_ids_.empty()) {
+      id = static_cast<FileId>(slots_.size());
+      slots_.push_back(Slot());
+    } else {
+      id = free_ids_.back();
+      free_ids_.pop_back();
+    }
+    slots_[id].filename = filename;
+    open(id, truncate ? std::fstream::trunc : std::ios_base::openmode());
+    return id;
+  }
+
+  /**
+   * Closes the stream of a file and forgets the file.
+   */
+  void remove(const FileId id) {
+    close(id);
+    slots_[id].filename.clear();
+    free_ids_.push_back(id);
+  }
+
+  /**
+   * Returns the descriptor of a file, opening its stream if it has been
+   * closed.  The descriptor stays valid only while the cache mutex is held.
+   *
+   * @return  Descriptor, or -1 if the file could not be opened.
+   */
+  int descriptor(const FileId id) {
+    get(id);
+    return slots_[id].fd;
+  }
+
+  /**
+   * Returns the stream of a file, opening it if it has been closed.
+   */
+  std::fstream& get(const FileId id) {
+    Slot& slot = slots_[id];
+    if (slot.stream) {
+      lru_.splice(lru_.end(), lru_, slot.lru_position);
+    } else {
+      open(id, std::ios_base::openmode());
+    }
+    return *slot.stream;
+  }
+
+  void setLimit(const std::size_t limit) {
+    limit_ = std::max<std::size_t>(limit, 1);
+    while (open_ > limit_) {
+      close(lru_.front());
+    }
+  }
+
+  std::size_t open() const { return open_; }
+
+  std::mutex& mutex() { return mutex_; }
+
+ private:
+  struct Slot {
+    std::string filename;
+    std::unique_ptr<std::fstream> stream;
+    int fd;
+    std::list<FileId>::iterator lru_position;
+  };
+
+  void open(const FileId id, const std::ios_base::openmode extra_mode) {
+    if (open_ >= limit_) {
+      close(lru_.front());
+    }
+    Slot& slot = slots_[id];
+    slot.stream.reset(new std::fstream(
+        slot.filename, std::fstream::in | std::fstream::out |
+                           std::fstream::binary | extra_mode));
+    // Opened after the stream, which creates or truncates the file.
+    slot.fd = ::open(slot.filename.c_str(), O_WRONLY);
+    slot.lru_position = lru_.insert(lru_.end(), id);
+    ++open_;
+  }
+
+  void close(const FileId id) {
+    Slot& slot = slots_[id];
+    if (slot.stream) {
+      slot.stream.reset();
+      if (slot.fd >= 0) {
+        ::close(slot.fd);
+      }
+      lru_.erase(slot.lru_position);
+      --open_;
+    }
+  }
+
+  std::vector<Slot> slots_;
+  std::vector<FileId> free_ids_;
+
+  /**
+   * IDs of files with open streams, least recently used first.
+   */
+  std::list<FileId> lru_;
+
+  std::size_t limit_;
+  std::size_t open_;
+  std::mutex mutex_;
+};
+
+StreamCache& streamCache() {
+  static StreamCache cache;
+  return cache;
+}
+
+}
+
+const std::size_t StreamBackend::DEFAULT_OPEN_LIMIT;
+
+StreamBackend::StreamBackend(const std::string& filename, const bool truncate) {
+  std::lock_guard<std::mutex> lock(streamCache().mutex());
+  id_ = streamCache().add(filename, truncate);
+}
+
+StreamBackend::~StreamBackend() {
+  std::lock_guard<std::mutex> lock(streamCache().mutex());
+  streamCache().remove(id_);
+}
+
+void StreamBackend::setOpenLimit(const std::size_t limit) {
+  std::lock_guard<std::mutex> lock(streamCache().mutex());
+  streamCache().setLimit(limit);
+}
+
+std::size_t StreamBackend::openStreams() {
+  std::lock_guard<std::mutex> lock(streamCache().mutex());
+  return streamCache().open();
+}
+
+void StreamBackend::read(const std::uint64_t offset, char* data,
+                         const std::size_t length) {
+  std::lock_guard<std::mutex> lock(streamCache().mutex());
+  std::fstream& stream = streamCache().get(id_);
+  stream.seekg(offset, std::ios::beg);
+  stream.read(data, length);
+}
+
+void StreamBackend::write(const std::uint64_t offset, const char* data,
+                          const std::size_t length) {
+  std::lock_guard<std::mutex> lock(streamCache().mutex());
+  std::fstream& stream = streamCache().get(id_);
+  stream.seekp(offset, std::ios::beg);
+  stream.write(data, length);
+}
+
+void StreamBackend::flush() {
+  std::lock_guard<std::mutex> lock(streamCache().mutex());
+  streamCache().get(id_).flush();
+}
+
+void StreamBackend::sync() {
+  std::lock_guard<std::mutex> lock(streamCache().mutex());
+  streamCache().get(id_).flush();
+  const int fd = streamCache().descriptor(id_);
+  if (fd >= 0) {
+    ::fdatasync(fd);
+  }
+}
+
+void StreamBackend::reserve(const std::uint64_t offset,
+                            const std::uint64_t length) {
+  std::lock_guard<std::mutex> lock(streamCache().mutex());
+  const int fd = streamCache().descriptor(id_);
+  if (fd >= 0) {
+    posix_fallocate(fd, offset, length);
+  }
+}
+
+void MemoryBackend::read(const std::uint64_t offset, char* data,
+                         const std::size_t length) {
+  std::size_t done = 0;
+  while (done < length) {
+    const std::uint64_t chunk = (offset + done) / CHUNK_SIZE;
+    const std::size_t within = (offset + done) % CHUNK_SIZE;
+    const std::size_t count = std::min(length - done, CHUNK_SIZE - within);
+    if (chunk < chunks_.size() && chunks_[chunk]) {
+      std::memcpy(data + done, chunks_[chunk].get() + within, count);
+    } else {
+      std::memset(data + done, 0, count);
+    }
+    done += count;
+  }
+}
+
+void MemoryBackend::write(const std::uint64_t offset, const char* data,
+                          const std::size_t length) {
+  std::size_t done = 0;
+  while (done < length) {
+    const std::uint64_t chunk = (offset + done) / CHUNK_SIZE;
+    const std::size_t within = (offset + done) % CHUNK_SIZE;
+    const std::size_t count = std::min(length - done, CHUNK_SIZE - within);
+    if (chunk >= chunks_.size()) {
+      chunks_.resize(chunk + 1);
+    }
+    if (!chunks_[chunk]) {
+      chunks_[chunk].reset(new char[CHUNK_SIZE]());
+    }
+    std::memcpy(chunks_[chunk].get() + within, data + done, count);
+    done += count;
+  }
+}
+
+}
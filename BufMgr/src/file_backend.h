@@ -0,0 +1,183 @@
+/**
+ * @author See Contributors.txt for code contributors and overview of BadgerDB.
+ *
+ * @section LICENSE
+ * Copyright (c) 2012 Database Group, Computer Sciences Department, University of Wisconsin-Madison.
+ */
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <fstream>
+#include <functional>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "types.h"
+
+namespace badgerdb {
+
+/**
+ * @brief Byte-addressed storage underneath a File.
+ *
+ * File lays out its header and pages at fixed offsets and leaves moving the
+ * bytes to a backend.  Backends can be stacked: a decorator wraps another
+ * backend to add behaviour such as emulated device latency.  All File
+ * objects for the same file share one backend.
+ */
+class FileBackend {
+ public:
+  virtual ~FileBackend() {}
+
+  /**
+   * Reads bytes at the given offset.  No bounds checking is performed; bytes
+   * past the end of the storage are left unspecified.
+   *
+   * @param offset  Offset from the start of the storage.
+   * @param data    Buffer the bytes are read into.
+   * @param length  Number of bytes to read.
+   */
+  virtual void read(const std::uint64_t offset, char* data,
+                    const std::size_t length) = 0;
+
+  /**
+   * Writes bytes at the given offset, growing the storage if needed.
+   *
+   * @param offset  Offset from the start of the storage.
+   * @param data    Bytes to write.
+   * @param length  Number of bytes to write.
+   */
+  virtual void write(const std::uint64_t offset, const char* data,
+                     const std::size_t length) = 0;
+
+  /**
+   * Passes buffered writes on to the operating system.
+   */
+  virtual void flush() = 0;
+
+  /**
+   * Makes all writes so far durable, so that they survive a crash of the
+   * machine.  Backends without durable storage only flush.
+   */
+  virtual void sync() { flush(); }
+
+  /**
+   * Reserves storage for a range of bytes ahead of writing it, so that the
+   * range is laid out contiguously and writing it does not grow the storage
+   * piecemeal.  This is only a hint; backends may ignore it.
+   *
+   * @param offset  Offset from the start of the storage.
+   * @param length  Number of bytes to reserve.
+   */
+  virtual void reserve(const std::uint64_t /* offset */,
+                       const std::uint64_t /* length */) {}
+};
+
+/**
+ * @brief Backend which stores the file on disk through a std::fstream.
+ *
+ * Streams are kept in a cache shared by all stream backends which holds at
+ * most a limited number of them open, closing the least recently used one
+ * when another has to be opened.  A backend whose stream has been closed
+ * opens it again the next time it is used, so any number of files can be
+ * open without running out of file descriptors.  Streams are looked up by
+ * the FileId the backend was registered under, in constant time.  Each open
+ * stream comes with a descriptor of the same file, which sync() and reserve()
+ * use since std::fstream does not expose its own.
+ */
+class StreamBackend : public FileBackend {
+ public:
+  /**
+   * Default number of streams which are kept open.
+   */
+  static const std::size_t DEFAULT_OPEN_LIMIT = 256;
+
+  /**
+   * Opens a file on disk.
+   *
+   * @param filename  Name of the file.
+   * @param truncate  Whether to discard existing contents of the file.
+   */
+  StreamBackend(const std::string& filename, const bool truncate);
+
+  /**
+   * Closes the stream, if it is open.
+   */
+  virtual ~StreamBackend();
+
+  /**
+   * Sets the number of streams which are kept open, closing the least
+   * recently used ones if there are more.
+   *
+   * @param limit   Number of streams; at least one is kept open.
+   */
+  static void setOpenLimit(const std::size_t limit);
+
+  /**
+   * Returns the number of streams which are currently open.
+   */
+  static std::size_t openStreams();
+
+  virtual void read(const std::uint64_t offset, char* data,
+                    const std::size_t length);
+  virtual void write(const std::uint64_t offset, const char* data,
+                     const std::size_t length);
+  virtual void flush();
+
+  /**
+   * Flushes the stream and syncs the file with fdatasync().
+   */
+  virtual void sync();
+
+  /**
+   * Allocates the range on disk with posix_fallocate(), which also extends
+   * the file over it.  Failures are ignored.
+   */
+  virtual void reserve(const std::uint64_t offset,
+                       const std::uint64_t length);
+
+ private:
+  StreamBackend(const StreamBackend&);
+  StreamBackend& operator=(const StreamBackend&);
+
+  /**
+   * Identifier of the stream in the stream cache.
+   */
+  FileId id_;
+};
+
+/**
+ * @brief Backend which keeps the file in memory.
+ *
+ * Storage is an arena of fixed-size chunks allocated as the file grows, so
+ * growing never moves existing data.  Bytes never written read as zero.
+ */
+class MemoryBackend : public FileBackend {
+ public:
+  /**
+   * Size of the chunks storage is allocated in.
+   */
+  static const std::size_t CHUNK_SIZE = 64 * 1024;
+
+  virtual void read(const std::uint64_t offset, char* data,
+                    const std::size_t length);
+  virtual void write(const std::uint64_t offset, const char* data,
+                     const std::size_t length);
+  virtual void flush() {}
+
+ private:
+  std::vector<std::unique_ptr<char[]> > chunks_;
+};
+
+/**
+ * Wraps the backend of a newly opened file in decorators.  Called with the
+ * file name and the backend that would otherwise be used; returns the
+ * backend to use instead, or the one it was given.
+ */
+typedef std::function<std::shared_ptr<FileBackend>(
+    const std::string& filename, std::shared_ptr<FileBackend> backend)>
+    BackendDecorator;
+
+}
@@ -39,8 +39,7 @@ class FileIterator {
   FileIterator(File* file)
       : file_(file) {
     assert(file_ != NULL);
-    const FileHeader& header = file_->readHeader();
-    current_page_number_ = header.first_used_page;
+    current_page_number_ = file_->nextUsedPage(Page::INVALID_NUMBER);
   }
 
   /**
@@ -60,8 +59,7 @@ class FileIterator {
    */
 	inline FileIterator& operator++() {
     assert(file_ != NULL);
-    const PageHeader& header = file_->readPageHeader(current_page_number_);
-    current_page_number_ = header.next_page_number;
+    current_page_number_ = file_->nextUsedPage(current_page_number_);
 
 		return *this;
 	}
@@ -72,8 +70,7 @@ class FileIterator {
 		FileIterator tmp = *this;   // copy ourselves
 
     assert(file_ != NULL);
-    const PageHeader& header = file_->readPageHeader(current_page_number_);
-    current_page_number_ = header.next_page_number;
+    current_page_number_ = file_->nextUsedPage(current_page_number_);
 
 		return tmp;
 	}
@@ -103,6 +100,14 @@ class FileIterator {
 	inline Page operator*() const
   { return file_->readPage(current_page_number_); }
 
+  /**
+   * Returns the number of the page the iterator is pointing to, without
+   * reading the page.
+   *
+   * @return  Number of current page.
+   */
+  PageId page_number() const { return current_page_number_; }
+
  private:
   /**
    * File we're iterating over.
@@ -0,0 +1,122 @@
+/**
+ * @author See Contributors.txt for code contributors and overview of BadgerDB.
+ *
+ * @section LICENSE
+ * Copyright (c) 2012 Database Group, Computer Sciences Department, University of Wisconsin-Madison.
+ */
+
+#include "free_space_map.h"
+
+#include <algorithm>
+
+#include "buffer.h"
+#include "file_iterator.h"
+
+namespace badgerdb {
+
+const std::uint16_t FreeSpaceMap::GRANULE;
+const PageId FreeSpaceMap::ENTRIES_PER_PAGE;
+
+FreeSpaceMap::FreeSpaceMap(BufMgr* buf_mgr, const std::string& filename)
+    : buf_mgr_(buf_mgr),
+      file_(openOrCreate(filenameFor(filename))),
+      map_pages_(0),
+      leaves_(1),
+      tree_(2, 0) {
+  // Pages of the map file are only ever appended, so they are numbered from 1
+  // without gaps.  Counting them only reads page headers.
+  for (FileIterator iter = file_.begin(); iter != file_.end(); ++iter) {
+    ++map_pages_;
+  }
+  for (PageId map_page = 1; map_page <= map_pages_; ++map_page) {
+    Page* page;
+    buf_mgr_->readPage(&file_, map_page, page);
+    for (PageId entry = 0; entry < ENTRIES_PER_PAGE; ++entry) {
+      const std::uint8_t category = page->data_[entry];
+      if (category != 0) {
+        setCategory((map_page - 1) * ENTRIES_PER_PAGE + entry, category);
+      }
+    }
+    buf_mgr_->unPinPage(&file_, map_page, false);
+  }
+}
+
+FreeSpaceMap::~FreeSpaceMap() {
+  buf_mgr_->flushFile(&file_);
+}
+
+void FreeSpaceMap::update(const PageId page_number,
+                          const std::size_t free_bytes) {
+  const std::uint8_t category = static_cast<std::uint8_t>(
+      std::min<std::size_t>(free_bytes / GRANULE, 255));
+  if (page_number < leaves_ ? tree_[leaves_ + page_number] == category
+                            : category == 0) {
+    return;
+  }
+  setCategory(page_number, category);
+
+  const PageId map_page = page_number / ENTRIES_PER_PAGE + 1;
+  while (map_pages_ < map_page) {
+    PageId new_page_number;
+    Page* new_page;
+    buf_mgr_->allocPage(&file_, new_page_number, new_page);
+    buf_mgr_->unPinPage(&file_, new_page_number, true);
+    ++map_pages_;
+  }
+  Page* page;
+  buf_mgr_->readPage(&file_, map_page, page);
+  page->data_[page_number % ENTRIES_PER_PAGE] = static_cast<char>(category);
+  buf_mgr_->unPinPage(&file_, map_page, true);
+}
+
+PageId FreeSpaceMap::findPage(const std::size_t bytes) const {
+  const std::size_t needed =
+      std::max<std::size_t>((bytes + GRANULE - 1) / GRANULE, 1);
+  if (needed > tree_[1]) {
+    return Page::INVALID_NUMBER;
+  }
+  // Descend towards the leftmost leaf with enough space.
+  std::size_t node = 1;
+  while (node < leaves_) {
+    node = tree_[2 * node] >= needed ? 2 * node : 2 * node + 1;
+  }
+  return static_cast<PageId>(node - leaves_);
+}
+
+std::size_t FreeSpaceMap::freeSpace(const PageId page_number) const {
+  if (page_number >= leaves_) {
+    return 0;
+  }
+  return tree_[leaves_ + page_number] * GRANULE;
+}
+
+File FreeSpaceMap::openOrCreate(const std::string& filename) {
+  if (File::exists(filename)) {
+    return File::open(filename);
+  }
+  return File::create(filename);
+}
+
+void FreeSpaceMap::setCategory(const PageId page_number,
+                               const std::uint8_t category) {
+  if (page_number >= leaves_) {
+    std::size_t leaves = leaves_;
+    while (page_number >= leaves) {
+      leaves *= 2;
+    }
+    std::vector<std::uint8_t> tree(2 * leaves, 0);
+    std::copy(tree_.begin() + leaves_, tree_.end(), tree.begin() + leaves);
+    for (std::size_t node = leaves - 1; node >= 1; --node) {
+      tree[node] = std::max(tree[2 * node], tree[2 * node + 1]);
+    }
+    tree_.swap(tree);
+    leaves_ = leaves;
+  }
+  std::size_t node = leaves_ + page_number;
+  tree_[node] = category;
+  for (node /= 2; node >= 1; node /= 2) {
+    tree_[node] = std::max(tree_[2 * node], tree_[2 * node + 1]);
+  }
+}
+
+}
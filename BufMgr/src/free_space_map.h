@@ -0,0 +1,146 @@
+/**
+ * @author See Contributors.txt for code contributors and overview of BadgerDB.
+ *
+ * @section LICENSE
+ * Copyright (c) 2012 Database Group, Computer Sciences Department, University of Wisconsin-Madison.
+ */
+
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "file.h"
+#include "types.h"
+
+namespace badgerdb {
+
+class BufMgr;
+
+/**
+ * @brief Records how much free space each page of a file has, so that a page
+ *        with room for a record can be found without reading pages.
+ *
+ * The free space of a page is kept as a one byte category, the number of
+ * whole GRANULE byte units free, so the space a category promises is a lower
+ * bound.  Categories are stored ENTRIES_PER_PAGE to a page in a companion
+ * file named by filenameFor(), which is read and written through the buffer
+ * manager like any other file.  A max segment tree over the categories is
+ * kept in memory to find the lowest numbered page with enough space in
+ * O(log n).
+ *
+ * The map only knows what it is told: whoever changes the free space of a
+ * page should call update() afterwards.  Pages never mentioned have no free
+ * space as far as the map is concerned.
+ */
+class FreeSpaceMap {
+ public:
+  /**
+   * Number of bytes of free space per category step.
+   */
+  static const std::uint16_t GRANULE = Page::SIZE / 256;
+
+  /**
+   * Number of pages whose category is stored in one page of the map.
+   */
+  static const PageId ENTRIES_PER_PAGE = Page::DATA_SIZE;
+
+  /**
+   * Returns the name of the companion file holding the map of a file.
+   *
+   * @param filename  Name of file the map describes.
+   * @return  Name of map file.
+   */
+  static std::string filenameFor(const std::string& filename) {
+    return filename + ".fsm";
+  }
+
+  /**
+   * Opens the map of a file, creating the companion file if it does not
+   * exist yet, and loads it into memory.
+   *
+   * @param buf_mgr   Buffer manager through which the map file is accessed.
+   * @param filename  Name of file the map describes.
+   */
+  FreeSpaceMap(BufMgr* buf_mgr, const std::string& filename);
+
+  /**
+   * Writes the map file back and closes it.
+   */
+  ~FreeSpaceMap();
+
+  /**
+   * Records the amount of free space on a page.
+   *
+   * @param page_number   Number of page.
+   * @param free_bytes    Free space on the page, for example from
+   *                      Page::getFreeSpace().
+   */
+  void update(const PageId page_number, const std::size_t free_bytes);
+
+  /**
+   * Returns the lowest numbered page which has at least the given amount of
+   * free space.
+   *
+   * @param bytes   Amount of space needed.
+   * @return  Number of page, or Page::INVALID_NUMBER if no page is known to
+   *          have that much space.
+   */
+  PageId findPage(const std::size_t bytes) const;
+
+  /**
+   * Returns the free space the map promises for a page.
+   *
+   * @param page_number   Number of page.
+   * @return  Lower bound on the free space of the page.
+   */
+  std::size_t freeSpace(const PageId page_number) const;
+
+  /**
+   * Returns the file holding the map.
+   */
+  const File& file() const { return file_; }
+
+ private:
+  FreeSpaceMap(const FreeSpaceMap&);
+  FreeSpaceMap& operator=(const FreeSpaceMap&);
+
+  /**
+   * Opens the map file with the given name, creating it if needed.
+   */
+  static File openOrCreate(const std::string& filename);
+
+  /**
+   * Sets the category of a page in the segment tree, growing it if needed.
+   */
+  void setCategory(const PageId page_number, const std::uint8_t category);
+
+  /**
+   * Buffer manager through which the map file is accessed.
+   */
+  BufMgr* buf_mgr_;
+
+  /**
+   * File holding the categories.
+   */
+  File file_;
+
+  /**
+   * Number of pages in the map file.
+   */
+  PageId map_pages_;
+
+  /**
+   * Number of leaves of the segment tree, a power of two.
+   */
+  std::size_t leaves_;
+
+  /**
+   * Max segment tree over the categories: node i has children 2i and 2i + 1,
+   * and leaf leaves_ + p holds the category of page p.
+   */
+  std::vector<std::uint8_t> tree_;
+};
+
+}
@@ -0,0 +1,329 @@
+/**
+ * @author See Contributors.txt for code contributors and overview of BadgerDB.
+ *
+ * @section LICENSE
+ * Copyright (c) 2012 Database Group, Computer Sciences Department, University of Wisconsin-Madison.
+ */
+
+#include "heap_file.h"
+
+#include <cstring>
+
+#include "buffer.h"
+#include "exceptions/buffer_exceeded_exception.h"
+#include "exceptions/insufficient_space_exception.h"
+#include "exceptions/invalid_record_exception.h"
+#include "page_iterator.h"
+
+namespace badgerdb {
+
+namespace {
+
+/**
+ * Kinds of stored records, kept in their first byte.
+ */
+const char HOME_RECORD = 'h';
+const char PADDED_HOME_RECORD = 'p';
+const char FORWARDING_STUB = 'f';
+const char MOVED_RECORD = 'm';
+
+/**
+ * Size of a forwarding stub: its kind and the ID of the moved record.
+ */
+const std::size_t STUB_SIZE = 1 + sizeof(PageId) + sizeof(SlotId);
+
+std::string encodeHome(const std::string& record_data) {
+  if (1 + record_data.length() >= STUB_SIZE) {
+    return HOME_RECORD + record_data;
+  }
+  std::string stored(STUB_SIZE, '\0');
+  stored[0] = PADDED_HOME_RECORD;
+  stored[1] = static_cast<char>(record_data.length());
+  stored.replace(2, record_data.length(), record_data);
+  return stored;
+}
+
+std::string decodeHome(const std::string& stored) {
+  if (stored[0] == PADDED_HOME_RECORD) {
+    return stored.substr(2, static_cast<unsigned char>(stored[1]));
+  }
+  return stored.substr(1);
+}
+
+std::string encodeStub(const RecordId& target) {
+  std::string stored(STUB_SIZE, FORWARDING_STUB);
+  std::memcpy(&stored[1], &target.page_number, sizeof(PageId));
+  std::memcpy(&stored[1 + sizeof(PageId)], &target.slot_number,
+              sizeof(SlotId));
+  return stored;
+}
+
+RecordId decodeStub(const std::string& stored) {
+  RecordId target;
+  std::memcpy(&target.page_number, &stored[1], sizeof(PageId));
+  std::memcpy(&target.slot_number, &stored[1 + sizeof(PageId)],
+              sizeof(SlotId));
+  return target;
+}
+
+/**
+ * Keeps a page pinned in the buffer pool for as long as it is in scope.
+ */
+class PagePin {
+ public:
+  /**
+   * Pins an existing page.
+   */
+  PagePin(BufMgr* buf_mgr, File* file, const PageId page_number)
+      : buf_mgr_(buf_mgr), file_(file), page_number_(page_number),
+        page_(NULL), dirty_(false) {
+    buf_mgr_->readPage(file_, page_number_, page_);
+    if (page_ == NULL) {
+      throw BufferExceededException();
+    }
+  }
+
+  /**
+   * Allocates and pins a new page.
+   */
+  PagePin(BufMgr* buf_mgr, File* file)
+      : buf_mgr_(buf_mgr), file_(file), page_number_(Page::INVALID_NUMBER),
+        page_(NULL), dirty_(true) {
+    buf_mgr_->allocPage(file_, page_number_, page_);
+    if (page_ == NULL) {
+      throw BufferExceededException();
+    }
+  }
+
+  ~PagePin() {
+    buf_mgr_->unPinPage(file_, page_number_, dirty_);
+  }
+
+  Page* operator->() const { return page_; }
+  PageId page_number() const { return page_number_; }
+  void markDirty() { dirty_ = true; }
+
+ private:
+  PagePin(const PagePin&);
+  PagePin& operator=(const PagePin&);
+
+  BufMgr* buf_mgr_;
+  File* file_;
+  PageId page_number_;
+  Page* page_;
+  bool dirty_;
+};
+
+/**
+ * Returns true if the stored record in the given slot can be replaced by a
+ * new one without running out of space on the page.
+ */
+bool fitsInPlace(const PagePin& page, const std::string& old_stored,
+                 const std::string& new_stored) {
+  return new_stored.length() <= page->getFreeSpace() + old_stored.length();
+}
+
+}
+
+HeapFile::HeapFile(BufMgr* buf_mgr, const std::string& filename,
+                   const double fill_factor)
+    : buf_mgr_(buf_mgr),
+      file_(openOrCreate(filename)),
+      free_space_map_(buf_mgr, filename),
+      reserved_bytes_(static_cast<std::size_t>(
+          (1.0 - fill_factor) * Page::DATA_SIZE)) {
+}
+
+HeapFile::~HeapFile() {
+  buf_mgr_->flushFile(&file_);
+}
+
+RecordId HeapFile::insertRecord(const std::string& record_data) {
+  return insertStored(encodeHome(record_data));
+}
+
+std::string HeapFile::getRecord(const RecordId& record_id) {
+  std::string stored;
+  {
+    PagePin home(buf_mgr_, &file_, record_id.page_number);
+    stored = home->getRecord(record_id);
+  }
+  if (stored[0] == MOVED_RECORD) {
+    // Moved records are only reachable through their stub.
+    throw InvalidRecordException(record_id, record_id.page_number);
+  }
+  if (stored[0] == FORWARDING_STUB) {
+    return readMoved(decodeStub(stored));
+  }
+  return decodeHome(stored);
+}
+
+void HeapFile::updateRecord(const RecordId& record_id,
+                            const std::string& record_data) {
+  PagePin home(buf_mgr_, &file_, record_id.page_number);
+  const std::string stored = home->getRecord(record_id);
+  if (stored[0] == MOVED_RECORD) {
+    throw InvalidRecordException(record_id, record_id.page_number);
+  }
+  const std::string moved = MOVED_RECORD + record_data;
+  if (stored[0] == FORWARDING_STUB) {
+    const RecordId target = decodeStub(stored);
+    {
+      PagePin target_page(buf_mgr_, &file_, target.page_number);
+      const std::string old_moved = target_page->getRecord(target);
+      if (fitsInPlace(target_page, old_moved, moved)) {
+        target_page->updateRecord(target, moved);
+        target_page.markDirty();
+        free_space_map_.update(target.page_number,
+                               target_page->getFreeSpace());
+        return;
+      }
+    }
+    // The new copy goes in before the old one is deleted, so that a record
+    // too large for any page leaves the old one reachable.
+    const RecordId new_target = insertStored(moved);
+    {
+      PagePin target_page(buf_mgr_, &file_, target.page_number);
+      target_page->deleteRecord(target);
+      target_page.markDirty();
+      free_space_map_.update(target.page_number, target_page->getFreeSpace());
+    }
+    // The stub is the same size whichever record it points at.
+    home->updateRecord(record_id, encodeStub(new_target));
+    home.markDirty();
+    return;
+  }
+
+  const std::string new_stored = encodeHome(record_data);
+  if (fitsInPlace(home, stored, new_stored)) {
+    home->updateRecord(record_id, new_stored);
+  } else {
+    // Home records are never shorter than a stub, so the stub fits.
+    home->updateRecord(record_id, encodeStub(insertStored(moved)));
+  }
+  home.markDirty();
+  free_space_map_.update(record_id.page_number, home->getFreeSpace());
+}
+
+void HeapFile::deleteRecord(const RecordId& record_id) {
+  PagePin home(buf_mgr_, &file_, record_id.page_number);
+  const std::string stored = home->getRecord(record_id);
+  if (stored[0] == MOVED_RECORD) {
+    throw InvalidRecordException(record_id, record_id.page_number);
+  }
+  if (stored[0] == FORWARDING_STUB) {
+    const RecordId target = decodeStub(stored);
+    PagePin target_page(buf_mgr_, &file_, target.page_number);
+    target_page->deleteRecord(target);
+    target_page.markDirty();
+    free_space_map_.update(target.page_number, target_page->getFreeSpace());
+  }
+  home->deleteRecord(record_id);
+  home.markDirty();
+  free_space_map_.update(record_id.page_number, home->getFreeSpace());
+}
+
+HeapFileScan HeapFile::scan() {
+  return HeapFileScan(this);
+}
+
+File HeapFile::openOrCreate(const std::string& filename) {
+  if (File::exists(filename)) {
+    return File::open(filename);
+  }
+  return File::create(filename);
+}
+
+RecordId HeapFile::insertStored(const std::string& stored) {
+  // The slot may not be reusable, so always count room for a new one.
+  const std::size_t needed = stored.length() + sizeof(PageSlot);
+  if (needed > Page::DATA_SIZE) {
+    throw InsufficientSpaceException(Page::INVALID_NUMBER, stored.length(),
+                                     Page::DATA_SIZE - sizeof(PageSlot));
+  }
+  const PageId page_number = free_space_map_.findPage(needed +
+                                                      reserved_bytes_);
+  if (page_number != Page::INVALID_NUMBER) {
+    PagePin page(buf_mgr_, &file_, page_number);
+    if (page->hasSpaceForRecord(stored)) {
+      const RecordId record_id = page->insertRecord(stored);
+      page.markDirty();
+      free_space_map_.update(page_number, page->getFreeSpace());
+      return record_id;
+    }
+  }
+  PagePin page(buf_mgr_, &file_);
+  const RecordId record_id = page->insertRecord(stored);
+  free_space_map_.update(page.page_number(), page->getFreeSpace());
+  return record_id;
+}
+
+std::string HeapFile::readMoved(const RecordId& target) {
+  PagePin page(buf_mgr_, &file_, target.page_number);
+  return page->getRecord(target).substr(1);
+}
+
+HeapFileScan::HeapFileScan(HeapFile* heap_file)
+    : heap_file_(heap_file),
+      next_page_(heap_file->file_.begin()),
+      page_(NULL),
+      page_number_(Page::INVALID_NUMBER),
+      slot_number_(Page::INVALID_SLOT) {
+}
+
+HeapFileScan::HeapFileScan(HeapFileScan&& other)
+    : heap_file_(other.heap_file_),
+      next_page_(other.next_page_),
+      page_(other.page_),
+      page_number_(other.page_number_),
+      slot_number_(other.slot_number_) {
+  other.page_ = NULL;
+}
+
+HeapFileScan::~HeapFileScan() {
+  releasePage();
+}
+
+bool HeapFileScan::next(RecordId& record_id, std::string& record_data) {
+  while (true) {
+    if (page_ == NULL) {
+      if (next_page_ == heap_file_->file_.end()) {
+        return false;
+      }
+      page_number_ = next_page_.page_number();
+      ++next_page_;
+      heap_file_->buf_mgr_->readPage(&heap_file_->file_, page_number_, page_);
+      if (page_ == NULL) {
+        throw BufferExceededException();
+      }
+      slot_number_ = Page::INVALID_SLOT;
+    }
+    const RecordId current = {page_number_, slot_number_};
+    slot_number_ = PageIterator(page_, current).getNextUsedSlot(slot_number_);
+    if (slot_number_ == Page::INVALID_SLOT) {
+      releasePage();
+      continue;
+    }
+    record_id = {page_number_, slot_number_};
+    const std::string stored = page_->getRecord(record_id);
+    if (stored[0] == MOVED_RECORD) {
+      // Returned when the scan reaches its stub.
+      continue;
+    }
+    if (stored[0] == FORWARDING_STUB) {
+      record_data = heap_file_->readMoved(decodeStub(stored));
+    } else {
+      record_data = decodeHome(stored);
+    }
+    return true;
+  }
+}
+
+void HeapFileScan::releasePage() {
+  if (page_ != NULL) {
+    heap_file_->buf_mgr_->unPinPage(&heap_file_->file_, page_number_, false);
+    page_ = NULL;
+  }
+}
+
+}
@@ -0,0 +1,231 @@
+/**
+ * @author See Contributors.txt for code contributors and overview of BadgerDB.
+ *
+ * @section LICENSE
+ * Copyright (c) 2012 Database Group, Computer Sciences Department, University of Wisconsin-Madison.
+ */
+
+#pragma once
+
+#include <string>
+
+#include "file.h"
+#include "file_iterator.h"
+#include "free_space_map.h"
+#include "types.h"
+
+namespace badgerdb {
+
+class BufMgr;
+class HeapFileScan;
+
+/**
+ * @brief Unordered collection of records stored in a file, read and written
+ *        through the buffer manager.
+ *
+ * Records are placed on the lowest numbered page with room for them, found
+ * with a FreeSpaceMap.  A fill factor below 1 leaves part of every page free
+ * on insertion, so that records on it can grow in place later.
+ *
+ * A record keeps its RecordId for its whole life.  When an update no longer
+ * fits on the page the record was inserted on, the record is moved to
+ * another page and a forwarding stub pointing at it is left in its slot;
+ * reads through the original RecordId follow the stub.
+ *
+ * Each stored record starts with one byte telling whether it is a record in
+ * its home slot, a forwarding stub or a moved record.  Short home records
+ * are padded so that a stub always fits in their place.
+ *
+ * @warning This class is not threadsafe.
+ */
+class HeapFile {
+ public:
+  /**
+   * Opens a heap file, creating it if it does not exist.
+   *
+   * @param buf_mgr       Buffer manager through which pages are accessed.
+   * @param filename      Name of file.
+   * @param fill_factor   Fraction of a page, in (0, 1], which insertions may
+   *                      fill.
+   */
+  HeapFile(BufMgr* buf_mgr, const std::string& filename,
+           const double fill_factor = 1.0);
+
+  /**
+   * Writes the pages of the file and its free space map back and closes
+   * them.
+   */
+  ~HeapFile();
+
+  /**
+   * Inserts a record.
+   *
+   * @param record_data   Bytes of record.
+   * @return  ID of new record.
+   * @throws  InsufficientSpaceException  If the record is larger than a page.
+   */
+  RecordId insertRecord(const std::string& record_data);
+
+  /**
+   * Returns a record.
+   *
+   * @param record_id   ID of record.
+   * @return  Bytes of record.
+   * @throws  InvalidRecordException  If there is no record with the given ID.
+   */
+  std::string getRecord(const RecordId& record_id);
+
+  /**
+   * Replaces the contents of a record, moving it to another page if it no
+   * longer fits on its own.  The ID of the record does not change.
+   *
+   * @param record_id     ID of record.
+   * @param record_data   New bytes of record.
+   * @throws  InvalidRecordException      If there is no record with the given
+   *                                      ID.
+   * @throws  InsufficientSpaceException  If the record is larger than a page.
+   */
+  void updateRecord(const RecordId& record_id, const std::string& record_data);
+
+  /**
+   * Deletes a record.
+   *
+   * @param record_id   ID of record.
+   * @throws  InvalidRecordException  If there is no record with the given ID.
+   */
+  void deleteRecord(const RecordId& record_id);
+
+  /**
+   * Returns a scan over all records of the file.  The file must not be
+   * modified while the scan is in progress.
+   *
+   * @return  Scan positioned before the first record.
+   */
+  HeapFileScan scan();
+
+  /**
+   * Returns the file holding the records.
+   */
+  File& file() { return file_; }
+
+ private:
+  HeapFile(const HeapFile&);
+  HeapFile& operator=(const HeapFile&);
+
+  /**
+   * Opens the file with the given name, creating it if needed.
+   */
+  static File openOrCreate(const std::string& filename);
+
+  /**
+   * Stores an encoded record on a page with room for it, allocating a new
+   * page if there is none.
+   *
+   * @param stored  Encoded record.
+   * @return  ID of stored record.
+   */
+  RecordId insertStored(const std::string& stored);
+
+  /**
+   * Returns the bytes of a record which has been moved away from its home
+   * slot.
+   *
+   * @param target  ID of moved record.
+   */
+  std::string readMoved(const RecordId& target);
+
+  /**
+   * Buffer manager through which pages are accessed.
+   */
+  BufMgr* buf_mgr_;
+
+  /**
+   * File holding the records.
+   */
+  File file_;
+
+  /**
+   * Free space of the pages of file_.
+   */
+  FreeSpaceMap free_space_map_;
+
+  /**
+   * Number of bytes insertions leave free on every page.
+   */
+  std::size_t reserved_bytes_;
+
+  friend class HeapFileScan;
+};
+
+/**
+ * @brief Scan over the records of a HeapFile in page order.
+ *
+ * The page being scanned stays pinned until the scan moves past it or is
+ * destroyed.  Moved records are returned with the ID of their home slot.
+ */
+class HeapFileScan {
+ public:
+  /**
+   * Constructs a scan positioned before the first record of a file.
+   *
+   * @param heap_file   File to scan.
+   */
+  explicit HeapFileScan(HeapFile* heap_file);
+
+  /**
+   * Moves the scan, taking over the page it has pinned.
+   *
+   * @param other   Scan to move.
+   */
+  HeapFileScan(HeapFileScan&& other);
+
+  /**
+   * Unpins the page being scanned.
+   */
+  ~HeapFileScan();
+
+  /**
+   * Advances to the next record.
+   *
+   * @param record_id     Set to the ID of the record.
+   * @param record_data   Set to the bytes of the record.
+   * @return  False if there are no more records.
+   */
+  bool next(RecordId& record_id, std::string& record_data);
+
+ private:
+  HeapFileScan(const HeapFileScan&);
+  HeapFileScan& operator=(const HeapFileScan&);
+
+  /**
+   * Unpins the page being scanned, if any.
+   */
+  void releasePage();
+
+  /**
+   * File being scanned.
+   */
+  HeapFile* heap_file_;
+
+  /**
+   * Iterator at the page after the one being scanned.
+   */
+  FileIterator next_page_;
+
+  /**
+   * Page being scanned, pinned, or NULL between pages.
+   */
+  Page* page_;
+
+  /**
+   * Number of the page being scanned.
+   */
+  PageId page_number_;
+
+  /**
+   * Slot of the last record returned from the page being scanned.
+   */
+  SlotId slot_number_;
+};
+
+}
@@ -0,0 +1,180 @@
+/**
+ * @author See Contributors.txt for code contributors and overview of BadgerDB.
+ *
+ * @section LICENSE
+ * Copyright (c) 2012 Database Group, Computer Sciences Department, University of Wisconsin-Madison.
+ */
+
+#include "latency_backend.h"
+
+#include <algorithm>
+#include <cmath>
+#include <thread>
+
+namespace badgerdb {
+
+namespace {
+
+/**
+ * Waits this close to a deadline are spun rather than slept, since sleeps
+ * overshoot by tens of microseconds.
+ */
+const std::chrono::microseconds SPIN_THRESHOLD(100);
+
+/**
+ * Holds the calling thread until the given time.
+ */
+void waitUntil(const std::chrono::steady_clock::time_point deadline) {
+  const std::chrono::steady_clock::time_point now =
+      std::chrono::steady_clock::now();
+  if (deadline - now > SPIN_THRESHOLD) {
+    std::this_thread::sleep_for(deadline - now - SPIN_THRESHOLD);
+  }
+  while (std::chrono::steady_clock::now() < deadline) {
+  }
+}
+
+}
+
+LatencyProfile LatencyProfile::nvme() {
+  // Power-loss protection makes a cache flush nearly free.
+  LatencyProfile profile = {80, 0.3, 20, 0.5, 30, 0.5, 32, 0, 0, 0};
+  return profile;
+}
+
+LatencyProfile LatencyProfile::sataSsd() {
+  LatencyProfile profile = {180, 0.4, 60, 0.6, 1000, 0.6, 32, 0, 0, 0};
+  return profile;
+}
+
+LatencyProfile LatencyProfile::hdd() {
+  // Half a rotation at 7200 rpm, plus seeks of up to 8 ms; a sequential
+  // 8 KB transfer at 150 MB/s takes about 55 us.  Flushing the write cache
+  // takes a full rotation or more.
+  LatencyProfile profile = {4170, 0.4, 4170, 0.4, 8330, 0.4, 1, 55, 8000,
+                            std::uint64_t(1) << 36};
+  return profile;
+}
+
+bool LatencyProfile::byName(const std::string& name,
+                            LatencyProfile& profile) {
+  if (name == "nvme") {
+    profile = nvme();
+  } else if (name == "sata") {
+    profile = sataSsd();
+  } else if (name == "hdd") {
+    profile = hdd();
+  } else {
+    return false;
+  }
+  return true;
+}
+
+LatencyBackend::LatencyBackend(std::shared_ptr<FileBackend> backend,
+                               const LatencyProfile& profile,
+                               const std::uint64_t seed)
+    : backend_(backend),
+      profile_(profile),
+      rng_(seed),
+      read_time_(std::log(std::max(profile.read_median_us, 1e-3)),
+                 std::max(profile.read_sigma, 1e-9)),
+      write_time_(std::log(std::max(profile.write_median_us, 1e-3)),
+                  std::max(profile.write_sigma, 1e-9)),
+      sync_time_(std::log(std::max(profile.sync_median_us, 1e-3)),
+                 std::max(profile.sync_sigma, 1e-9)),
+      slot_free_(std::max<std::uint32_t>(profile.queue_depth, 1)),
+      next_offset_(0),
+      requests_(0),
+      delay_nanos_(0) {}
+
+BackendDecorator LatencyBackend::decorator(const LatencyProfile& profile) {
+  std::shared_ptr<std::uint64_t> files(new std::uint64_t(0));
+  return [profile, files](const std::string&,
+                          std::shared_ptr<FileBackend> backend) {
+    return std::shared_ptr<FileBackend>(
+        new LatencyBackend(backend, profile, ++*files));
+  };
+}
+
+LatencyBackend::Clock::time_point LatencyBackend::schedule(
+    const std::uint64_t offset, const std::size_t length,
+    const Request request) {
+  std::lock_guard<std::mutex> guard(mutex_);
+  double service_us;
+  if (request == REQUEST_SYNC) {
+    service_us = sync_time_(rng_);
+  } else if (profile_.sequential_us > 0 && offset == next_offset_) {
+    service_us = profile_.sequential_us;
+  } else {
+    service_us = request == REQUEST_WRITE ? write_time_(rng_)
+                                          : read_time_(rng_);
+    if (profile_.max_seek_us > 0) {
+      const double distance = offset > next_offset_ ? offset - next_offset_
+                                                    : next_offset_ - offset;
+      service_us += profile_.max_seek_us *
+          std::sqrt(std::min(1.0, distance / profile_.seek_span_bytes));
+    }
+  }
+  if (request != REQUEST_SYNC) {
+    next_offset_ = offset + length;
+  }
+
+  // The request takes the slot which frees up first.  A sync only starts
+  // once every request queued before it is done.
+  std::vector<Clock::time_point>::iterator slot =
+      std::min_element(slot_free_.begin(), slot_free_.end());
+  const Clock::time_point start = request == REQUEST_SYNC
+      ? *std::max_element(slot_free_.begin(), slot_free_.end())
+      : *slot;
+  const Clock::time_point now = Clock::now();
+  const Clock::time_point done =
+      std::max(now, start) +
+      std::chrono::nanoseconds(static_cast<std::int64_t>(service_us * 1000));
+  *slot = done;
+  ++requests_;
+  delay_nanos_ +=
+      std::chrono::duration_cast<std::chrono::nanoseconds>(done - now).count();
+  return done;
+}
+
+void LatencyBackend::read(const std::uint64_t offset, char* data,
+                          const std::size_t length) {
+  const Clock::time_point done = schedule(offset, length, REQUEST_READ);
+  backend_->read(offset, data, length);
+  waitUntil(done);
+}
+
+void LatencyBackend::write(const std::uint64_t offset, const char* data,
+                           const std::size_t length) {
+  const Clock::time_point done = schedule(offset, length, REQUEST_WRITE);
+  backend_->write(offset, data, length);
+  waitUntil(done);
+}
+
+void LatencyBackend::flush() {
+  backend_->flush();
+}
+
+void LatencyBackend::sync() {
+  const Clock::time_point done =
+      schedule(0 /* offset */, 0 /* length */, REQUEST_SYNC);
+  backend_->sync();
+  waitUntil(done);
+}
+
+void LatencyBackend::reserve(const std::uint64_t offset,
+                             const std::uint64_t length) {
+  backend_->reserve(offset, length);
+}
+
+std::uint64_t LatencyBackend::requests() const {
+  std::lock_guard<std::mutex> guard(mutex_);
+  return requests_;
+}
+
+std::uint64_t LatencyBackend::delayNanos() const {
+  std::lock_guard<std::mutex> guard(mutex_);
+  return delay_nanos_;
+}
+
+}
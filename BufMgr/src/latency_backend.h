@@ -0,0 +1,218 @@
+/**
+ * @author See Contributors.txt for code contributors and overview of BadgerDB.
+ *
+ * @section LICENSE
+ * Copyright (c) 2012 Database Group, Computer Sciences Department, University of Wisconsin-Madison.
+ */
+
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "file_backend.h"
+
+namespace badgerdb {
+
+/**
+ * @brief Timing model of a storage device.
+ *
+ * Each request has a service time drawn from a log-normal distribution with
+ * the given median and shape.  Devices with moving heads add a seek time
+ * growing with the square root of the distance from the previous request,
+ * and serve requests which continue where the previous one ended in
+ * sequential_us instead.  The device serves up to queue_depth requests at a
+ * time; further requests wait for a slot.  A sync waits for every request
+ * before it and then takes its own service time, drawn the same way, for the
+ * device to make its write cache durable.
+ */
+struct LatencyProfile {
+  /**
+   * Median service time of a read, in microseconds.
+   */
+  double read_median_us;
+
+  /**
+   * Shape (sigma of the underlying normal) of the read service time; 0 makes
+   * every read take exactly the median.
+   */
+  double read_sigma;
+
+  /**
+   * Median service time of a write, in microseconds.
+   */
+  double write_median_us;
+
+  /**
+   * Shape of the write service time.
+   */
+  double write_sigma;
+
+  /**
+   * Median service time of a sync, in microseconds.
+   */
+  double sync_median_us;
+
+  /**
+   * Shape of the sync service time.
+   */
+  double sync_sigma;
+
+  /**
+   * Number of requests the device serves concurrently.
+   */
+  std::uint32_t queue_depth;
+
+  /**
+   * Service time of a request starting where the previous one ended, in
+   * microseconds; 0 to treat such requests like any other.
+   */
+  double sequential_us;
+
+  /**
+   * Seek time across seek_span_bytes or more, in microseconds; 0 for devices
+   * without seeks.
+   */
+  double max_seek_us;
+
+  /**
+   * Distance at which seek time reaches max_seek_us.
+   */
+  std::uint64_t seek_span_bytes;
+
+  /**
+   * Returns a profile of a datacenter NVMe SSD.
+   */
+  static LatencyProfile nvme();
+
+  /**
+   * Returns a profile of a SATA SSD.
+   */
+  static LatencyProfile sataSsd();
+
+  /**
+   * Returns a profile of a 7200 rpm hard disk.
+   */
+  static LatencyProfile hdd();
+
+  /**
+   * Returns the profile with the given name: "nvme", "sata" or "hdd".
+   *
+   * @param name    Name of the profile.
+   * @param profile Set to the profile.
+   * @return  False if there is no profile with that name.
+   */
+  static bool byName(const std::string& name, LatencyProfile& profile);
+};
+
+/**
+ * @brief Backend decorator which makes every read and write take as long as
+ *        it would on an emulated storage device.
+ *
+ * Requests are passed to the wrapped backend, which may be on disk or in
+ * memory, and the caller is then held until the emulated device would have
+ * completed them.  Safe to use from several threads; concurrent requests
+ * compete for the device's queue slots.
+ */
+class LatencyBackend : public FileBackend {
+ public:
+  /**
+   * Wraps a backend.
+   *
+   * @param backend   Backend storing the data.
+   * @param profile   Timing model of the emulated device.
+   * @param seed      Seed of the service time distributions.
+   */
+  LatencyBackend(std::shared_ptr<FileBackend> backend,
+                 const LatencyProfile& profile, const std::uint64_t seed);
+
+  /**
+   * Returns a decorator for File::setBackendDecorator() which wraps every
+   * file opened in a LatencyBackend with the given profile.
+   *
+   * @param profile   Timing model of the emulated device.
+   */
+  static BackendDecorator decorator(const LatencyProfile& profile);
+
+  virtual void read(const std::uint64_t offset, char* data,
+                    const std::size_t length);
+  virtual void write(const std::uint64_t offset, const char* data,
+                     const std::size_t length);
+  /**
+   * Passes buffered writes on without delay; the emulated device served
+   * them when they were written.
+   */
+  virtual void flush();
+
+  /**
+   * Syncs the wrapped backend and holds the caller for the emulated sync.
+   */
+  virtual void sync();
+
+  /**
+   * Passes the reservation on without delay; it only changes metadata.
+   */
+  virtual void reserve(const std::uint64_t offset,
+                       const std::uint64_t length);
+
+  /**
+   * Returns the number of requests served.
+   */
+  std::uint64_t requests() const;
+
+  /**
+   * Returns the total time callers were held, in nanoseconds.
+   */
+  std::uint64_t delayNanos() const;
+
+ private:
+  typedef std::chrono::steady_clock Clock;
+
+  /**
+   * Kinds of request served by the emulated device.
+   */
+  enum Request {
+    REQUEST_READ,
+    REQUEST_WRITE,
+    REQUEST_SYNC
+  };
+
+  /**
+   * Reserves a queue slot for a request and returns when it completes.
+   * Syncs have no offset or length.
+   */
+  Clock::time_point schedule(const std::uint64_t offset,
+                             const std::size_t length, const Request request);
+
+  std::shared_ptr<FileBackend> backend_;
+  LatencyProfile profile_;
+
+  /**
+   * Protects everything below.
+   */
+  mutable std::mutex mutex_;
+  std::mt19937_64 rng_;
+  std::lognormal_distribution<double> read_time_;
+  std::lognormal_distribution<double> write_time_;
+  std::lognormal_distribution<double> sync_time_;
+
+  /**
+   * Time at which each queue slot becomes free.
+   */
+  std::vector<Clock::time_point> slot_free_;
+
+  /**
+   * Offset just past the end of the previous request.
+   */
+  std::uint64_t next_offset_;
+
+  std::uint64_t requests_;
+  std::uint64_t delay_nanos_;
+};
+
+}
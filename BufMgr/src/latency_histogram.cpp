@@ -0,0 +1,77 @@
+/**
+ * @author See Contributors.txt for code contributors and overview of BadgerDB.
+ *
+ * @section LICENSE
+ * Copyright (c) 2012 Database Group, Computer Sciences Department, University of Wisconsin-Madison.
+ */
+
+#include "latency_histogram.h"
+
+#include <cstring>
+
+#include "cycle_clock.h"
+
+namespace badgerdb {
+
+LatencyHistogram::LatencyHistogram() {
+  clear();
+}
+
+void LatencyHistogram::merge(const LatencyHistogram& other) {
+  for (int i = 0; i < NUM_BUCKETS; ++i) {
+    counts_[i] += other.counts_[i];
+  }
+  total_count_ += other.total_count_;
+  total_cycles_ += other.total_cycles_;
+  if (other.max_ > max_) {
+    max_ = other.max_;
+  }
+}
+
+void LatencyHistogram::clear() {
+  std::memset(counts_, 0, sizeof(counts_));
+  total_count_ = 0;
+  total_cycles_ = 0;
+  max_ = 0;
+}
+
+std::uint64_t LatencyHistogram::percentile(const double percentile) const {
+  if (total_count_ == 0) {
+    return 0;
+  }
+  // Rank of the value we are looking for, counting from 1.
+  std::uint64_t rank = static_cast<std::uint64_t>(percentile * total_count_ + 0.5);
+  if (rank < 1) {
+    rank = 1;
+  } else if (rank > total_count_) {
+    rank = total_count_;
+  }
+  std::uint64_t seen = 0;
+  for (int i = 0; i < NUM_BUCKETS; ++i) {
+    seen += counts_[i];
+    if (seen >= rank) {
+      const std::uint64_t upper = bucketUpperBound(i);
+      return upper < max_ ? upper : max_;
+    }
+  }
+  return max_;
+}
+
+double LatencyHistogram::percentileNanos(const double percentile) const {
+  return this->percentile(percentile) / cyclesPerNanosecond();
+}
+
+double LatencyHistogram::sumNanos() const {
+  return total_cycles_ / cyclesPerNanosecond();
+}
+
+std::uint64_t LatencyHistogram::bucketUpperBound(const int index) {
+  if (index < 2 * SUB_BUCKETS) {
+    return index;
+  }
+  const int shift = index / SUB_BUCKETS - 1;
+  const std::uint64_t sub_bucket = index % SUB_BUCKETS + SUB_BUCKETS;
+  return ((sub_bucket + 1) << shift) - 1;
+}
+
+}
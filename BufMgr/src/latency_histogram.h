@@ -0,0 +1,165 @@
+/**
+ * @author See Contributors.txt for code contributors and overview of BadgerDB.
+ *
+ * @section LICENSE
+ * Copyright (c) 2012 Database Group, Computer Sciences Department, University of Wisconsin-Madison.
+ */
+
+#pragma once
+
+#include <cstdint>
+
+namespace badgerdb {
+
+/**
+ * @brief Log-bucketed histogram of latencies measured in cycle counter ticks.
+ *
+ * Values are bucketed the way HDR histograms do it: every power of two is
+ * split into SUB_BUCKETS linear sub-buckets, so any recorded value is known to
+ * within 1/SUB_BUCKETS of itself while the whole 64-bit range fits in under a
+ * thousand counters.  Recording is a handful of integer instructions and never
+ * allocates.  Histograms recorded separately (for example, one per thread) can
+ * be combined with merge().
+ */
+class LatencyHistogram {
+ public:
+  /**
+   * log2 of the number of linear sub-buckets per power of two.
+   */
+  static const int SUB_BUCKET_BITS = 4;
+
+  /**
+   * Number of linear sub-buckets per power of two.
+   */
+  static const int SUB_BUCKETS = 1 << SUB_BUCKET_BITS;
+
+  /**
+   * Total number of buckets needed to cover 64-bit values.
+   */
+  static const int NUM_BUCKETS = (64 - SUB_BUCKET_BITS + 1) * SUB_BUCKETS;
+
+  /**
+   * Constructs an empty histogram.
+   */
+  LatencyHistogram();
+
+  /**
+   * Records one latency.
+   *
+   * @param cycles  Latency in cycle counter ticks.
+   */
+  void record(const std::uint64_t cycles) {
+    ++counts_[bucketIndex(cycles)];
+    ++total_count_;
+    total_cycles_ += cycles;
+    if (cycles > max_) {
+      max_ = cycles;
+    }
+  }
+
+  /**
+   * Adds all latencies recorded in another histogram to this one.
+   *
+   * @param other   Histogram to merge into this one.
+   */
+  void merge(const LatencyHistogram& other);
+
+  /**
+   * Discards all recorded latencies.
+   */
+  void clear();
+
+  /**
+   * Returns the number of latencies recorded.
+   *
+   * @return  Number of recorded latencies.
+   */
+  std::uint64_t count() const { return total_count_; }
+
+  /**
+   * Returns the largest latency recorded, in cycle counter ticks.
+   *
+   * @return  Largest recorded latency.
+   */
+  std::uint64_t max() const { return max_; }
+
+  /**
+   * Returns the sum of all latencies recorded, in cycle counter ticks.  Unlike
+   * percentiles, it is exact.
+   *
+   * @return  Sum of recorded latencies.
+   */
+  std::uint64_t sum() const { return total_cycles_; }
+
+  /**
+   * Same as sum(), but converted to nanoseconds.
+   *
+   * @return  Sum of recorded latencies in nanoseconds.
+   */
+  double sumNanos() const;
+
+  /**
+   * Returns the latency below which the given fraction of recorded latencies
+   * fall, in cycle counter ticks.  The result is the upper bound of the bucket
+   * holding that latency, so it overestimates by at most 1/SUB_BUCKETS.
+   *
+   * @param percentile  Fraction between 0 and 1, e.g. 0.99 for p99.
+   * @return  Latency at the percentile, or 0 if nothing has been recorded.
+   */
+  std::uint64_t percentile(const double percentile) const;
+
+  /**
+   * Same as percentile(), but converted to nanoseconds.
+   *
+   * @param percentile  Fraction between 0 and 1, e.g. 0.99 for p99.
+   * @return  Latency at the percentile in nanoseconds.
+   */
+  double percentileNanos(const double percentile) const;
+
+  /**
+   * Returns the bucket a value is recorded in.
+   *
+   * @param value   Value to bucket.
+   * @return  Index of bucket holding the value.
+   */
+  static int bucketIndex(const std::uint64_t value) {
+    if (value < 2 * SUB_BUCKETS) {
+      return static_cast<int>(value);
+    }
+    const int msb = 63 - __builtin_clzll(value);
+    const int shift = msb - SUB_BUCKET_BITS;
+    return (shift + 1) * SUB_BUCKETS +
+        static_cast<int>((value >> shift) - SUB_BUCKETS);
+  }
+
+  /**
+   * Returns the largest value recorded in the given bucket.
+   *
+   * @param index   Index of bucket.
+   * @return  Upper bound of the bucket.
+   */
+  static std::uint64_t bucketUpperBound(const int index);
+
+ private:
+  /**
+   * Number of latencies recorded in each bucket.
+   */
+  std::uint64_t counts_[NUM_BUCKETS];
+
+  /**
+   * Number of latencies recorded in all buckets.
+   */
+  std::uint64_t total_count_;
+
+  /**
+   * Sum of all latencies recorded.
+   */
+  std::uint64_t total_cycles_;
+
+  /**
+   * Largest latency recorded.
+   */
+  std::uint64_t max_;
+};
+
+}
@@ -0,0 +1,427 @@
+/**
+ * @author See Contributors.txt for code contributors and overview of BadgerDB.
+ *
+ * @section LICENSE
+ * Copyright (c) 2012 Database Group, Computer Sciences Department, University of Wisconsin-Madison.
+ */
+
+#include "log_manager.h"
+
+#include <algorithm>
+#include <cstddef>
+#include <cstring>
+#include <exception>
+#include <fcntl.h>
+#include <unistd.h>
+
+#include "crc32c.h"
+#include "exceptions/log_write_exception.h"
+
+namespace badgerdb {
+
+namespace {
+
+/**
+ * Header of a record in the log file, followed by its ranges, each an
+ * offset and length (two bytes each) and the bytes themselves.
+ */
+struct RecordHeader {
+  /**
+   * Size of the record, including this header.
+   */
+  std::uint32_t length;
+
+  /**
+   * CRC-32C of the record with this field zeroed.
+   */
+  std::uint32_t checksum;
+
+  Lsn lsn;
+  PageId page_number;
+  std::uint16_t num_ranges;
+
+  /**
+   * Combination of the RECORD_ flags.
+   */
+  std::uint16_t flags;
+};
+
+/**
+ * Set in RecordHeader::flags if the record holds a full image of the page.
+ */
+const std::uint16_t RECORD_FULL_IMAGE = 0x1;
+
+const std::size_t RANGE_HEADER_SIZE = 2 * sizeof(std::uint16_t);
+
+/**
+ * Unchanged bytes between two changed ones up to which they are logged as
+ * one range, as that takes less space than two ranges.
+ */
+const std::size_t MERGE_GAP = 8;
+
+/**
+ * Size of the part of the page header which describes the contents of the
+ * page and is logged.
+ */
+const std::size_t LOGGED_HEADER_SIZE = offsetof(PageHeader, current_page_number);
+
+bool writeFully(const int fd, std::uint64_t position, const char* data,
+                std::size_t length) {
+  while (length > 0) {
+    const ssize_t written = ::pwrite(fd, data, length, position);
+    if (written <= 0) {
+      return false;
+    }
+    data += written;
+    length -= written;
+    position += written;
+  }
+  return true;
+}
+
+bool readFully(const int fd, std::uint64_t position, char* data,
+               std::size_t length) {
+  while (length > 0) {
+    const ssize_t count = ::pread(fd, data, length, position);
+    if (count <= 0) {
+      return false;
+    }
+    data += count;
+    length -= count;
+    position += count;
+  }
+  return true;
+}
+
+/**
+ * Adds the ranges in which two byte strings differ.
+ *
+ * @param before  Old bytes.
+ * @param after   New bytes.
+ * @param length  Number of bytes.
+ * @param offset  Offset of the bytes in the page.
+ * @param ranges  Ranges of the page with their new bytes.
+ */
+void diffBytes(const char* before, const char* after, const std::size_t length,
+               const std::size_t offset,
+               std::vector<std::pair<std::uint16_t, std::string> >& ranges) {
+  std::size_t i = 0;
+  while (i < length) {
+    if (i + sizeof(std::uint64_t) <= length &&
+        std::memcmp(before + i, after + i, sizeof(std::uint64_t)) == 0) {
+      i += sizeof(std::uint64_t);
+      continue;
+    }
+    if (before[i] == after[i]) {
+      ++i;
+      continue;
+    }
+    std::size_t end = i + 1;
+    for (std::size_t j = end; j < length && j < end + MERGE_GAP; ++j) {
+      if (before[j] != after[j]) {
+        end = j + 1;
+      }
+    }
+    ranges.push_back(std::make_pair(static_cast<std::uint16_t>(offset + i),
+                                    std::string(after + i, end - i)));
+    i = end;
+  }
+}
+
+}
+
+const std::size_t LogManager::DEFAULT_BUFFER_SIZE;
+
+LogManager::LogManager(const std::string& filename, const bool create)
+    : filename_(filename),
+      fd_(::open(filename.c_str(),
+                 O_RDWR | O_CREAT | (create ? O_TRUNC : 0), 0644)),
+      base_lsn_(0),
+      buffer_lsn_(0),
+      end_lsn_(0),
+      durable_lsn_(0),
+      flushing_(false),
+      stats_() {
+  if (fd_ < 0) {
+    throw LogWriteException(filename_);
+  }
+  if (create || !readFully(fd_, 0 /* position */,
+                           reinterpret_cast<char*>(&base_lsn_),
+                           sizeof(base_lsn_))) {
+    base_lsn_ = 0;
+    if (!writeFully(fd_, 0 /* position */,
+                    reinterpret_cast<const char*>(&base_lsn_),
+                    sizeof(base_lsn_))) {
+      ::close(fd_);
+      throw LogWriteException(filename_);
+    }
+  }
+  // Find the end of the intact records and cut off anything after it, so
+  // that new records follow on directly.  The records are what recovery
+  // needs, so the log is not used at all if they cannot be kept apart from
+  // the torn tail.
+  std::uint64_t position = positionOf(base_lsn_);
+  LogRecord record;
+  std::size_t length;
+  while ((length = readRecord(position, record)) != 0) {
+    position += length;
+  }
+  if (::ftruncate(fd_, position) != 0) {
+    ::close(fd_);
+    throw LogWriteException(filename_);
+  }
+  end_lsn_ = base_lsn_ + (position - positionOf(base_lsn_));
+  buffer_lsn_ = end_lsn_;
+  durable_lsn_ = end_lsn_;
+}
+
+LogManager::~LogManager() {
+  if (fd_ >= 0) {
+    ::close(fd_);
+  }
+}
+
+Lsn LogManager::logPage(const Page& before, Page& page) {
+  std::vector<std::pair<std::uint16_t, std::string> > ranges;
+  diffBytes(reinterpret_cast<const char*>(&before.header_),
+            reinterpret_cast<const char*>(&page.header_), LOGGED_HEADER_SIZE,
+            0 /* offset */, ranges);
+  diffBytes(before.data_.data(), page.data_.data(), Page::DATA_SIZE,
+            sizeof(PageHeader), ranges);
+  if (ranges.empty()) {
+    return 0;
+  }
+  bool full_image;
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    full_image = imaged_.count(page.page_number()) == 0;
+  }
+  if (full_image) {
+    ranges.clear();
+    ranges.push_back(std::make_pair(
+        static_cast<std::uint16_t>(0),
+        std::string(reinterpret_cast<const char*>(&page.header_),
+                    LOGGED_HEADER_SIZE)));
+    ranges.push_back(std::make_pair(
+        static_cast<std::uint16_t>(sizeof(PageHeader)), page.data_));
+  }
+
+  std::size_t length = sizeof(RecordHeader);
+  for (std::size_t i = 0; i < ranges.size(); ++i) {
+    length += RANGE_HEADER_SIZE + ranges[i].second.length();
+  }
+  std::vector<char> bytes(length);
+  char* out = &bytes[sizeof(RecordHeader)];
+  for (std::size_t i = 0; i < ranges.size(); ++i) {
+    const std::uint16_t range_length =
+        static_cast<std::uint16_t>(ranges[i].second.length());
+    std::memcpy(out, &ranges[i].first, sizeof(std::uint16_t));
+    std::memcpy(out + sizeof(std::uint16_t), &range_length,
+                sizeof(std::uint16_t));
+    std::memcpy(out + RANGE_HEADER_SIZE, ranges[i].second.data(),
+                range_length);
+    out += RANGE_HEADER_SIZE + range_length;
+  }
+
+  Lsn lsn;
+  bool full;
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    lsn = end_lsn_ + length;
+    RecordHeader header = {static_cast<std::uint32_t>(length),
+                           0 /* checksum */, lsn, page.page_number(),
+                           static_cast<std::uint16_t>(ranges.size()),
+                           full_image ? RECORD_FULL_IMAGE : std::uint16_t(0)};
+    std::memcpy(&bytes[0], &header, sizeof(header));
+    header.checksum = crc32c(&bytes[0], length);
+    std::memcpy(&bytes[0], &header, sizeof(header));
+    buffer_.insert(buffer_.end(), bytes.begin(), bytes.end());
+    end_lsn_ = lsn;
+    if (full_image) {
+      imaged_.insert(page.page_number());
+    }
+    ++stats_.records;
+    stats_.bytes += length;
+    full = buffer_.size() >= DEFAULT_BUFFER_SIZE;
+  }
+  page.set_lsn(lsn);
+  if (full) {
+    flushTo(lsn);
+  }
+  return lsn;
+}
+
+void LogManager::flushTo(const Lsn lsn) {
+  std::unique_lock<std::mutex> lock(mutex_);
+  const Lsn target = std::min(lsn, end_lsn_);
+  while (durable_lsn_ < target) {
+    if (flushing_) {
+      // Whatever the flush in progress does not cover is written by the
+      // next one, together with the records of everyone else waiting.
+      flushed_.wait(lock);
+      continue;
+    }
+    flushing_ = true;
+    std::vector<char> batch;
+    batch.swap(buffer_);
+    const std::uint64_t position = positionOf(buffer_lsn_);
+    const Lsn batch_end = end_lsn_;
+    const Lsn batch_start = buffer_lsn_;
+    buffer_lsn_ = end_lsn_;
+    lock.unlock();
+    bool written = false;
+    std::exception_ptr error;
+    try {
+      if (before_flush_) {
+        before_flush_();
+      }
+      written = writeFully(fd_, position, batch.data(), batch.size()) &&
+                ::fdatasync(fd_) == 0;
+    } catch (...) {
+      error = std::current_exception();
+    }
+    lock.lock();
+    if (!written) {
+      // The records stay in the buffer, ahead of any appended meanwhile,
+      // so that a later flush writes them again; none of them is durable.
+      buffer_.insert(buffer_.begin(), batch.begin(), batch.end());
+      buffer_lsn_ = batch_start;
+      flushing_ = false;
+      flushed_.notify_all();
+      if (error) {
+        std::rethrow_exception(error);
+      }
+      throw LogWriteException(filename_);
+    }
+    durable_lsn_ = batch_end;
+    flushing_ = false;
+    ++stats_.syncs;
+    flushed_.notify_all();
+  }
+}
+
+void LogManager::commit() {
+  flushTo(endLsn());
+}
+
+void LogManager::startPage(const PageId page_number) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  imaged_.erase(page_number);
+}
+
+void LogManager::setBeforeFlush(const std::function<void()>& before_flush) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  before_flush_ = before_flush;
+}
+
+void LogManager::truncate() {
+  std::unique_lock<std::mutex> lock(mutex_);
+  while (flushing_) {
+    flushed_.wait(lock);
+  }
+  buffer_.clear();
+  imaged_.clear();
+  base_lsn_ = end_lsn_;
+  buffer_lsn_ = end_lsn_;
+  durable_lsn_ = end_lsn_;
+  if (!writeFully(fd_, 0 /* position */,
+                  reinterpret_cast<const char*>(&base_lsn_),
+                  sizeof(base_lsn_)) ||
+      ::ftruncate(fd_, sizeof(base_lsn_)) != 0 || ::fdatasync(fd_) != 0) {
+    throw LogWriteException(filename_);
+  }
+}
+
+void LogManager::forEachRecord(
+    const std::function<void(const LogRecord&)>& visit) const {
+  std::uint64_t position;
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    position = positionOf(base_lsn_);
+  }
+  LogRecord record;
+  std::size_t length;
+  while ((length = readRecord(position, record)) != 0) {
+    visit(record);
+    position += length;
+  }
+}
+
+Lsn LogManager::endLsn() const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  return end_lsn_;
+}
+
+Lsn LogManager::durableLsn() const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  return durable_lsn_;
+}
+
+LogStats LogManager::stats() const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  return stats_;
+}
+
+void LogManager::apply(const LogRecord& record, Page& page) {
+  for (std::size_t i = 0; i < record.ranges.size(); ++i) {
+    const std::uint16_t offset = record.ranges[i].first;
+    const std::string& bytes = record.ranges[i].second;
+    if (offset < sizeof(PageHeader)) {
+      std::memcpy(reinterpret_cast<char*>(&page.header_) + offset,
+                  bytes.data(), bytes.length());
+    } else {
+      page.data_.replace(offset - sizeof(PageHeader), bytes.length(), bytes);
+    }
+  }
+  page.set_lsn(record.lsn);
+}
+
+std::size_t LogManager::readRecord(const std::uint64_t position,
+                                   LogRecord& record) const {
+  RecordHeader header;
+  if (!readFully(fd_, position, reinterpret_cast<char*>(&header),
+                 sizeof(header)) ||
+      header.length < sizeof(header) || header.length > 4 * Page::SIZE) {
+    return 0;
+  }
+  std::vector<char> bytes(header.length);
+  if (!readFully(fd_, position, &bytes[0], header.length)) {
+    return 0;
+  }
+  std::memset(&bytes[offsetof(RecordHeader, checksum)], 0,
+              sizeof(header.checksum));
+  if (crc32c(&bytes[0], header.length) != header.checksum) {
+    return 0;
+  }
+  record.page_number = header.page_number;
+  record.lsn = header.lsn;
+  record.full_image = (header.flags & RECORD_FULL_IMAGE) != 0;
+  record.ranges.clear();
+  std::size_t at = sizeof(header);
+  for (std::uint16_t i = 0; i < header.num_ranges; ++i) {
+    std::uint16_t offset;
+    std::uint16_t length;
+    if (at + RANGE_HEADER_SIZE > header.length) {
+      return 0;
+    }
+    std::memcpy(&offset, &bytes[at], sizeof(offset));
+    std::memcpy(&length, &bytes[at + sizeof(offset)], sizeof(length));
+    at += RANGE_HEADER_SIZE;
+    // Ranges may only touch the logged part of the header or the data.
+    if (at + length > header.length || offset + length > Page::SIZE ||
+        (offset < sizeof(PageHeader) &&
+         offset + length > LOGGED_HEADER_SIZE)) {
+      return 0;
+    }
+    record.ranges.push_back(
+        std::make_pair(offset, std::string(&bytes[at], length)));
+    at += length;
+  }
+  return header.length;
+}
+
+std::uint64_t LogManager::positionOf(const Lsn lsn) const {
+  return sizeof(base_lsn_) + (lsn - base_lsn_);
+}
+
+}
@@ -0,0 +1,298 @@
+/**
+ * @author See Contributors.txt for code contributors and overview of BadgerDB.
+ *
+ * @section LICENSE
+ * Copyright (c) 2012 Database Group, Computer Sciences Department, University of Wisconsin-Madison.
+ */
+
+#pragma once
+
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <set>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "page.h"
+#include "types.h"
+
+namespace badgerdb {
+
+/**
+ * @brief Change to one page described by a write-ahead log record.
+ */
+struct LogRecord {
+  /**
+   * Number of the page changed.
+   */
+  PageId page_number;
+
+  /**
+   * LSN of the record.
+   */
+  Lsn lsn;
+
+  /**
+   * Changed byte ranges of the page as laid out on disk: the offset of each
+   * range and its new bytes.
+   */
+  std::vector<std::pair<std::uint16_t, std::string> > ranges;
+
+  /**
+   * Whether the ranges cover the whole logged part of the page, so that the
+   * record rebuilds the page whatever state it is in.
+   */
+  bool full_image;
+};
+
+/**
+ * @brief Counters of a write-ahead log.
+ */
+struct LogStats {
+  /**
+   * Number of records appended.
+   */
+  std::uint64_t records;
+
+  /**
+   * Number of bytes appended.
+   */
+  std::uint64_t bytes;
+
+  /**
+   * Number of times the log was written and synced to disk.
+   */
+  std::uint64_t syncs;
+};
+
+/**
+ * @brief Write-ahead log of the changes made to the pages of a file.
+ *
+ * Each record holds the byte ranges of one page which changed since the page
+ * was last logged, and the page is stamped with the LSN of the record.  The
+ * LSN of a record is the position in the log just past it, so a record is
+ * durable once the log is durable up to its LSN.
+ *
+ * Records are collected in a log buffer in memory and written out by
+ * flushTo() with one sequential write and one sync.  Callers which ask for a
+ * flush while another is in progress wait for it and then have their records
+ * written together by one of them, so concurrent commits share syncs (group
+ * commit).
+ *
+ * A page may only be written back to its file once the log is durable up to
+ * the page's LSN.  Replaying the records with a higher LSN than the page on
+ * disk brings the page up to date after a crash (see File).  Records only set
+ * bytes to new values, so replaying one twice does no harm.
+ *
+ * The first record of a page after the log was emptied, or after the page
+ * number started to be used for a new page, holds a full image of the page.
+ * Replaying the log can then rebuild a page which a crash tore while it was
+ * written back, starting from that image.
+ *
+ * The log is stored in a companion file named by filenameFor(), which starts
+ * with the LSN at which the records in it begin.  Once every page it describes
+ * has been written back, truncate() empties it.
+ */
+class LogManager {
+ public:
+  /**
+   * Default size of the log buffer; appending more records than fit forces
+   * the log.
+   */
+  static const std::size_t DEFAULT_BUFFER_SIZE = 1024 * 1024;
+
+  /**
+   * Returns the name of the companion file holding the log of a file.
+   *
+   * @param filename  Name of file the log describes.
+   * @return  Name of log file.
+   */
+  static std::string filenameFor(const std::string& filename) {
+    return filename + ".wal";
+  }
+
+  /**
+   * Opens the log of a file.
+   *
+   * @param filename  Name of file the log describes.
+   * @param create    Whether to start an empty log, discarding any log file
+   *                  already there.
+   * @throws  LogWriteException If the log file cannot be opened, or the end of
+   *                            its intact records cannot be set.
+   */
+  LogManager(const std::string& filename, const bool create);
+
+  /**
+   * Closes the log file.  Records not yet flushed are lost.
+   */
+  ~LogManager();
+
+  /**
+   * Appends a record of the bytes of a page which differ from an earlier
+   * image of it, and stamps the page with the LSN of the record.  Only the
+   * parts of the page header describing its contents are compared; the page
+   * number and links are kept up to date by the file itself.
+   *
+   * @param before  Page as last logged.
+   * @param page    Page as it is now.
+   * @return  LSN of the record, or 0 if nothing changed.
+   * @throws  LogWriteException If the record fills the log buffer and it
+   *                            cannot be flushed.
+   */
+  Lsn logPage(const Page& before, Page& page);
+
+  /**
+   * Makes the next record of a page hold a full image of it.  Call when the
+   * page number starts to be used for a new page.
+   *
+   * @param page_number   Number of page.
+   */
+  void startPage(const PageId page_number);
+
+  /**
+   * Makes the log durable up to the given LSN, writing out the log buffer
+   * and syncing the log file unless that has already happened.
+   *
+   * @param lsn   LSN which has to be durable.
+   * @throws  LogWriteException If the log file cannot be written or synced.
+   *                            The records stay buffered and not durable.
+   */
+  void flushTo(const Lsn lsn);
+
+  /**
+   * Makes every record appended so far durable.
+   *
+   * @throws  LogWriteException If the log file cannot be written or synced.
+   */
+  void commit();
+
+  /**
+   * Sets a function which is called before every write of records to the log
+   * file, to make durable whatever the records depend on, such as the file
+   * header counting the pages they describe.
+   *
+   * @param before_flush  Function to call, or an empty function for none.
+   */
+  void setBeforeFlush(const std::function<void()>& before_flush);
+
+  /**
+   * Empties the log.  Call only once every page the log describes has been
+   * written back durably.
+   *
+   * @throws  LogWriteException If the emptied log cannot be made durable.
+   */
+  void truncate();
+
+  /**
+   * Reads the records in the log file, oldest first.  A torn record at the
+   * end, left by a crash during a flush, ends the log.
+   *
+   * @param visit   Called with every record.
+   */
+  void forEachRecord(
+      const std::function<void(const LogRecord&)>& visit) const;
+
+  /**
+   * Returns the LSN of the end of the log.  Records appended so far have an
+   * LSN no higher than this and records appended later a higher one.
+   */
+  Lsn endLsn() const;
+
+  /**
+   * Returns the LSN up to which the log is durable.
+   */
+  Lsn durableLsn() const;
+
+  /**
+   * Returns the counters of the log since it was opened.
+   */
+  LogStats stats() const;
+
+  /**
+   * Applies the changes described by a record to a page and stamps the page
+   * with its LSN.
+   *
+   * @param record  Record to apply.
+   * @param page    Page the record describes.
+   */
+  static void apply(const LogRecord& record, Page& page);
+
+ private:
+  LogManager(const LogManager&);
+  LogManager& operator=(const LogManager&);
+
+  /**
+   * Reads the record at a position in the log file.
+   *
+   * @param position  Offset of record in log file.
+   * @param record    Set to the record.
+   * @return  Size of the record, or 0 if there is no intact record there.
+   */
+  std::size_t readRecord(const std::uint64_t position,
+                         LogRecord& record) const;
+
+  /**
+   * Returns the offset in the log file of the given LSN.
+   */
+  std::uint64_t positionOf(const Lsn lsn) const;
+
+  std::string filename_;
+  int fd_;
+
+  /**
+   * Protects everything below.
+   */
+  mutable std::mutex mutex_;
+
+  /**
+   * Signalled when a flush finishes.
+   */
+  std::condition_variable flushed_;
+
+  /**
+   * Records appended but not yet handed to a flush.
+   */
+  std::vector<char> buffer_;
+
+  /**
+   * LSN of the start of the log file, just after its header.
+   */
+  Lsn base_lsn_;
+
+  /**
+   * LSN at which buffer_ starts.
+   */
+  Lsn buffer_lsn_;
+
+  /**
+   * LSN of the end of the log.
+   */
+  Lsn end_lsn_;
+
+  /**
+   * LSN up to which the log is durable.
+   */
+  Lsn durable_lsn_;
+
+  /**
+   * Whether some caller is writing out the log.
+   */
+  bool flushing_;
+
+  /**
+   * Pages which have a full image in the log since it was last emptied.
+   */
+  std::set<PageId> imaged_;
+
+  /**
+   * Called by the flushing thread before it writes out records.
+   */
+  std::function<void()> before_flush_;
+
+  LogStats stats_;
+};
+
+}
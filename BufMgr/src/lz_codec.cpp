@@ -0,0 +1,194 @@
+/**
+ * @author See Contributors.txt for code contributors and overview of BadgerDB.
+ *
+ * @section LICENSE
+ * Copyright (c) 2012 Database Group, Computer Sciences Department, University of Wisconsin-Madison.
+ */
+
+#include "lz_codec.h"
+
+#include <cstdint>
+#include <cstring>
+#include <vector>
+
+namespace badgerdb {
+
+namespace {
+
+/**
+ * Shortest match worth encoding.
+ */
+const std::size_t MIN_MATCH = 4;
+
+/**
+ * Largest distance a match may be from the bytes it copies.
+ */
+const std::size_t MAX_OFFSET = 0xffff;
+
+const int HASH_BITS = 12;
+
+std::uint32_t load32(const unsigned char* bytes) {
+  std::uint32_t value;
+  std::memcpy(&value, bytes, sizeof(value));
+  return value;
+}
+
+std::uint32_t hash32(const std::uint32_t value) {
+  return (value * 2654435761u) >> (32 - HASH_BITS);
+}
+
+/**
+ * Number of bytes needed to encode a sequence, at most.
+ */
+std::size_t sequenceSize(const std::size_t literals,
+                         const std::size_t match_length) {
+  return 1 + literals / 255 + 1 + literals + 2 + match_length / 255 + 1;
+}
+
+unsigned char* putLength(unsigned char* out, std::size_t length) {
+  while (length >= 255) {
+    *out++ = 255;
+    length -= 255;
+  }
+  *out++ = static_cast<unsigned char>(length);
+  return out;
+}
+
+/**
+ * Writes a sequence.  A match length of 0 ends the output after the literals.
+ */
+unsigned char* putSequence(unsigned char* out, const unsigned char* literals,
+                           const std::size_t num_literals,
+                           const std::size_t offset,
+                           const std::size_t match_length) {
+  const std::size_t extra = match_length == 0 ? 0 : match_length - MIN_MATCH;
+  unsigned char* token = out++;
+  *token = static_cast<unsigned char>(
+      (num_literals < 15 ? num_literals : 15) << 4 | (extra < 15 ? extra : 15));
+  if (num_literals >= 15) {
+    out = putLength(out, num_literals - 15);
+  }
+  std::memcpy(out, literals, num_literals);
+  out += num_literals;
+  if (match_length == 0) {
+    return out;
+  }
+  *out++ = static_cast<unsigned char>(offset & 0xff);
+  *out++ = static_cast<unsigned char>(offset >> 8);
+  if (extra >= 15) {
+    out = putLength(out, extra - 15);
+  }
+  return out;
+}
+
+bool getLength(const unsigned char*& in, const unsigned char* in_end,
+               std::size_t& length) {
+  unsigned char byte;
+  do {
+    if (in == in_end) {
+      return false;
+    }
+    byte = *in++;
+    length += byte;
+  } while (byte == 255);
+  return true;
+}
+
+}
+
+std::size_t lzCompress(const char* src, const std::size_t length, char* dst,
+                       const std::size_t capacity) {
+  const unsigned char* in = reinterpret_cast<const unsigned char*>(src);
+  unsigned char* out = reinterpret_cast<unsigned char*>(dst);
+  unsigned char* const out_start = out;
+  // Positions are stored plus one so that 0 means no entry.
+  std::vector<std::uint32_t> table(std::size_t(1) << HASH_BITS, 0);
+  std::size_t pos = 0;
+  std::size_t anchor = 0;
+  while (pos + MIN_MATCH <= length) {
+    const std::uint32_t sequence = load32(in + pos);
+    std::uint32_t& entry = table[hash32(sequence)];
+    const std::size_t candidate = entry;
+    entry = static_cast<std::uint32_t>(pos + 1);
+    if (candidate == 0 || pos - (candidate - 1) > MAX_OFFSET ||
+        load32(in + candidate - 1) != sequence) {
+      ++pos;
+      continue;
+    }
+    const std::size_t match = candidate - 1;
+    std::size_t match_length = MIN_MATCH;
+    while (pos + match_length < length &&
+           in[match + match_length] == in[pos + match_length]) {
+      ++match_length;
+    }
+    const std::size_t literals = pos - anchor;
+    if (static_cast<std::size_t>(out - out_start) +
+            sequenceSize(literals, match_length) > capacity) {
+      return 0;
+    }
+    out = putSequence(out, in + anchor, literals, pos - match, match_length);
+    pos += match_length;
+    anchor = pos;
+  }
+  const std::size_t literals = length - anchor;
+  if (static_cast<std::size_t>(out - out_start) +
+          sequenceSize(literals, 0) > capacity) {
+    return 0;
+  }
+  out = putSequence(out, in + anchor, literals, 0, 0);
+  return out - out_start;
+}
+
+bool lzDecompress(const char* src, const std::size_t length, char* dst,
+                  const std::size_t dst_length) {
+  const unsigned char* in = reinterpret_cast<const unsigned char*>(src);
+  const unsigned char* const in_end = in + length;
+  unsigned char* out = reinterpret_cast<unsigned char*>(dst);
+  unsigned char* const out_start = out;
+  unsigned char* const out_end = out + dst_length;
+  while (in < in_end) {
+    const unsigned char token = *in++;
+    std::size_t literals = token >> 4;
+    if (literals == 15 && !getLength(in, in_end, literals)) {
+      return false;
+    }
+    if (literals > static_cast<std::size_t>(in_end - in) ||
+        literals > static_cast<std::size_t>(out_end - out)) {
+      return false;
+    }
+    std::memcpy(out, in, literals);
+    in += literals;
+    out += literals;
+    if (in == in_end) {
+      // The last sequence has no match.
+      break;
+    }
+    if (in_end - in < 2) {
+      return false;
+    }
+    const std::size_t offset = in[0] | (in[1] << 8);
+    in += 2;
+    std::size_t match_length = token & 0x0f;
+    if (match_length == 15 && !getLength(in, in_end, match_length)) {
+      return false;
+    }
+    match_length += MIN_MATCH;
+    if (offset == 0 || offset > static_cast<std::size_t>(out - out_start) ||
+        match_length > static_cast<std::size_t>(out_end - out)) {
+      return false;
+    }
+    const unsigned char* from = out - offset;
+    if (offset >= match_length) {
+      std::memcpy(out, from, match_length);
+      out += match_length;
+    } else {
+      // The match overlaps the bytes it produces, as in runs.
+      for (std::size_t i = 0; i < match_length; ++i) {
+        *out++ = *from++;
+      }
+    }
+  }
+  return out == out_end;
+}
+
+}
@@ -0,0 +1,43 @@
+/**
+ * @author See Contributors.txt for code contributors and overview of BadgerDB.
+ *
+ * @section LICENSE
+ * Copyright (c) 2012 Database Group, Computer Sciences Department, University of Wisconsin-Madison.
+ */
+
+#pragma once
+
+#include <cstddef>
+
+namespace badgerdb {
+
+/**
+ * Compresses a buffer with a byte-oriented LZ77 codec in the style of LZ4.
+ * The input is encoded as a series of sequences, each a run of literal bytes
+ * followed by a copy of earlier output.  Matches are found greedily with a
+ * hash table of four byte prefixes, which is fast and does well on runs of
+ * zeros and repeated text, the common contents of pages.
+ *
+ * @param src       Bytes to compress.
+ * @param length    Number of bytes to compress.
+ * @param dst       Buffer the compressed bytes are written to.
+ * @param capacity  Size of dst.
+ * @return  Number of compressed bytes, or 0 if they would not fit in dst.
+ */
+std::size_t lzCompress(const char* src, const std::size_t length, char* dst,
+                       const std::size_t capacity);
+
+/**
+ * Decompresses bytes produced by lzCompress().
+ *
+ * @param src         Compressed bytes.
+ * @param length      Number of compressed bytes.
+ * @param dst         Buffer the original bytes are written to.
+ * @param dst_length  Number of original bytes.
+ * @return  False if the compressed bytes are malformed or do not decompress
+ *          to exactly dst_length bytes.
+ */
+bool lzDecompress(const char* src, const std::size_t length, char* dst,
+                  const std::size_t dst_length);
+
+}
@@ -3,20 +3,38 @@
  * @studentid 9075109588
  */
 
+#include <algorithm>
+#include <fstream>
 #include <iostream>
 #include <stdlib.h>
 //#include <stdio.h>
 #include <cstring>
 #include <memory>
+#include <new>
+#include <vector>
+#include <csignal>
+#include <sys/resource.h>
+#include <sys/wait.h>
+#include <unistd.h>
 #include "page.h"
+#include "crc32c.h"
 #include "buffer.h"
+#include "metrics_exporter.h"
+#include "latency_backend.h"
+#include "compressed_backend.h"
 #include "file_iterator.h"
+#include "free_space_map.h"
+#include "heap_file.h"
 #include "page_iterator.h"
 #include "exceptions/file_not_found_exception.h"
+#include "exceptions/insufficient_space_exception.h"
 #include "exceptions/invalid_page_exception.h"
+#include "exceptions/invalid_record_exception.h"
 #include "exceptions/page_not_pinned_exception.h"
 #include "exceptions/page_pinned_exception.h"
 #include "exceptions/buffer_exceeded_exception.h"
+#include "exceptions/checksum_mismatch_exception.h"
+#include "exceptions/log_write_exception.h"
 
 #define PRINT_ERROR(str) \
 { \
@@ -41,6 +59,28 @@ void test3();
 void test4();
 void test5();
 void test6();
+void test7();
+void test8();
+void test9();
+void test10();
+void test11();
+void test12();
+void test13();
+void test14();
+void test15();
+void test16();
+void test17();
+void test18();
+void test19();
+void test20();
+void test21();
+void test22();
+void test23();
+void test24();
+void test25();
+void test26();
+void test27();
+void test28();
 void testBufMgr();
 
 int main()
@@ -82,13 +122,15 @@ int main()
              iter != new_file.end();
              ++iter)
         {
+            // Keep a copy of the page alive while iterating over its records.
+            Page curr_page = *iter;
             // Iterate through all records on the page.
-            for (PageIterator page_iter = (*iter).begin();
-                 page_iter != (*iter).end();
+            for (PageIterator page_iter = curr_page.begin();
+                 page_iter != curr_page.end();
                  ++page_iter)
             {
                 std::cout << "Found record: " << *page_iter
-                          << " on page " << (*iter).page_number() << "\n";
+                          << " on page " << curr_page.page_number() << "\n";
             }
         }
 
@@ -158,6 +200,32 @@ void testBufMgr()
 	test4();
 	test5();
 	test6();
+	test7();
+	test8();
+	test9();
+	test10();
+	test11();
+	test12();
+	test13();
+	test14();
+	test15();
+	test16();
+	test17();
+	test18();
+	test19();
+	test20();
+	test21();
+	test22();
+	test23();
+	test24();
+	test25();
+	test26();
+	test27();
+	test28();
+
+	//Destroy the buffer manager while the files are still open, so that
+	//the dirty pages it writes back have somewhere to go
+	delete bufMgr;
 
 	//Close files before deleting them
 	file1.~File();
@@ -173,8 +241,6 @@ void testBufMgr()
 	File::remove(filename4);
 	File::remove(filename5);
 
-	delete bufMgr;
-
 	std::cout << "\n" << "Passed all tests." << "\n";
 }
 
@@ -331,3 +397,1641 @@ void test6()
 
 	bufMgr->flushFile(file1ptr);
 }
+
+void test7()
+{
+	//Dumping the buffer pool and warming up a new buffer manager from the dump
+	const std::string& dumpname = "test.dump";
+	for (i = 1; i <= num; i++)
+	{
+		bufMgr->readPage(file1ptr, i, page);
+		bufMgr->unPinPage(file1ptr, i, false);
+	}
+	bufMgr->dumpPool(dumpname);
+
+	BufMgr* restoredBufMgr = new BufMgr(num);
+	std::vector<File*> files;
+	files.push_back(file1ptr);
+	files.push_back(file2ptr);
+	files.push_back(file3ptr);
+	if (restoredBufMgr->loadPoolDump(dumpname, files) != num)
+	{
+		PRINT_ERROR("ERROR :: All pages of file1 should have been queued for restore.");
+	}
+	if (restoredBufMgr->restorePool(num) != num || restoredBufMgr->isRestorePending())
+	{
+		PRINT_ERROR("ERROR :: All queued pages should have been restored.");
+	}
+
+	for (i = 1; i <= num; i++)
+	{
+		restoredBufMgr->readPage(file1ptr, i, page);
+		sprintf((char*)&tmpbuf, "test.1 Page %d %7.1f", i, (float)i);
+		if(strncmp(page->getRecord({i, 1}).c_str(), tmpbuf, strlen(tmpbuf)) != 0)
+		{
+			PRINT_ERROR("ERROR :: CONTENTS DID NOT MATCH");
+		}
+		restoredBufMgr->unPinPage(file1ptr, i, false);
+	}
+
+	delete restoredBufMgr;
+	std::remove(dumpname.c_str());
+
+	//Pages damaged since the dump was taken are skipped when restoring, here by damaging the record of the second page
+	const std::string& filename = "test.6";
+	const int pages = 4;
+	PageId pageIds[pages];
+	{
+		File file = File::create(filename);
+		BufMgr dumpedMgr(pages);
+		for (int j = 0; j < pages; j++)
+		{
+			dumpedMgr.allocPage(&file, pageIds[j], page);
+			page->insertRecord("test.7 restored");
+			dumpedMgr.unPinPage(&file, pageIds[j], true);
+		}
+		dumpedMgr.dumpPool(dumpname);
+		dumpedMgr.flushFile(&file);
+	}
+	{
+		std::fstream onDisk(filename.c_str(), std::ios::in | std::ios::out | std::ios::binary);
+		onDisk.seekp(sizeof(FileHeader) + pageIds[1] * Page::SIZE - 1);
+		onDisk.put('#');
+	}
+	{
+		File file = File::open(filename);
+		BufMgr warmedMgr(pages);
+		files.assign(1, &file);
+		warmedMgr.loadPoolDump(dumpname, files);
+		if (warmedMgr.restorePool(pages) != pages - 1 || warmedMgr.isRestorePending() ||
+			file.stats().page_reads != static_cast<std::uint64_t>(pages))
+		{
+			PRINT_ERROR("ERROR :: Damaged page was not skipped while restoring.");
+		}
+	}
+	File::remove(filename);
+	std::remove(dumpname.c_str());
+
+	//A periodic dump is written a slice of frames per access, and only replaces the last dump once complete
+	{
+		File file = File::create(filename);
+		BufMgr dumpingMgr(BufMgr::POOL_DUMP_SLICE + 1);
+		dumpingMgr.setPoolDump(dumpname, 2);
+		for (int j = 0; j < 2; j++)
+		{
+			dumpingMgr.allocPage(&file, pageIds[j], page);
+			dumpingMgr.unPinPage(&file, pageIds[j], true);
+		}
+		dumpingMgr.readPage(&file, pageIds[0], page);
+		dumpingMgr.unPinPage(&file, pageIds[0], false);
+		std::ifstream partial(dumpname.c_str());
+		if (partial)
+		{
+			PRINT_ERROR("ERROR :: Periodic dump was written before all its slices were.");
+		}
+		dumpingMgr.readPage(&file, pageIds[1], page);
+		dumpingMgr.unPinPage(&file, pageIds[1], false);
+		std::ifstream complete(dumpname.c_str());
+		std::string line;
+		int lines = 0;
+		while (std::getline(complete, line))
+		{
+			lines++;
+		}
+		if (lines != 2)
+		{
+			PRINT_ERROR("ERROR :: Periodic dump does not hold every resident page.");
+		}
+		dumpingMgr.setPoolDump("", 0);
+		dumpingMgr.flushFile(&file);
+	}
+	File::remove(filename);
+	std::remove(dumpname.c_str());
+
+	std::cout << "Test 7 passed" << "\n";
+}
+
+void test8()
+{
+	//Statistics should account for every hit, miss and eviction
+	for (i = 1; i <= num; i++)
+	{
+		bufMgr->readPage(file1ptr, i, page);
+		bufMgr->unPinPage(file1ptr, i, false);
+	}
+	const BufStats before = bufMgr->snapshotBufStats();
+
+	//All pages of file1 are resident, so these are hits
+	for (i = 1; i <= num; i++)
+	{
+		bufMgr->readPage(file1ptr, i, page);
+		bufMgr->unPinPage(file1ptr, i, true);
+	}
+
+	//Reading file5 replaces every page of file1, which are all dirty
+	for (i = 1; i <= num; i++)
+	{
+		bufMgr->readPage(file5ptr, i, page);
+		bufMgr->unPinPage(file5ptr, i, false);
+	}
+
+	const BufStats delta = bufMgr->snapshotBufStats().delta(before);
+	if (delta.accesses != 2 * num || delta.hits != num || delta.misses != num)
+	{
+		PRINT_ERROR("ERROR :: Accesses, hits and misses do not add up.");
+	}
+	if (delta.dirtyEvictions != num || delta.evictionWrites != num || delta.cleanEvictions != 0)
+	{
+		PRINT_ERROR("ERROR :: Every page of file1 should have been written back on eviction.");
+	}
+
+	std::cout << "Test 8 passed" << "\n";
+}
+
+void test9()
+{
+	//Latencies are recorded per operation once tracking is enabled
+	bufMgr->setLatencyTracking(true);
+	for (i = 1; i <= num; i++)
+	{
+		bufMgr->readPage(file5ptr, i, page);
+		bufMgr->unPinPage(file5ptr, i, false);
+	}
+	bufMgr->setLatencyTracking(false);
+
+	const LatencyHistogram& hits = bufMgr->getLatencyHistogram(READ_HIT);
+	if (hits.count() != num || bufMgr->getLatencyHistogram(UNPIN).count() != num)
+	{
+		PRINT_ERROR("ERROR :: Every read and unpin should have been recorded.");
+	}
+	if (bufMgr->getLatencyHistogram(READ_MISS).count() != 0)
+	{
+		PRINT_ERROR("ERROR :: No read should have missed.");
+	}
+
+	LatencyHistogram merged;
+	merged.merge(hits);
+	merged.merge(hits);
+	if (merged.count() != 2 * num || merged.percentile(0.999) != hits.percentile(0.999) ||
+		bufMgr->latencyPercentile(READ_HIT, 0.5) > bufMgr->latencyPercentile(READ_HIT, 0.99))
+	{
+		PRINT_ERROR("ERROR :: Percentiles are inconsistent.");
+	}
+	bufMgr->clearLatencyHistograms();
+
+	std::cout << "Test 9 passed" << "\n";
+}
+
+void test10()
+{
+	//Exported metrics are labeled per pool and per file
+	MetricsExporter exporter("test", bufMgr);
+	const std::string& text = exporter.renderPrometheus();
+	if (text.find("# TYPE badgerdb_buffer_hits_total counter") == std::string::npos ||
+		text.find("badgerdb_buffer_hits_total{pool=\"test\"}") == std::string::npos)
+	{
+		PRINT_ERROR("ERROR :: Buffer pool metrics are missing.");
+	}
+	if (text.find("badgerdb_buffer_file_resident_pages{pool=\"test\",file=\"test.5\"} 3") == std::string::npos ||
+		text.find("badgerdb_file_page_reads_total{file=\"test.5\"}") == std::string::npos)
+	{
+		PRINT_ERROR("ERROR :: Per-file metrics are missing.");
+	}
+
+	const std::string& json = exporter.renderJson();
+	if (json.find("{\"name\":\"badgerdb_buffer_frames\",\"type\":\"gauge\",\"labels\":{\"pool\":\"test\"},\"value\":3}") == std::string::npos)
+	{
+		PRINT_ERROR("ERROR :: JSON metrics are missing.");
+	}
+
+	std::cout << "Test 10 passed" << "\n";
+}
+
+void test11()
+{
+	//Every buffer call is recorded in the trace and can be read back
+	const std::string& tracename = "test.trace";
+	{
+		AccessTracer tracer(tracename, 4);
+		bufMgr->setAccessTracer(&tracer);
+		for (i = 1; i <= num; i++)
+		{
+			bufMgr->readPage(file5ptr, i, page);
+			bufMgr->unPinPage(file5ptr, i, true);
+		}
+		bufMgr->readPage(file1ptr, 1, page);
+		bufMgr->unPinPage(file1ptr, 1, false);
+		bufMgr->setAccessTracer(NULL);
+	}
+
+	AccessTraceReader reader(tracename);
+	TraceEvent event;
+	int reads = 0, hits = 0, dirtyUnpins = 0, file1Events = 0;
+	while (reader.next(event))
+	{
+		if (event.record.op == TRACE_READ)
+		{
+			reads++;
+			if (event.record.flags & TRACE_HIT)
+				hits++;
+		}
+		else if (event.record.op == TRACE_UNPIN && (event.record.flags & TRACE_DIRTY))
+		{
+			dirtyUnpins++;
+		}
+		if (event.filename == "test.2" && event.record.page == 1)
+			file1Events++;
+	}
+	if (reads != num + 1 || hits != num || dirtyUnpins != num || file1Events != 2)
+	{
+		PRINT_ERROR("ERROR :: Trace does not match the buffer calls made.");
+	}
+
+	//A thread switching between tracers keeps one ring in each, and a file at the address of a closed one
+	//is traced under its own name
+	const std::string& othername = "test.trace2";
+	{
+		AccessTracer tracer(tracename, 4);
+		AccessTracer other(othername, 4);
+		tracer.record(TRACE_READ, file1ptr, 1, 0);
+		other.record(TRACE_READ, file1ptr, 1, 0);
+		tracer.record(TRACE_READ, file1ptr, 2, 0);
+		alignas(File) char storage[sizeof(File)];
+		File* reused = new (storage) File(File::open(file1ptr->filename()));
+		tracer.record(TRACE_READ, reused, 3, 0);
+		reused->~File();
+		reused = new (storage) File(File::open(file5ptr->filename()));
+		tracer.record(TRACE_READ, reused, 4, 0);
+		reused->~File();
+		//New files each get a number of their own, wherever their File objects live
+		reused = new (storage) File(File::create("test.trb"));
+		tracer.record(TRACE_READ, reused, 5, 0);
+		reused->~File();
+		reused = new (storage) File(File::create("test.trd"));
+		tracer.record(TRACE_READ, reused, 6, 0);
+		reused->~File();
+		File newer = File::create("test.tre");
+		tracer.record(TRACE_READ, &newer, 7, 0);
+	}
+	File::remove("test.trb");
+	File::remove("test.trd");
+	File::remove("test.tre");
+	const std::string tracedNames[] = {"", file1ptr->filename(), file1ptr->filename(), file1ptr->filename(),
+		file5ptr->filename(), "test.trb", "test.trd", "test.tre"};
+	AccessTraceReader switched(tracename);
+	int events = 0;
+	while (switched.next(event))
+	{
+		events++;
+		if (event.record.thread != 0 || event.record.page < 1 || event.record.page > 7 ||
+			event.filename != tracedNames[event.record.page])
+		{
+			PRINT_ERROR("ERROR :: Event traced in the wrong ring or under the wrong file.");
+		}
+	}
+	if (events != 7)
+	{
+		PRINT_ERROR("ERROR :: Events of a thread switching between tracers were lost.");
+	}
+	std::remove(tracename.c_str());
+	std::remove(othername.c_str());
+
+	std::cout << "Test 11 passed" << "\n";
+}
+
+void test12()
+{
+	//A loop over num pages hits in an LRU pool of num frames and never in a smaller one
+	bufMgr->enableMrcEstimation(1.0);
+	for (int pass = 0; pass < 3; pass++)
+	{
+		for (i = 1; i <= num; i++)
+		{
+			bufMgr->readPage(file5ptr, i, page);
+			bufMgr->unPinPage(file5ptr, i, false);
+		}
+	}
+	const double expected = 2.0 / 3.0;
+	if (bufMgr->predictedHitRatio(num) < expected - 1e-9 || bufMgr->predictedHitRatio(num) > expected + 1e-9
+		|| bufMgr->predictedHitRatio(num - 1) != 0.0 || bufMgr->getMrcEstimator()->trackedPages() != num)
+	{
+		PRINT_ERROR("ERROR :: Predicted hit ratios do not match the access pattern.");
+	}
+	bufMgr->enableMrcEstimation(0.0);
+
+	std::cout << "Test 12 passed" << "\n";
+}
+
+void test13()
+{
+	//Every read and write of a file opened with a latency decorator is held for the emulated service time
+	const std::string& filename = "test.6";
+	try
+	{
+		File::remove(filename);
+	}
+	catch (FileNotFoundException)
+	{
+	}
+
+	const LatencyProfile profile = {200, 0, 100, 0, 300, 0, 1, 0, 0, 0};
+	std::shared_ptr<LatencyBackend> device;
+	File::setBackendDecorator([&device, &profile](const std::string&, std::shared_ptr<FileBackend> backend)
+	{
+		device.reset(new LatencyBackend(backend, profile, 1));
+		return std::shared_ptr<FileBackend>(device);
+	});
+	{
+		File file = File::create(filename);
+		File::setBackendDecorator(BackendDecorator());
+		const PageId pageNo = file.allocatePage().page_number();
+		if (file.readPage(pageNo).page_number() != pageNo)
+		{
+			PRINT_ERROR("ERROR :: Page read through the latency decorator does not match the page written.");
+		}
+	}
+	//create writes the header; allocatePage writes the page; readPage reads the page; closing the file writes the
+	//header; syncs are charged too
+	device->sync();
+	if (device->requests() != 5 || device->delayNanos() < 0.99 * (3 * 100000 + 200000 + 300000))
+	{
+		PRINT_ERROR("ERROR :: Emulated device did not delay every request.");
+	}
+	File::remove(filename);
+
+	std::cout << "Test 13 passed" << "\n";
+}
+
+void test14()
+{
+	//An in-memory file keeps its pages across close and open without ever being created on disk
+	const std::string& filename = "test.7";
+	{
+		File file = File::create(filename, true);
+		for (i = 0; i < num; i++)
+		{
+			bufMgr->allocPage(&file, pid[i], page);
+			sprintf((char*)tmpbuf, "test.7 Page %d %7.1f", pid[i], (float)pid[i]);
+			rid[i] = page->insertRecord(tmpbuf);
+			bufMgr->unPinPage(&file, pid[i], true);
+		}
+		bufMgr->flushFile(&file);
+	}
+	std::ifstream onDisk(filename.c_str());
+	if (onDisk || !File::exists(filename) || File::isOpen(filename))
+	{
+		PRINT_ERROR("ERROR :: In-memory file should exist, be closed and not be on disk.");
+	}
+
+	{
+		File file = File::open(filename);
+		PageId pagesFound = 0;
+		for (FileIterator iter = file.begin(); iter != file.end(); ++iter)
+		{
+			Page currPage = *iter;
+			sprintf((char*)tmpbuf, "test.7 Page %d %7.1f", pid[pagesFound], (float)pid[pagesFound]);
+			if (currPage.page_number() != pid[pagesFound]
+				|| strncmp(currPage.getRecord(rid[pagesFound]).c_str(), tmpbuf, strlen(tmpbuf)) != 0)
+			{
+				PRINT_ERROR("ERROR :: Contents of in-memory page do not match.");
+			}
+			pagesFound++;
+		}
+		if (pagesFound != num)
+		{
+			PRINT_ERROR("ERROR :: In-memory file lost pages.");
+		}
+	}
+	File::remove(filename);
+	if (File::exists(filename))
+	{
+		PRINT_ERROR("ERROR :: In-memory file still exists after being removed.");
+	}
+
+	std::cout << "Test 14 passed" << "\n";
+}
+
+void test15()
+{
+	//Allocation appends at the cached tail of the used list, so its cost does not grow with the file
+	const std::string& filename = "test.8";
+	try
+	{
+		File::remove(filename);
+	}
+	catch (FileNotFoundException)
+	{
+	}
+
+	{
+		File file = File::create(filename);
+		const int pages = 200;
+		for (int j = 0; j < pages; j++)
+		{
+			file.allocatePage();
+		}
+		if (file.stats().page_reads != 0 || file.stats().page_header_reads != 0 || file.stats().header_reads != 0)
+		{
+			PRINT_ERROR("ERROR :: Allocating a page walked the used list.");
+		}
+
+		//Delete the tail and a page in the middle; both are reused and appended at the tail again
+		file.deletePage(pages);
+		file.deletePage(10);
+		const PageId reused1 = file.allocatePage().page_number();
+		const PageId reused2 = file.allocatePage().page_number();
+		if (reused1 != 10 || reused2 != pages)
+		{
+			PRINT_ERROR("ERROR :: Deleted pages were not reused.");
+		}
+
+		PageId pagesFound = 0;
+		PageId last = Page::INVALID_NUMBER;
+		for (FileIterator iter = file.begin(); iter != file.end(); ++iter)
+		{
+			last = (*iter).page_number();
+			pagesFound++;
+		}
+		if (pagesFound != pages || last != reused2)
+		{
+			PRINT_ERROR("ERROR :: Used list is broken after reusing pages.");
+		}
+	}
+
+	//The tail is kept in the file header, so it survives reopening the file
+	{
+		File file = File::open(filename);
+		const PageId appended = file.allocatePage().page_number();
+		PageId last = Page::INVALID_NUMBER;
+		for (FileIterator iter = file.begin(); iter != file.end(); ++iter)
+		{
+			last = (*iter).page_number();
+		}
+		if (last != appended)
+		{
+			PRINT_ERROR("ERROR :: Page allocated after reopening the file is not at the tail.");
+		}
+	}
+	File::remove(filename);
+
+	std::cout << "Test 15 passed" << "\n";
+}
+
+void test16()
+{
+	//Deleting a page unlinks it through its neighbours instead of walking the used list
+	const std::string& filename = "test.8";
+	try
+	{
+		File::remove(filename);
+	}
+	catch (FileNotFoundException)
+	{
+	}
+
+	{
+		File file = File::create(filename);
+		const int pages = 200;
+		for (int j = 0; j < pages; j++)
+		{
+			file.allocatePage();
+		}
+
+		//Delete the head, the tail and a page in the middle
+		const std::uint64_t headerReads = file.stats().page_header_reads;
+		file.deletePage(1);
+		file.deletePage(pages);
+		file.deletePage(100);
+		if (file.stats().page_reads != 0 || file.stats().page_header_reads - headerReads > 3 * 3)
+		{
+			PRINT_ERROR("ERROR :: Deleting a page walked the used list.");
+		}
+
+		try
+		{
+			file.deletePage(100);
+			PRINT_ERROR("ERROR :: Deleting a free page should throw an exception.");
+		}
+		catch (InvalidPageException e)
+		{
+		}
+
+		PageId pagesFound = 0;
+		PageId expected = 2;
+		for (FileIterator iter = file.begin(); iter != file.end(); ++iter)
+		{
+			if ((*iter).page_number() != expected)
+			{
+				PRINT_ERROR("ERROR :: Used list is broken after deleting pages.");
+			}
+			expected += expected == 99 ? 2 : 1;
+			pagesFound++;
+		}
+		if (pagesFound != pages - 3)
+		{
+			PRINT_ERROR("ERROR :: Used list lost pages after deleting pages.");
+		}
+
+		//Deleted pages are reused and appended after the new tail
+		file.allocatePage();
+		file.deletePage(file.allocatePage().page_number());
+		PageId last = Page::INVALID_NUMBER;
+		for (FileIterator iter = file.begin(); iter != file.end(); ++iter)
+		{
+			last = (*iter).page_number();
+		}
+		if (last != 100)
+		{
+			PRINT_ERROR("ERROR :: Used list tail is wrong after reusing pages.");
+		}
+	}
+	File::remove(filename);
+
+	std::cout << "Test 16 passed" << "\n";
+}
+
+void test17()
+{
+	//A file in the space map format tracks its pages in a bitmap instead of linked lists
+	const std::string& filename = "test.8";
+	try
+	{
+		File::remove(filename);
+	}
+	catch (FileNotFoundException)
+	{
+	}
+
+	const int pages = 200;
+	{
+		File file = File::create(filename, false, FORMAT_SPACE_MAP);
+		for (int j = 0; j < pages; j++)
+		{
+			file.allocatePage();
+		}
+		file.deletePage(50);
+		file.deletePage(20);
+		try
+		{
+			file.readPage(20);
+			PRINT_ERROR("ERROR :: Reading a deleted page should throw an exception.");
+		}
+		catch (InvalidPageException e)
+		{
+		}
+		//The lowest numbered free page is reused first
+		if (file.allocatePage().page_number() != 20)
+		{
+			PRINT_ERROR("ERROR :: Space map did not reuse the lowest free page.");
+		}
+		if (file.stats().page_reads != 0 || file.stats().page_header_reads != 0)
+		{
+			PRINT_ERROR("ERROR :: Space map file read pages to allocate or delete.");
+		}
+	}
+
+	{
+		File file = File::open(filename);
+		//Pages are iterated in page number order and map pages are skipped
+		PageId pagesFound = 0;
+		PageId previous = Page::INVALID_NUMBER;
+		for (FileIterator iter = file.begin(); iter != file.end(); ++iter)
+		{
+			const PageId pageNo = (*iter).page_number();
+			if (pageNo <= previous || pageNo == 50)
+			{
+				PRINT_ERROR("ERROR :: Space map iteration is out of order or returned a free page.");
+			}
+			previous = pageNo;
+			pagesFound++;
+		}
+		if (pagesFound != pages - 1)
+		{
+			PRINT_ERROR("ERROR :: Space map lost pages across reopening the file.");
+		}
+		if (file.allocatePage().page_number() != 50)
+		{
+			PRINT_ERROR("ERROR :: Space map was not reloaded when the file was opened.");
+		}
+	}
+	File::remove(filename);
+
+	std::cout << "Test 17 passed" << "\n";
+}
+
+void test18()
+{
+	//The free space map finds the lowest page with enough room and keeps its categories in a companion file
+	const std::string& filename = "test.8";
+	const std::string mapFilename = FreeSpaceMap::filenameFor(filename);
+	try
+	{
+		File::remove(mapFilename);
+	}
+	catch (FileNotFoundException)
+	{
+	}
+
+	{
+		FreeSpaceMap fsm(bufMgr, filename);
+		if (fsm.findPage(1) != Page::INVALID_NUMBER)
+		{
+			PRINT_ERROR("ERROR :: Empty free space map found a page.");
+		}
+		fsm.update(3, 100);
+		fsm.update(5, 8000);
+		//Far enough to be stored on the second page of the map
+		fsm.update(9000, 4000);
+		if (fsm.findPage(50) != 3 || fsm.findPage(200) != 5 || fsm.findPage(8100) != Page::INVALID_NUMBER)
+		{
+			PRINT_ERROR("ERROR :: Free space map did not find the lowest page with enough space.");
+		}
+		fsm.update(5, 0);
+		if (fsm.findPage(200) != 9000 || fsm.freeSpace(3) > 100 || fsm.freeSpace(3) + FreeSpaceMap::GRANULE <= 100)
+		{
+			PRINT_ERROR("ERROR :: Free space map did not track an update.");
+		}
+	}
+
+	{
+		FreeSpaceMap fsm(bufMgr, filename);
+		if (fsm.findPage(200) != 9000 || fsm.findPage(50) != 3 || fsm.freeSpace(5) != 0)
+		{
+			PRINT_ERROR("ERROR :: Free space map was not persisted.");
+		}
+	}
+	File::remove(mapFilename);
+
+	std::cout << "Test 18 passed" << "\n";
+}
+
+void test19()
+{
+	//Records in a heap file go through the buffer pool and keep their ids when they outgrow their page
+	const std::string& filename = "test.8";
+	const int records = 200;
+	std::vector<RecordId> rids;
+	{
+		HeapFile heap(bufMgr, filename);
+		for (int j = 0; j < records; j++)
+		{
+			//Long enough to spread the records over two pages, leaving the first one full
+			sprintf((char*)tmpbuf, "test.8 record %d ........................................", j);
+			rids.push_back(heap.insertRecord(tmpbuf));
+		}
+		//Grow a record past what its full page can hold, then again past where it was moved
+		const std::string big(3000, 'b');
+		const std::string bigger(6000, 'c');
+		heap.updateRecord(rids[0], big);
+		if (heap.getRecord(rids[0]) != big)
+		{
+			PRINT_ERROR("ERROR :: Relocated heap record does not match.");
+		}
+		heap.updateRecord(rids[0], bigger);
+		//A moved record which cannot grow any more stays as it was
+		try
+		{
+			heap.updateRecord(rids[0], std::string(Page::SIZE + 1, 'd'));
+			PRINT_ERROR("ERROR :: Expected InsufficientSpaceException was not thrown.");
+		}
+		catch (InsufficientSpaceException e)
+		{
+		}
+		heap.updateRecord(rids[1], "x");
+		heap.deleteRecord(rids[2]);
+		if (heap.getRecord(rids[0]) != bigger || heap.getRecord(rids[1]) != "x")
+		{
+			PRINT_ERROR("ERROR :: Updated heap record does not match.");
+		}
+		try
+		{
+			heap.getRecord(rids[2]);
+			PRINT_ERROR("ERROR :: Reading a deleted heap record should throw an exception.");
+		}
+		catch (InvalidRecordException e)
+		{
+		}
+	}
+
+	{
+		HeapFile heap(bufMgr, filename);
+		int recordsFound = 0;
+		RecordId rid;
+		std::string record;
+		HeapFileScan scan = heap.scan();
+		while (scan.next(rid, record))
+		{
+			int j = 0;
+			while (j < records && rids[j] != rid)
+			{
+				j++;
+			}
+			sprintf((char*)tmpbuf, "test.8 record %d ........................................", j);
+			if (j == records || j == 2 || (j > 1 && record != tmpbuf) || (j == 0 && record.length() != 6000))
+			{
+				PRINT_ERROR("ERROR :: Heap scan returned a wrong record.");
+			}
+			recordsFound++;
+		}
+		if (recordsFound != records - 1)
+		{
+			PRINT_ERROR("ERROR :: Heap scan did not return every record once.");
+		}
+	}
+	File::remove(filename);
+	File::remove(FreeSpaceMap::filenameFor(filename));
+
+	//A lower fill factor spreads the same records over more pages
+	PageId pagesUsed[2];
+	const double fillFactors[2] = {1.0, 0.5};
+	for (int k = 0; k < 2; k++)
+	{
+		{
+			HeapFile heap(bufMgr, filename, fillFactors[k]);
+			for (int j = 0; j < records; j++)
+			{
+				heap.insertRecord(std::string(200, 'f'));
+			}
+			pagesUsed[k] = 0;
+			for (FileIterator iter = heap.file().begin(); iter != heap.file().end(); ++iter)
+			{
+				pagesUsed[k]++;
+			}
+		}
+		File::remove(filename);
+		File::remove(FreeSpaceMap::filenameFor(filename));
+	}
+	if (pagesUsed[1] < 2 * pagesUsed[0] - 1)
+	{
+		PRINT_ERROR("ERROR :: Fill factor was not applied to heap inserts.");
+	}
+
+	std::cout << "Test 19 passed" << "\n";
+}
+
+void test20()
+{
+	//The file header is kept in memory and only written back on sync, checkpoint and close
+	const std::string& filename = "test.8";
+	const int pages = 50;
+	{
+		File file = File::create(filename);
+		const std::uint64_t headerWrites = file.stats().header_writes;
+		for (int j = 0; j < pages; j++)
+		{
+			file.readPage(file.allocatePage().page_number());
+		}
+		if (file.stats().header_writes != headerWrites || file.stats().header_reads != 0)
+		{
+			PRINT_ERROR("ERROR :: File header was read or written while allocating and reading pages.");
+		}
+		file.sync();
+		file.sync();
+		if (file.stats().header_writes != headerWrites + 1)
+		{
+			PRINT_ERROR("ERROR :: Sync did not write the changed file header exactly once.");
+		}
+
+		bufMgr->allocPage(&file, pid[0], page);
+		bufMgr->unPinPage(&file, pid[0], true);
+		bufMgr->checkpoint();
+		if (file.stats().header_writes != headerWrites + 2)
+		{
+			PRINT_ERROR("ERROR :: Checkpoint did not write the file header.");
+		}
+		bufMgr->flushFile(&file);
+	}
+
+	//The header written when the file was closed has every page
+	{
+		File file = File::open(filename);
+		PageId pagesFound = 0;
+		for (FileIterator iter = file.begin(); iter != file.end(); ++iter)
+		{
+			pagesFound++;
+		}
+		if (pagesFound != pages + 1)
+		{
+			PRINT_ERROR("ERROR :: File header was not written back when the file was closed.");
+		}
+	}
+	File::remove(filename);
+
+	std::cout << "Test 20 passed" << "\n";
+}
+
+void test21()
+{
+	//Writing back a page uses the links the file already knows instead of reading its header first
+	const std::string& filename = "test.8";
+	{
+		File file = File::create(filename);
+		for (i = 0; i < num; i++)
+		{
+			bufMgr->allocPage(&file, pid[i], page);
+			bufMgr->unPinPage(&file, pid[i], true);
+		}
+		bufMgr->flushFile(&file);
+		for (i = 0; i < num; i++)
+		{
+			bufMgr->readPage(&file, pid[i], page);
+			sprintf((char*)tmpbuf, "test.8 Page %d %7.1f", pid[i], (float)pid[i]);
+			rid[i] = page->insertRecord(tmpbuf);
+			bufMgr->unPinPage(&file, pid[i], true);
+		}
+		bufMgr->flushFile(&file);
+		if (file.stats().page_header_reads != 0)
+		{
+			PRINT_ERROR("ERROR :: Writing back a page read its header from disk.");
+		}
+
+		//A copy of a page deleted since it was read can no longer be written
+		Page stale = file.readPage(pid[1]);
+		file.deletePage(pid[1]);
+		try
+		{
+			file.writePage(stale);
+			PRINT_ERROR("ERROR :: Writing a deleted page should throw an exception.");
+		}
+		catch (InvalidPageException e)
+		{
+		}
+		PageId pagesFound = 0;
+		for (FileIterator iter = file.begin(); iter != file.end(); ++iter)
+		{
+			Page currPage = *iter;
+			pagesFound++;
+			if (currPage.page_number() == pid[1] || currPage.getRecord(rid[pagesFound == 1 ? 0 : 2]).find("test.8 Page") != 0)
+			{
+				PRINT_ERROR("ERROR :: Pages written back lost their contents or links.");
+			}
+		}
+		if (pagesFound != num - 1)
+		{
+			PRINT_ERROR("ERROR :: Used list is broken after writing back pages.");
+		}
+	}
+	File::remove(filename);
+
+	std::cout << "Test 21 passed" << "\n";
+}
+
+void test22()
+{
+	//Files grow by whole extents which are reserved on disk before pages are handed out from them
+	const std::string& filename = "test.8";
+	const PageId extentPages = 16;
+	const int pages = 40;
+	File::setExtentSize(extentPages * Page::SIZE);
+	{
+		File file = File::create(filename);
+		for (int j = 0; j < pages; j++)
+		{
+			file.allocatePage();
+		}
+		if (file.stats().extents_reserved != (pages + extentPages - 1) / extentPages)
+		{
+			PRINT_ERROR("ERROR :: File did not grow by whole extents.");
+		}
+	}
+	File::setExtentSize(File::DEFAULT_EXTENT_SIZE);
+
+	//The last extent is reserved on disk past the last page written
+	std::ifstream onDisk(filename.c_str(), std::ios::binary | std::ios::ate);
+	const std::streamoff size = onDisk.tellg();
+	onDisk.close();
+	if (size < static_cast<std::streamoff>(sizeof(FileHeader) + 3 * extentPages * Page::SIZE))
+	{
+		PRINT_ERROR("ERROR :: Extent was not reserved on disk.");
+	}
+
+	//Pages are handed out from the reserved extent after reopening the file
+	{
+		File file = File::open(filename);
+		file.allocatePage();
+		if (file.stats().extents_reserved != 0)
+		{
+			PRINT_ERROR("ERROR :: Reserved extent was lost when the file was closed.");
+		}
+	}
+	File::remove(filename);
+
+	std::cout << "Test 22 passed" << "\n";
+}
+
+void test23()
+{
+	//More files than the open stream limit can be used at once; streams are reopened on demand
+	const std::string filenames[] = {"test.8", "test.9", "test.10", "test.11"};
+	const int numFiles = 4;
+	const int pages = 3;
+	StreamBackend::setOpenLimit(2);
+	{
+		std::vector<File> files;
+		for (int j = 0; j < numFiles; j++)
+		{
+			files.push_back(File::create(filenames[j]));
+		}
+		for (int k = 0; k < pages; k++)
+		{
+			for (int j = 0; j < numFiles; j++)
+			{
+				Page page = files[j].allocatePage();
+				sprintf((char*)tmpbuf, "test.23 file %d page %d", j, k);
+				page.insertRecord(tmpbuf);
+				files[j].writePage(page);
+				if (StreamBackend::openStreams() > 2)
+				{
+					PRINT_ERROR("ERROR :: More streams open than the limit allows.");
+				}
+			}
+		}
+		for (int j = 0; j < numFiles; j++)
+		{
+			int k = 0;
+			for (FileIterator iter = files[j].begin(); iter != files[j].end(); ++iter, k++)
+			{
+				Page page = *iter;
+				sprintf((char*)tmpbuf, "test.23 file %d page %d", j, k);
+				if (strncmp((*page.begin()).c_str(), tmpbuf, strlen(tmpbuf)) != 0)
+				{
+					PRINT_ERROR("ERROR :: Contents of a reopened file are wrong.");
+				}
+			}
+			if (k != pages)
+			{
+				PRINT_ERROR("ERROR :: Pages of a reopened file were lost.");
+			}
+		}
+	}
+	StreamBackend::setOpenLimit(StreamBackend::DEFAULT_OPEN_LIMIT);
+	for (int j = 0; j < numFiles; j++)
+	{
+		File::remove(filenames[j]);
+	}
+
+	std::cout << "Test 23 passed" << "\n";
+}
+
+void test24()
+{
+	//Pages carry a checksum which is verified when they are read back through the buffer manager
+	const std::string& filename = "test.8";
+	{
+		File file = File::create(filename);
+		for (i = 0; i < 3; i++)
+		{
+			bufMgr->allocPage(&file, pid[i], page);
+			sprintf((char*)tmpbuf, "test.24 Page %d", pid[i]);
+			rid[i] = page->insertRecord(tmpbuf);
+			bufMgr->unPinPage(&file, pid[i], true);
+		}
+		bufMgr->flushFile(&file);
+		//Deleting a page updates the links of its neighbours in place, which the checksum does not cover
+		file.deletePage(pid[1]);
+	}
+
+	//Damage the last byte of the first page, where its record is stored
+	{
+		std::fstream onDisk(filename.c_str(), std::ios::in | std::ios::out | std::ios::binary);
+		onDisk.seekp(sizeof(FileHeader) + pid[0] * Page::SIZE - 1);
+		onDisk.put('#');
+	}
+
+	{
+		File file = File::open(filename);
+		bufMgr->readPage(&file, pid[2], page);
+		bufMgr->unPinPage(&file, pid[2], false);
+		try
+		{
+			bufMgr->readPage(&file, pid[0], page);
+			PRINT_ERROR("ERROR :: Damaged page was read without an exception.");
+		}
+		catch (ChecksumMismatchException e)
+		{
+		}
+
+		//Without verification the damaged page is returned as it is
+		File::setChecksumVerification(false);
+		bufMgr->readPage(&file, pid[0], page);
+		bufMgr->unPinPage(&file, pid[0], false);
+		File::setChecksumVerification(true);
+		bufMgr->flushFile(&file);
+	}
+	File::remove(filename);
+
+	std::cout << "Test 24 passed" << "\n";
+}
+
+void test25()
+{
+	//Compressed files store the same pages in far fewer bytes
+	const std::string filenames[] = {"test.8", "test.9"};
+	const std::uint32_t formats[] = {FORMAT_DEFAULT, FORMAT_COMPRESSED};
+	const int pages = 20;
+	std::streamoff sizes[2];
+	for (int j = 0; j < 2; j++)
+	{
+		{
+			File file = File::create(filenames[j], false, formats[j]);
+			for (i = 0; i < pages; i++)
+			{
+				Page newPage = file.allocatePage();
+				sprintf((char*)tmpbuf, "test.25 Page %d %7.1f", newPage.page_number(), (float)newPage.page_number());
+				newPage.insertRecord(tmpbuf);
+				file.writePage(newPage);
+			}
+			//Deleting a page rewrites the links of its neighbours in place
+			file.deletePage(pages / 2);
+		}
+		std::ifstream onDisk(filenames[j].c_str(), std::ios::binary | std::ios::ate);
+		sizes[j] = onDisk.tellg();
+	}
+	if (sizes[1] * 8 > static_cast<std::streamoff>(pages * Page::SIZE))
+	{
+		PRINT_ERROR("ERROR :: Pages were not compressed.");
+	}
+
+	//The slots of the pages are found again when the file is reopened
+	{
+		File file = File::open(filenames[1]);
+		int numPages = 0;
+		for (FileIterator iter = file.begin(); iter != file.end(); ++iter)
+		{
+			Page curPage = *iter;
+			sprintf((char*)tmpbuf, "test.25 Page %d %7.1f", curPage.page_number(), (float)curPage.page_number());
+			if (strncmp((*curPage.begin()).c_str(), tmpbuf, strlen(tmpbuf)) != 0)
+			{
+				PRINT_ERROR("ERROR :: Contents of a compressed page are wrong.");
+			}
+			numPages++;
+		}
+		if (numPages != pages - 1)
+		{
+			PRINT_ERROR("ERROR :: Pages of a compressed file were lost.");
+		}
+	}
+	for (int j = 0; j < 2; j++)
+	{
+		File::remove(filenames[j]);
+	}
+
+	//A damaged slot header loses only its own block, which reads as damaged rather than as never written
+	const std::uint64_t prefix = 16;
+	const std::size_t blockSize = 4096;
+	const std::uint64_t firstUnit = prefix + sizeof(std::uint64_t);
+	std::vector<char> block(blockSize);
+	std::shared_ptr<FileBackend> storage(new MemoryBackend());
+	{
+		CompressedBackend compressed(storage, prefix, blockSize, true);
+		for (int j = 0; j < 3; j++)
+		{
+			std::fill(block.begin(), block.end(), 'a' + j);
+			compressed.write(prefix + j * blockSize, &block[0], blockSize);
+		}
+	}
+	storage->write(firstUnit + CompressedBackend::SLOT_UNIT, std::string(8, 'x').data(), 8);
+	{
+		CompressedBackend compressed(storage, prefix, blockSize, false);
+		for (int j = 0; j < 3; j++)
+		{
+			compressed.read(prefix + j * blockSize, &block[0], blockSize);
+			if (std::count(block.begin(), block.end(), j == 1 ? '\xff' : 'a' + j) != static_cast<int>(blockSize))
+			{
+				PRINT_ERROR("ERROR :: Blocks around a damaged slot header were read back wrong.");
+			}
+		}
+	}
+
+	//A rewrite goes to a new slot, so a crash which tears it leaves the old copy
+	storage.reset(new MemoryBackend());
+	char oldHeader[CompressedBackend::SLOT_UNIT];
+	{
+		CompressedBackend compressed(storage, prefix, blockSize, true);
+		std::fill(block.begin(), block.end(), 'a');
+		compressed.write(prefix, &block[0], blockSize);
+		storage->read(firstUnit, oldHeader, sizeof(oldHeader));
+		std::fill(block.begin(), block.end(), 'b');
+		compressed.write(prefix, &block[0], blockSize);
+	}
+	const char expected[] = {'b', 'a'};
+	for (int j = 0; j < 2; j++)
+	{
+		//The crash came before the old slot was marked free, and the second time during the new write
+		storage->write(firstUnit, oldHeader, sizeof(oldHeader));
+		if (j == 1)
+		{
+			//Just past the six fields of the slot header
+			storage->write(firstUnit + CompressedBackend::SLOT_UNIT + 6 * sizeof(std::uint32_t),
+				std::string(4, 'x').data(), 4);
+		}
+		CompressedBackend compressed(storage, prefix, blockSize, false);
+		compressed.read(prefix, &block[0], blockSize);
+		if (std::count(block.begin(), block.end(), expected[j]) != static_cast<int>(blockSize))
+		{
+			PRINT_ERROR("ERROR :: Wrong copy of a block left in two slots by a crash.");
+		}
+	}
+
+	std::cout << "Test 25 passed" << "\n";
+}
+
+void test26()
+{
+	//Changes to the pages of a logged file survive a crash once they are committed, without writing the pages
+	const std::string& filename = "test.8";
+	const int pages = 5;
+	PageId pageIds[pages];
+	RecordId recordIds[pages];
+	//Simulate a crash: a child process exits without its buffer manager writing the pages back, and hands
+	//the ids of what it wrote over a pipe
+	int ids[2];
+	if (pipe(ids) != 0)
+	{
+		PRINT_ERROR("ERROR :: Could not create a pipe.");
+	}
+	pid_t crashed = fork();
+	if (crashed == 0)
+	{
+		BufMgr crashedMgr(3);
+		{
+			File file = File::create(filename, false, FORMAT_LOGGED);
+			for (i = 0; i < pages; i++)
+			{
+				crashedMgr.allocPage(&file, pageIds[i], page);
+				sprintf((char*)tmpbuf, "test.26 Page %d %7.1f", pageIds[i], (float)pageIds[i]);
+				recordIds[i] = page->insertRecord(tmpbuf);
+				crashedMgr.unPinPage(&file, pageIds[i], true);
+			}
+			//Dirty pages evicted to make room for the others forced the log first
+			if (file.log()->stats().syncs == 0 || file.log()->durableLsn() == 0)
+			{
+				_exit(1);
+			}
+			file.log()->commit();
+			if (file.log()->durableLsn() != file.log()->endLsn() || file.log()->stats().records != pages)
+			{
+				_exit(2);
+			}
+		}
+		const bool handed = write(ids[1], pageIds, sizeof(pageIds)) == sizeof(pageIds) &&
+			write(ids[1], recordIds, sizeof(recordIds)) == sizeof(recordIds);
+		_exit(handed ? 0 : 3);
+	}
+	int status;
+	if (crashed < 0 || waitpid(crashed, &status, 0) != crashed || !WIFEXITED(status))
+	{
+		PRINT_ERROR("ERROR :: Crashing process did not run.");
+	}
+	if (WEXITSTATUS(status) == 1)
+	{
+		PRINT_ERROR("ERROR :: Page was written back before its log records.");
+	}
+	if (WEXITSTATUS(status) != 0 || read(ids[0], pageIds, sizeof(pageIds)) != sizeof(pageIds) ||
+		read(ids[0], recordIds, sizeof(recordIds)) != sizeof(recordIds))
+	{
+		PRINT_ERROR("ERROR :: Commit did not make the log durable.");
+	}
+
+	//Opening the file replays the log onto the pages which were never written back
+	{
+		File file = File::open(filename);
+		if (file.stats().pages_recovered != 3)
+		{
+			PRINT_ERROR("ERROR :: Wrong number of pages recovered from the log.");
+		}
+		for (i = 0; i < pages; i++)
+		{
+			bufMgr->readPage(&file, pageIds[i], page);
+			sprintf((char*)tmpbuf, "test.26 Page %d %7.1f", pageIds[i], (float)pageIds[i]);
+			if (strncmp(page->getRecord(recordIds[i]).c_str(), tmpbuf, strlen(tmpbuf)) != 0)
+			{
+				PRINT_ERROR("ERROR :: Committed change was lost in the crash.");
+			}
+			bufMgr->unPinPage(&file, pageIds[i], false);
+		}
+		//Once the pages are written back the log is emptied
+		bufMgr->flushFile(&file);
+	}
+	std::ifstream log(LogManager::filenameFor(filename).c_str(), std::ios::binary | std::ios::ate);
+	if (log.tellg() != static_cast<std::streamoff>(sizeof(Lsn)))
+	{
+		PRINT_ERROR("ERROR :: Log was not emptied by flushFile().");
+	}
+	log.close();
+	File::remove(filename);
+
+	//A page torn by the crash is rebuilt from the full image of it which its first change after the last
+	//checkpoint logged
+	PageId tornPageNo;
+	RecordId tornRecordId;
+	crashed = fork();
+	if (crashed == 0)
+	{
+		BufMgr crashedMgr(3);
+		{
+			File file = File::create(filename, false, FORMAT_LOGGED);
+			bufMgr->allocPage(&file, tornPageNo, page);
+			page->insertRecord("test.26 checkpointed");
+			bufMgr->unPinPage(&file, tornPageNo, true);
+			bufMgr->flushFile(&file);
+			crashedMgr.readPage(&file, tornPageNo, page);
+			tornRecordId = page->insertRecord("test.26 after checkpoint");
+			crashedMgr.unPinPage(&file, tornPageNo, true);
+			file.log()->commit();
+		}
+		const bool handed = write(ids[1], &tornPageNo, sizeof(tornPageNo)) == sizeof(tornPageNo) &&
+			write(ids[1], &tornRecordId, sizeof(tornRecordId)) == sizeof(tornRecordId);
+		_exit(handed ? 0 : 3);
+	}
+	if (crashed < 0 || waitpid(crashed, &status, 0) != crashed || !WIFEXITED(status) ||
+		WEXITSTATUS(status) != 0 || read(ids[0], &tornPageNo, sizeof(tornPageNo)) != sizeof(tornPageNo) ||
+		read(ids[0], &tornRecordId, sizeof(tornRecordId)) != sizeof(tornRecordId))
+	{
+		PRINT_ERROR("ERROR :: Crashing process did not run.");
+	}
+	close(ids[0]);
+	close(ids[1]);
+	{
+		std::fstream onDisk(filename.c_str(), std::ios::in | std::ios::out | std::ios::binary);
+		onDisk.seekp(sizeof(FileHeader) + (tornPageNo - 1) * Page::SIZE + Page::SIZE / 2);
+		onDisk.write(std::string(Page::SIZE / 2, 'x').data(), Page::SIZE / 2);
+	}
+	{
+		File file = File::open(filename);
+		if (file.stats().pages_recovered != 1)
+		{
+			PRINT_ERROR("ERROR :: Torn page was not rebuilt from the log.");
+		}
+		bufMgr->readPage(&file, tornPageNo, page);
+		if (page->getRecord(tornRecordId) != "test.26 after checkpoint")
+		{
+			PRINT_ERROR("ERROR :: Contents of a rebuilt page are wrong.");
+		}
+		bufMgr->unPinPage(&file, tornPageNo, false);
+		bufMgr->flushFile(&file);
+	}
+	File::remove(filename);
+
+	//A page allocated and committed just before the process dies is recovered, although the header
+	//was never written back on close
+	const pid_t child = fork();
+	if (child == 0)
+	{
+		File file = File::create(filename, false, FORMAT_LOGGED);
+		BufMgr childMgr(3);
+		PageId newPageNo;
+		childMgr.allocPage(&file, newPageNo, page);
+		page->insertRecord("test.26 committed");
+		childMgr.unPinPage(&file, newPageNo, true);
+		file.log()->commit();
+		_exit(0);
+	}
+	if (child < 0 || waitpid(child, &status, 0) != child || !WIFEXITED(status) || WEXITSTATUS(status) != 0)
+	{
+		PRINT_ERROR("ERROR :: Crashing process did not run.");
+	}
+	{
+		File file = File::open(filename);
+		if (file.stats().pages_recovered != 1)
+		{
+			PRINT_ERROR("ERROR :: Committed change to a new page was not recovered.");
+		}
+		FileIterator iter = file.begin();
+		if (iter == file.end())
+		{
+			PRINT_ERROR("ERROR :: Recovered new page is missing.");
+		}
+		Page recovered = *iter;
+		if (*recovered.begin() != "test.26 committed")
+		{
+			PRINT_ERROR("ERROR :: Contents of a recovered new page are wrong.");
+		}
+	}
+	File::remove(filename);
+
+	//Records the log fails to write are not counted as durable, and a later commit writes them
+	const pid_t writer = fork();
+	if (writer == 0)
+	{
+		File file = File::create(filename, false, FORMAT_LOGGED);
+		BufMgr childMgr(3);
+		PageId pageNo;
+		childMgr.allocPage(&file, pageNo, page);
+		const RecordId recordId = page->insertRecord("test.26 durable");
+		childMgr.unPinPage(&file, pageNo, true);
+		file.log()->commit();
+		const Lsn durable = file.log()->durableLsn();
+		childMgr.readPage(&file, pageNo, page);
+		page->updateRecord(recordId, "test.26 failing");
+		childMgr.unPinPage(&file, pageNo, true);
+
+		//Keep the log file from growing, as a full disk would
+		signal(SIGXFSZ, SIG_IGN);
+		std::ifstream log(LogManager::filenameFor(filename).c_str(), std::ios::binary | std::ios::ate);
+		struct rlimit limit;
+		getrlimit(RLIMIT_FSIZE, &limit);
+		const rlim_t unlimited = limit.rlim_cur;
+		limit.rlim_cur = static_cast<rlim_t>(log.tellg());
+		setrlimit(RLIMIT_FSIZE, &limit);
+		bool thrown = false;
+		try
+		{
+			file.log()->commit();
+		}
+		catch (LogWriteException e)
+		{
+			thrown = true;
+		}
+		limit.rlim_cur = unlimited;
+		setrlimit(RLIMIT_FSIZE, &limit);
+		if (!thrown || file.log()->durableLsn() != durable)
+		{
+			_exit(1);
+		}
+		file.log()->commit();
+		_exit(file.log()->durableLsn() == file.log()->endLsn() ? 0 : 2);
+	}
+	if (writer < 0 || waitpid(writer, &status, 0) != writer || !WIFEXITED(status) || WEXITSTATUS(status) != 0)
+	{
+		PRINT_ERROR("ERROR :: Records the log failed to write were counted as durable.");
+	}
+	{
+		File file = File::open(filename);
+		Page recovered = *file.begin();
+		if (*recovered.begin() != "test.26 failing")
+		{
+			PRINT_ERROR("ERROR :: Records written after a failed flush were lost.");
+		}
+	}
+	File::remove(filename);
+
+	//A log which cannot be opened is reported instead of being used
+	try
+	{
+		LogManager missing("no_such_directory/test.8.wal", true);
+		PRINT_ERROR("ERROR :: Expected LogWriteException was not thrown.");
+	}
+	catch (LogWriteException e)
+	{
+	}
+
+	std::cout << "Test 26 passed" << "\n";
+}
+
+void test27()
+{
+	//Dirty pages of a doublewrite file are written back in batches which share their syncs
+	const std::string& filename = "test.8";
+	const int pages = 4;
+	PageId pageIds[pages];
+	RecordId recordIds[pages];
+	{
+		File file = File::create(filename, false, FORMAT_DOUBLEWRITE);
+		BufMgr batchMgr(3);
+		for (i = 0; i < pages; i++)
+		{
+			batchMgr.allocPage(&file, pageIds[i], page);
+			sprintf((char*)tmpbuf, "test.27 Page %d %7.1f", pageIds[i], (float)pageIds[i]);
+			recordIds[i] = page->insertRecord(tmpbuf);
+			batchMgr.unPinPage(&file, pageIds[i], true);
+		}
+		//Evicting one page to make room for the last wrote back the other dirty pages with it
+		if (file.stats().doublewrite_batches != 1 || batchMgr.getBufStats().batchedWrites != 2)
+		{
+			PRINT_ERROR("ERROR :: Dirty pages were not written back as one batch.");
+		}
+		batchMgr.flushFile(&file);
+		if (file.stats().doublewrite_batches != 2 || batchMgr.getBufStats().diskwrites != pages)
+		{
+			PRINT_ERROR("ERROR :: Wrong pages written back by flushFile().");
+		}
+	}
+
+	//Simulate a crash which tore a page while it was written in place after its batch had been synced
+	const std::streamoff position = sizeof(FileHeader) + (pageIds[1] - 1) * Page::SIZE;
+	std::vector<char> entry(sizeof(PageId) + Page::SIZE);
+	std::memcpy(&entry[0], &pageIds[1], sizeof(PageId));
+	{
+		std::fstream onDisk(filename.c_str(), std::ios::in | std::ios::out | std::ios::binary);
+		onDisk.seekg(position);
+		onDisk.read(&entry[sizeof(PageId)], Page::SIZE);
+		onDisk.seekp(position + Page::SIZE / 2);
+		onDisk.write(std::string(Page::SIZE / 2, 'x').data(), Page::SIZE / 2);
+	}
+	const std::uint32_t numEntries = 1;
+	const std::uint32_t header[2] = {numEntries,
+		crc32c(&entry[0], entry.size(), crc32c(reinterpret_cast<const char*>(&numEntries), sizeof(numEntries)))};
+	{
+		std::ofstream doublewrite((filename + ".dblwr").c_str(), std::ios::binary);
+		doublewrite.write(reinterpret_cast<const char*>(header), sizeof(header));
+		doublewrite.write(&entry[0], entry.size());
+	}
+
+	//Opening the file restores the torn page from its copy
+	RecordId newerRecordId;
+	{
+		File file = File::open(filename);
+		if (file.stats().pages_repaired != 1)
+		{
+			PRINT_ERROR("ERROR :: Torn page was not repaired.");
+		}
+		for (i = 0; i < pages; i++)
+		{
+			bufMgr->readPage(&file, pageIds[i], page);
+			sprintf((char*)tmpbuf, "test.27 Page %d %7.1f", pageIds[i], (float)pageIds[i]);
+			if (strncmp(page->getRecord(recordIds[i]).c_str(), tmpbuf, strlen(tmpbuf)) != 0)
+			{
+				PRINT_ERROR("ERROR :: Contents of a repaired file are wrong.");
+			}
+			bufMgr->unPinPage(&file, pageIds[i], false);
+		}
+		bufMgr->readPage(&file, pageIds[1], page);
+		newerRecordId = page->insertRecord("test.27 newer");
+		bufMgr->unPinPage(&file, pageIds[1], true);
+		bufMgr->flushFile(&file);
+	}
+
+	//An intact page written again since its batch keeps its newer contents if the batch is found again
+	{
+		std::ofstream doublewrite((filename + ".dblwr").c_str(), std::ios::binary);
+		doublewrite.write(reinterpret_cast<const char*>(header), sizeof(header));
+		doublewrite.write(&entry[0], entry.size());
+	}
+	{
+		File file = File::open(filename);
+		if (file.stats().pages_repaired != 0)
+		{
+			PRINT_ERROR("ERROR :: Intact page was overwritten by its stale copy.");
+		}
+		bufMgr->readPage(&file, pageIds[1], page);
+		if (page->getRecord(newerRecordId) != "test.27 newer")
+		{
+			PRINT_ERROR("ERROR :: Change made after a batch was lost.");
+		}
+		bufMgr->unPinPage(&file, pageIds[1], false);
+		bufMgr->flushFile(&file);
+	}
+
+	//A damaged count in the doublewrite header is ignored rather than trusted with the size of a read
+	{
+		const std::uint32_t damaged[2] = {0xfffffff0, 0};
+		std::ofstream doublewrite((filename + ".dblwr").c_str(), std::ios::binary);
+		doublewrite.write(reinterpret_cast<const char*>(damaged), sizeof(damaged));
+	}
+	{
+		File file = File::open(filename);
+		if (file.stats().pages_repaired != 0)
+		{
+			PRINT_ERROR("ERROR :: Pages were restored from a damaged batch.");
+		}
+	}
+	File::remove(filename);
+
+	std::cout << "Test 27 passed" << "\n";
+}
+
+void test28()
+{
+	//A snapshot reader keeps seeing a page as it was while a writer changes it
+	const std::string& filename = "test.8";
+	{
+		File file = File::create(filename);
+		BufMgr versionMgr(3);
+		PageId pageNo;
+		versionMgr.allocPage(&file, pageNo, page);
+		const RecordId recordId = page->insertRecord("test.28 before");
+		versionMgr.unPinPage(&file, pageNo, true);
+
+		const Page* snapshot;
+		versionMgr.readPageSnapshot(&file, pageNo, snapshot);
+		versionMgr.readPageForUpdate(&file, pageNo, page);
+		if (page == snapshot || versionMgr.getBufStats().versionCopies != 1)
+		{
+			PRINT_ERROR("ERROR :: Writer was not given a copy of a page held by a snapshot reader.");
+		}
+		page->updateRecord(recordId, "test.28 after");
+		versionMgr.unPinPage(&file, pageNo, true);
+		if (snapshot->getRecord(recordId) != "test.28 before")
+		{
+			PRINT_ERROR("ERROR :: Snapshot reader saw a change made after it started.");
+		}
+
+		//New readers see the current version
+		versionMgr.readPage(&file, pageNo, page);
+		if (page->getRecord(recordId) != "test.28 after")
+		{
+			PRINT_ERROR("ERROR :: Reader did not see the current version of a page.");
+		}
+		versionMgr.unPinPage(&file, pageNo, false);
+
+		//The old version is dropped once its reader is done, and only the current one is written back
+		versionMgr.releaseSnapshot(snapshot);
+		if (versionMgr.collectFileFrameStats()[filename].residentPages != 1)
+		{
+			PRINT_ERROR("ERROR :: Old version of a page was kept after its last reader released it.");
+		}
+		try
+		{
+			versionMgr.releaseSnapshot(snapshot);
+			PRINT_ERROR("ERROR :: Expected PageNotPinnedException was not thrown.");
+		}
+		catch (PageNotPinnedException e)
+		{
+		}
+		versionMgr.flushFile(&file);
+		if (file.readPage(pageNo).getRecord(recordId) != "test.28 after")
+		{
+			PRINT_ERROR("ERROR :: Current version of a page was not written back.");
+		}
+
+		//A snapshot reader arriving while a writer holds the page sees it as it was before the change
+		versionMgr.readPageForUpdate(&file, pageNo, page);
+		page->updateRecord(recordId, "test.28 during");
+		versionMgr.readPageSnapshot(&file, pageNo, snapshot);
+		if (snapshot == page || snapshot->getRecord(recordId) != "test.28 after")
+		{
+			PRINT_ERROR("ERROR :: Snapshot reader saw a change in progress.");
+		}
+		versionMgr.unPinPage(&file, pageNo, true);
+		versionMgr.releaseSnapshot(snapshot);
+
+		//Nobody shares a frame with a snapshot reader, while writers and plain readers share the current one
+		versionMgr.readPageSnapshot(&file, pageNo, snapshot);
+		Page* reader;
+		versionMgr.readPage(&file, pageNo, reader);
+		versionMgr.readPageForUpdate(&file, pageNo, page);
+		if (reader == snapshot || page != reader)
+		{
+			PRINT_ERROR("ERROR :: Snapshot reader shared its frame.");
+		}
+		page->updateRecord(recordId, "test.28 last");
+		versionMgr.unPinPage(&file, pageNo, true);
+		versionMgr.unPinPage(&file, pageNo, false);
+		if (snapshot->getRecord(recordId) != "test.28 during")
+		{
+			PRINT_ERROR("ERROR :: Snapshot reader saw a change made after it started.");
+		}
+
+		//Without a free frame for a copy, the writer gets no page, as readPage() does
+		const Page* current;
+		versionMgr.readPageSnapshot(&file, pageNo, current);
+		PageId otherPageNo;
+		Page* other;
+		versionMgr.allocPage(&file, otherPageNo, other);
+		page = NULL;
+		try
+		{
+			versionMgr.readPageForUpdate(&file, pageNo, page);
+		}
+		catch (BufferExceededException e)
+		{
+			PRINT_ERROR("ERROR :: Writer threw where readPage() does not.");
+		}
+		if (page != NULL)
+		{
+			PRINT_ERROR("ERROR :: Writer was given a page without a free frame.");
+		}
+		versionMgr.unPinPage(&file, otherPageNo, false);
+		versionMgr.releaseSnapshot(current);
+		versionMgr.releaseSnapshot(snapshot);
+
+		//The copy for snapshot readers is only brought up to date once no writer is part way through a change
+		versionMgr.readPage(&file, pageNo, reader);
+		Page* firstWriter;
+		Page* secondWriter;
+		versionMgr.readPageForUpdate(&file, pageNo, firstWriter);
+		versionMgr.readPageForUpdate(&file, pageNo, secondWriter);
+		secondWriter->updateRecord(recordId, "test.28 half");
+		versionMgr.unPinPage(&file, pageNo, true);
+		versionMgr.readPageSnapshot(&file, pageNo, snapshot);
+		if (snapshot->getRecord(recordId) != "test.28 last")
+		{
+			PRINT_ERROR("ERROR :: Snapshot reader saw a change another writer was part way through.");
+		}
+		versionMgr.releaseSnapshot(snapshot);
+		secondWriter->updateRecord(recordId, "test.28 whole");
+		versionMgr.unPinPage(&file, pageNo, true);
+		versionMgr.readPageSnapshot(&file, pageNo, snapshot);
+		if (snapshot->getRecord(recordId) != "test.28 whole")
+		{
+			PRINT_ERROR("ERROR :: Snapshot reader did not see a finished change.");
+		}
+		versionMgr.releaseSnapshot(snapshot);
+		versionMgr.unPinPage(&file, pageNo, false);
+
+		//Pages which are not in the buffer pool are not released
+		Page outside;
+		try
+		{
+			versionMgr.releaseSnapshot(&outside);
+			PRINT_ERROR("ERROR :: Expected PageNotPinnedException was not thrown.");
+		}
+		catch (PageNotPinnedException e)
+		{
+		}
+	}
+	File::remove(filename);
+
+	std::cout << "Test 28 passed" << "\n";
+}
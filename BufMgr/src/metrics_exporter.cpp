@@ -0,0 +1,426 @@
+/**
+ * @author See Contributors.txt for code contributors and overview of BadgerDB.
+ *
+ * @section LICENSE
+ * Copyright (c) 2012 Database Group, Computer Sciences Department, University of Wisconsin-Madison.
+ */
+
+#include "metrics_exporter.h"
+
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <map>
+#include <sstream>
+#include <vector>
+
+#include <fcntl.h>
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+namespace badgerdb {
+
+namespace {
+
+/**
+ * One value of a metric together with its labels.
+ */
+struct Sample {
+  std::string name;
+  std::string help;
+  std::string type;
+  std::vector<std::pair<std::string, std::string> > labels;
+  double value;
+};
+
+typedef std::vector<Sample> Samples;
+
+typedef std::vector<std::pair<std::string, std::string> > Labels;
+
+/**
+ * Appends a sample.  Samples of one metric family must be appended
+ * consecutively; only the first sample of a family needs a help text.
+ */
+void addSample(Samples* samples, const std::string& name,
+               const std::string& help, const std::string& type,
+               const Labels& labels, const double value) {
+  Sample sample = {name, help, type, labels, value};
+  samples->push_back(sample);
+}
+
+Labels makeLabels(const std::string& key, const std::string& value) {
+  return Labels(1, std::make_pair(key, value));
+}
+
+Labels addLabel(Labels labels, const std::string& key,
+                const std::string& value) {
+  labels.push_back(std::make_pair(key, value));
+  return labels;
+}
+
+std::string escapeLabelValue(const std::string& value) {
+  std::string escaped;
+  for (std::size_t i = 0; i < value.size(); ++i) {
+    if (value[i] == '\\' || value[i] == '"') {
+      escaped += '\\';
+      escaped += value[i];
+    } else if (value[i] == '\n') {
+      escaped += "\\n";
+    } else {
+      escaped += value[i];
+    }
+  }
+  return escaped;
+}
+
+std::string escapeJson(const std::string& value) {
+  std::string escaped;
+  for (std::size_t i = 0; i < value.size(); ++i) {
+    const unsigned char c = value[i];
+    if (c == '\\' || c == '"') {
+      escaped += '\\';
+      escaped += c;
+    } else if (c < 0x20) {
+      char buf[8];
+      std::snprintf(buf, sizeof(buf), "\\u%04x", c);
+      escaped += buf;
+    } else {
+      escaped += c;
+    }
+  }
+  return escaped;
+}
+
+const char* const OP_NAMES[NUM_BUF_OPS] = {
+  "read_hit", "read_miss", "alloc", "unpin", "flush", "evict",
+  "file_read", "file_write"
+};
+
+void collectSamples(const std::string& pool_name, const BufMgr* buf_mgr,
+                    Samples* samples) {
+  const Labels pool = makeLabels("pool", pool_name);
+  const BufStats stats = buf_mgr->snapshotBufStats();
+
+  addSample(samples, "badgerdb_buffer_frames",
+            "Number of frames in the buffer pool.", "gauge", pool,
+            buf_mgr->numFrames());
+  addSample(samples, "badgerdb_buffer_accesses_total",
+            "Page accesses through readPage and allocPage.", "counter", pool,
+            stats.accesses);
+  addSample(samples, "badgerdb_buffer_hits_total",
+            "readPage calls served from the buffer pool.", "counter", pool,
+            stats.hits);
+  addSample(samples, "badgerdb_buffer_misses_total",
+            "readPage calls which had to read from disk.", "counter", pool,
+            stats.misses);
+  addSample(samples, "badgerdb_buffer_hit_ratio",
+            "Fraction of readPage calls served from the buffer pool.", "gauge",
+            pool, stats.hitRatio());
+  addSample(samples, "badgerdb_buffer_disk_reads_total",
+            "Pages read from disk, including allocations.", "counter", pool,
+            stats.diskreads);
+  addSample(samples, "badgerdb_buffer_disk_writes_total",
+            "Pages written to disk.", "counter", pool, stats.diskwrites);
+  addSample(samples, "badgerdb_buffer_evictions_total",
+            "Pages evicted by kind.", "counter",
+            addLabel(pool, "kind", "clean"), stats.cleanEvictions);
+  addSample(samples, "badgerdb_buffer_evictions_total",
+            "Pages evicted by kind.", "counter",
+            addLabel(pool, "kind", "dirty"), stats.dirtyEvictions);
+  addSample(samples, "badgerdb_buffer_writebacks_total",
+            "Pages written back by cause.", "counter",
+            addLabel(pool, "cause", "eviction"), stats.evictionWrites);
+  addSample(samples, "badgerdb_buffer_writebacks_total",
+            "Pages written back by cause.", "counter",
+            addLabel(pool, "cause", "flush"), stats.flushWrites);
+  addSample(samples, "badgerdb_buffer_writebacks_total",
+            "Pages written back by cause.", "counter",
+            addLabel(pool, "cause", "checkpoint"), stats.checkpointWrites);
+  addSample(samples, "badgerdb_buffer_writebacks_total",
+            "Pages written back by cause.", "counter",
+            addLabel(pool, "cause", "batch"), stats.batchedWrites);
+  addSample(samples, "badgerdb_buffer_version_copies_total",
+            "Pages copied so that a writer could proceed past snapshot "
+            "readers.", "counter",
+            pool, stats.versionCopies);
+  addSample(samples, "badgerdb_buffer_pin_waits_total",
+            "Frame allocations which found every frame pinned.", "counter",
+            pool, stats.pinWaits);
+  addSample(samples, "badgerdb_buffer_pinned_skips_total",
+            "Pinned frames passed over by the clock hand.", "counter", pool,
+            stats.pinnedSkips);
+  addSample(samples, "badgerdb_buffer_clock_sweep_frames_total",
+            "Frames examined by the clock hand.", "counter", pool,
+            stats.clockSweeps);
+
+  static const double QUANTILES[] = {0.5, 0.99, 0.999};
+  for (int op = 0; op < NUM_BUF_OPS; ++op) {
+    const LatencyHistogram& histogram =
+        buf_mgr->getLatencyHistogram(static_cast<BufOp>(op));
+    const Labels op_labels = addLabel(pool, "op", OP_NAMES[op]);
+    for (std::size_t q = 0; q < sizeof(QUANTILES) / sizeof(QUANTILES[0]);
+         ++q) {
+      std::ostringstream quantile;
+      quantile << QUANTILES[q];
+      addSample(samples, "badgerdb_buffer_latency_seconds",
+                "Latency of buffer operations.", "summary",
+                addLabel(op_labels, "quantile", quantile.str()),
+                histogram.percentileNanos(QUANTILES[q]) / 1e9);
+    }
+  }
+  for (int op = 0; op < NUM_BUF_OPS; ++op) {
+    addSample(samples, "badgerdb_buffer_latency_seconds_sum", "", "summary",
+              addLabel(pool, "op", OP_NAMES[op]),
+              buf_mgr->getLatencyHistogram(static_cast<BufOp>(op)).sumNanos() /
+                  1e9);
+  }
+  for (int op = 0; op < NUM_BUF_OPS; ++op) {
+    addSample(samples, "badgerdb_buffer_latency_seconds_count", "", "summary",
+              addLabel(pool, "op", OP_NAMES[op]),
+              buf_mgr->getLatencyHistogram(static_cast<BufOp>(op)).count());
+  }
+
+  const std::map<std::string, FileFrameStats> frames =
+      buf_mgr->collectFileFrameStats();
+  std::map<std::string, FileFrameStats>::const_iterator frame;
+  for (frame = frames.begin(); frame != frames.end(); ++frame) {
+    addSample(samples, "badgerdb_buffer_file_resident_pages",
+              "Pages of a file resident in the buffer pool.", "gauge",
+              addLabel(pool, "file", frame->first),
+              frame->second.residentPages);
+  }
+  for (frame = frames.begin(); frame != frames.end(); ++frame) {
+    addSample(samples, "badgerdb_buffer_file_dirty_pages",
+              "Dirty pages of a file in the buffer pool.", "gauge",
+              addLabel(pool, "file", frame->first), frame->second.dirtyPages);
+  }
+  for (frame = frames.begin(); frame != frames.end(); ++frame) {
+    addSample(samples, "badgerdb_buffer_file_pinned_pages",
+              "Pinned pages of a file in the buffer pool.", "gauge",
+              addLabel(pool, "file", frame->first), frame->second.pinnedPages);
+  }
+
+  const std::map<std::string, FileStats> files = File::openFileStats();
+  struct FileCounter {
+    const char* name;
+    const char* help;
+    std::uint64_t FileStats::*field;
+  };
+  static const FileCounter FILE_COUNTERS[] = {
+    {"badgerdb_file_page_reads_total", "Pages read from a file.",
+     &FileStats::page_reads},
+    {"badgerdb_file_page_header_reads_total",
+     "Page headers read from a file on their own.",
+     &FileStats::page_header_reads},
+    {"badgerdb_file_page_writes_total", "Pages written to a file.",
+     &FileStats::page_writes},
+    {"badgerdb_file_header_reads_total", "File header reads.",
+     &FileStats::header_reads},
+    {"badgerdb_file_header_writes_total", "File header writes.",
+     &FileStats::header_writes},
+    {"badgerdb_file_pages_allocated_total", "Pages allocated in a file.",
+     &FileStats::pages_allocated},
+    {"badgerdb_file_pages_deleted_total", "Pages deleted from a file.",
+     &FileStats::pages_deleted},
+    {"badgerdb_file_pages_recovered_total",
+     "Pages brought up to date from the write-ahead log on open.",
+     &FileStats::pages_recovered},
+    {"badgerdb_file_doublewrite_batches_total",
+     "Batches of pages written through the doublewrite file.",
+     &FileStats::doublewrite_batches},
+    {"badgerdb_file_pages_repaired_total",
+     "Pages restored from the doublewrite file on open.",
+     &FileStats::pages_repaired},
+  };
+  for (std::size_t c = 0; c < sizeof(FILE_COUNTERS) / sizeof(FILE_COUNTERS[0]);
+       ++c) {
+    for (std::map<std::string, FileStats>::const_iterator file = files.begin();
+         file != files.end();
+         ++file) {
+      addSample(samples, FILE_COUNTERS[c].name, FILE_COUNTERS[c].help,
+                "counter", makeLabels("file", file->first),
+                file->second.*FILE_COUNTERS[c].field);
+    }
+  }
+}
+
+}
+
+MetricsExporter::MetricsExporter(const std::string& pool_name,
+                                 const BufMgr* buf_mgr)
+    : pool_name_(pool_name),
+      buf_mgr_(buf_mgr),
+      output_format_(PROMETHEUS),
+      output_interval_(0),
+      listen_fd_(-1) {
+}
+
+MetricsExporter::~MetricsExporter() {
+  if (listen_fd_ >= 0) {
+    ::close(listen_fd_);
+    ::unlink(socket_path_.c_str());
+  }
+}
+
+std::string MetricsExporter::renderPrometheus() const {
+  Samples samples;
+  collectSamples(pool_name_, buf_mgr_, &samples);
+
+  std::ostringstream out;
+  out.precision(17);
+  std::string previous_name;
+  for (std::size_t i = 0; i < samples.size(); ++i) {
+    const Sample& sample = samples[i];
+    // Samples without help text (such as the _sum and _count of a summary)
+    // belong to the family of the samples before them.
+    if (sample.name != previous_name && !sample.help.empty()) {
+      out << "# HELP " << sample.name << " " << sample.help << "\n";
+      out << "# TYPE " << sample.name << " " << sample.type << "\n";
+    }
+    previous_name = sample.name;
+    out << sample.name << "{";
+    for (std::size_t l = 0; l < sample.labels.size(); ++l) {
+      out << (l > 0 ? "," : "") << sample.labels[l].first << "=\""
+          << escapeLabelValue(sample.labels[l].second) << "\"";
+    }
+    out << "} " << sample.value << "\n";
+  }
+  return out.str();
+}
+
+std::string MetricsExporter::renderJson() const {
+  Samples samples;
+  collectSamples(pool_name_, buf_mgr_, &samples);
+
+  std::ostringstream out;
+  out.precision(17);
+  out << "{\"metrics\":[";
+  for (std::size_t i = 0; i < samples.size(); ++i) {
+    const Sample& sample = samples[i];
+    out << (i > 0 ? "," : "") << "\n  {\"name\":\"" << sample.name
+        << "\",\"type\":\"" << sample.type << "\",\"labels\":{";
+    for (std::size_t l = 0; l < sample.labels.size(); ++l) {
+      out << (l > 0 ? "," : "") << "\"" << sample.labels[l].first << "\":\""
+          << escapeJson(sample.labels[l].second) << "\"";
+    }
+    out << "},\"value\":" << sample.value << "}";
+  }
+  out << "\n]}\n";
+  return out.str();
+}
+
+std::string MetricsExporter::render(const Format format) const {
+  return format == JSON ? renderJson() : renderPrometheus();
+}
+
+void MetricsExporter::writeToFile(const std::string& path,
+                                  const Format format) const {
+  const std::string tmp_path = path + ".tmp";
+  {
+    std::ofstream out(tmp_path.c_str(), std::ios::out | std::ios::trunc);
+    out << render(format);
+  }
+  std::rename(tmp_path.c_str(), path.c_str());
+}
+
+void MetricsExporter::setFileOutput(const std::string& path,
+                                    const Format format,
+                                    const std::chrono::milliseconds interval) {
+  output_path_ = path;
+  output_format_ = format;
+  output_interval_ = interval;
+  last_output_ = std::chrono::steady_clock::time_point();
+}
+
+bool MetricsExporter::listen(const std::string& socket_path) {
+  sockaddr_un addr;
+  if (socket_path.size() >= sizeof(addr.sun_path)) {
+    return false;
+  }
+  std::memset(&addr, 0, sizeof(addr));
+  addr.sun_family = AF_UNIX;
+  std::strncpy(addr.sun_path, socket_path.c_str(), sizeof(addr.sun_path) - 1);
+
+  const int fd = ::socket(AF_UNIX, SOCK_STREAM, 0);
+  if (fd < 0) {
+    return false;
+  }
+  ::unlink(socket_path.c_str());
+  if (::bind(fd, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) != 0 ||
+      ::listen(fd, 16) != 0) {
+    ::close(fd);
+    return false;
+  }
+  // poll() must never block waiting for a scraper.
+  ::fcntl(fd, F_SETFL, ::fcntl(fd, F_GETFL, 0) | O_NONBLOCK);
+
+  if (listen_fd_ >= 0) {
+    ::close(listen_fd_);
+    ::unlink(socket_path_.c_str());
+  }
+  listen_fd_ = fd;
+  socket_path_ = socket_path;
+  return true;
+}
+
+void MetricsExporter::poll() {
+  if (!output_path_.empty()) {
+    const std::chrono::steady_clock::time_point now =
+        std::chrono::steady_clock::now();
+    if (last_output_ == std::chrono::steady_clock::time_point() ||
+        now - last_output_ >= output_interval_) {
+      writeToFile(output_path_, output_format_);
+      last_output_ = now;
+    }
+  }
+
+  if (listen_fd_ >= 0) {
+    int client_fd;
+    while ((client_fd = ::accept(listen_fd_, NULL, NULL)) >= 0) {
+      serveClient(client_fd);
+      ::close(client_fd);
+    }
+  }
+}
+
+void MetricsExporter::serveClient(const int client_fd) const {
+  // Accepted sockets may inherit O_NONBLOCK; wait briefly for a request
+  // instead, but never long enough to stall the caller.
+  ::fcntl(client_fd, F_SETFL, ::fcntl(client_fd, F_GETFL, 0) & ~O_NONBLOCK);
+  timeval timeout = {0, 100000};
+  ::setsockopt(client_fd, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+
+  char buf[1024];
+  const ssize_t len = ::recv(client_fd, buf, sizeof(buf) - 1, 0);
+  const std::string request(buf, len > 0 ? len : 0);
+  const std::string::size_type line_end = request.find('\n');
+  const std::string first_line = request.substr(0, line_end);
+  const Format format =
+      first_line.find("json") != std::string::npos ? JSON : PROMETHEUS;
+  const std::string body = render(format);
+
+  std::string response;
+  if (first_line.compare(0, 4, "GET ") == 0) {
+    std::ostringstream header;
+    header << "HTTP/1.0 200 OK\r\nContent-Type: "
+           << (format == JSON ? "application/json"
+                              : "text/plain; version=0.0.4")
+           << "\r\nContent-Length: " << body.size() << "\r\n\r\n";
+    response = header.str();
+  }
+  response += body;
+
+  std::size_t sent = 0;
+  while (sent < response.size()) {
+    const ssize_t n = ::send(client_fd, response.data() + sent,
+                             response.size() - sent, MSG_NOSIGNAL);
+    if (n <= 0) {
+      break;
+    }
+    sent += n;
+  }
+}
+
+}
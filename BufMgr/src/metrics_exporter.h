@@ -0,0 +1,163 @@
+/**
+ * @author See Contributors.txt for code contributors and overview of BadgerDB.
+ *
+ * @section LICENSE
+ * Copyright (c) 2012 Database Group, Computer Sciences Department, University of Wisconsin-Madison.
+ */
+
+#pragma once
+
+#include <chrono>
+#include <string>
+
+#include "buffer.h"
+
+namespace badgerdb {
+
+/**
+ * @brief Renders buffer pool and file statistics for scraping.
+ *
+ * Metrics are rendered either in the Prometheus text exposition format or as
+ * JSON.  Buffer pool metrics carry a <code>pool</code> label and per-file
+ * metrics a <code>file</code> label.  They can be written to a file every
+ * interval and served on a local Unix socket; both happen from poll(), which
+ * the owner of the buffer manager calls regularly, because BufMgr is not
+ * threadsafe and must not be read from another thread.
+ *
+ * The socket answers plain HTTP GET requests (so a Prometheus scraper can
+ * reach it through a socket-aware proxy) as well as bare connections.  A
+ * request whose first line (the request line of a GET, e.g. a path ending in
+ * <code>?format=json</code>) mentions <code>json</code> gets JSON; everything
+ * else gets Prometheus text.
+ */
+class MetricsExporter {
+ public:
+  /**
+   * Output format of rendered metrics.
+   */
+  enum Format {
+    PROMETHEUS,
+    JSON
+  };
+
+  /**
+   * Constructs an exporter for the given buffer pool.
+   *
+   * @param pool_name   Value of the pool label of every buffer pool metric.
+   * @param buf_mgr     Buffer manager whose statistics are exported.
+   */
+  MetricsExporter(const std::string& pool_name, const BufMgr* buf_mgr);
+
+  /**
+   * Closes the socket endpoint, if any, and removes its socket file.
+   */
+  ~MetricsExporter();
+
+  /**
+   * Renders all metrics in the Prometheus text exposition format.
+   *
+   * @return  Rendered metrics.
+   */
+  std::string renderPrometheus() const;
+
+  /**
+   * Renders all metrics as a JSON document.
+   *
+   * @return  Rendered metrics.
+   */
+  std::string renderJson() const;
+
+  /**
+   * Renders all metrics in the given format.
+   *
+   * @param format  Output format.
+   * @return  Rendered metrics.
+   */
+  std::string render(const Format format) const;
+
+  /**
+   * Writes all metrics to the given file.  The metrics are written to a
+   * temporary file which is then renamed, so readers never see a partial file.
+   *
+   * @param path    Name of file to write.
+   * @param format  Output format.
+   */
+  void writeToFile(const std::string& path, const Format format) const;
+
+  /**
+   * Makes poll() write metrics to the given file whenever the interval has
+   * elapsed since the previous write.
+   *
+   * @param path      Name of file to write.
+   * @param format    Output format.
+   * @param interval  Minimum time between writes.
+   */
+  void setFileOutput(const std::string& path, const Format format,
+                     const std::chrono::milliseconds interval);
+
+  /**
+   * Starts serving metrics on a Unix socket at the given path.  An existing
+   * socket file at that path is replaced.
+   *
+   * @param socket_path   Path of the socket file.
+   * @return  True if the socket is listening; false if it could not be set up.
+   */
+  bool listen(const std::string& socket_path);
+
+  /**
+   * Writes the metrics file if its interval has elapsed and answers every
+   * connection waiting on the socket.  Never blocks waiting for new
+   * connections.
+   */
+  void poll();
+
+ private:
+  /**
+   * Answers one client connected to the socket.
+   *
+   * @param client_fd   Descriptor of connected client.
+   */
+  void serveClient(const int client_fd) const;
+
+  /**
+   * Value of the pool label.
+   */
+  std::string pool_name_;
+
+  /**
+   * Buffer manager whose statistics are exported.
+   */
+  const BufMgr* buf_mgr_;
+
+  /**
+   * File written by poll(), or empty if file output is disabled.
+   */
+  std::string output_path_;
+
+  /**
+   * Format of the file written by poll().
+   */
+  Format output_format_;
+
+  /**
+   * Minimum time between writes of the output file.
+   */
+  std::chrono::milliseconds output_interval_;
+
+  /**
+   * Time of the last write of the output file.
+   */
+  std::chrono::steady_clock::time_point last_output_;
+
+  /**
+   * Path of the socket file, or empty if not listening.
+   */
+  std::string socket_path_;
+
+  /**
+   * Descriptor of the listening socket, or -1 if not listening.
+   */
+  int listen_fd_;
+};
+
+}
@@ -0,0 +1,135 @@
+/**
+ * @author See Contributors.txt for code contributors and overview of BadgerDB.
+ *
+ * @section LICENSE
+ * Copyright (c) 2012 Database Group, Computer Sciences Department, University of Wisconsin-Madison.
+ */
+
+#include "mrc_estimator.h"
+
+#include <algorithm>
+#include <utility>
+
+namespace badgerdb {
+
+namespace {
+
+/**
+ * Smallest Fenwick tree the estimator keeps.
+ */
+const std::uint64_t MIN_TREE_SIZE = 1024;
+
+}
+
+MrcEstimator::MrcEstimator(const double sampling_rate)
+    : sampling_rate_(sampling_rate) {
+  if (sampling_rate_ <= 0.0 || sampling_rate_ > 1.0) {
+    sampling_rate_ = 1.0;
+  }
+  threshold_ = static_cast<std::uint64_t>(sampling_rate_ * HASH_MODULUS);
+  if (threshold_ == 0) {
+    threshold_ = 1;
+  }
+  // Scale by the rate actually sampled rather than the one asked for.
+  sampling_rate_ = static_cast<double>(threshold_) / HASH_MODULUS;
+  clear();
+}
+
+void MrcEstimator::clear() {
+  accesses_ = 0;
+  sampled_accesses_ = 0;
+  last_access_.clear();
+  tree_.assign(MIN_TREE_SIZE + 1, 0);
+  now_ = 0;
+  distances_.clear();
+}
+
+void MrcEstimator::recordSampledAccess(const std::uint64_t key) {
+  ++sampled_accesses_;
+  std::unordered_map<std::uint64_t, std::uint64_t>::iterator it =
+      last_access_.find(key);
+  if (it != last_access_.end()) {
+    // Every page accessed after this one has its last access later in time.
+    const std::uint64_t distance = treeSum(now_) - treeSum(it->second);
+    if (distance >= distances_.size()) {
+      distances_.resize(distance + 1, 0);
+    }
+    ++distances_[distance];
+    treeAdd(it->second, -1);
+    last_access_.erase(it);
+  }
+  if (now_ + 1 >= tree_.size()) {
+    compact();
+  }
+  ++now_;
+  treeAdd(now_, 1);
+  last_access_[key] = now_;
+}
+
+void MrcEstimator::forget(const File* file, const PageId page) {
+  const std::uint64_t key = makeKey(file, page);
+  std::unordered_map<std::uint64_t, std::uint64_t>::iterator it =
+      last_access_.find(key);
+  if (it != last_access_.end()) {
+    treeAdd(it->second, -1);
+    last_access_.erase(it);
+  }
+}
+
+double MrcEstimator::hitRatio(const std::uint64_t frames) const {
+  if (sampled_accesses_ == 0) {
+    return 0.0;
+  }
+  // A sampled distance d stands for d / rate distinct pages, which stay
+  // resident in an LRU pool of more than that many frames.
+  const double limit = frames * sampling_rate_;
+  std::uint64_t hits = 0;
+  for (std::uint64_t d = 0; d < distances_.size() && d < limit; ++d) {
+    hits += distances_[d];
+  }
+  // SHARDS_adj: the sample may hold more or fewer accesses than its share of
+  // the whole stream.  The error is mostly in accesses to popular pages, so
+  // it is charged to the smallest distance.
+  const double expected = accesses_ * sampling_rate_;
+  double adjusted_hits = hits;
+  if (!distances_.empty() && limit > 0) {
+    adjusted_hits += expected - sampled_accesses_;
+  }
+  const double ratio = adjusted_hits / expected;
+  return std::max(0.0, std::min(1.0, ratio));
+}
+
+void MrcEstimator::treeAdd(std::uint64_t position, const int delta) {
+  for (; position < tree_.size(); position += position & (~position + 1)) {
+    tree_[position] += delta;
+  }
+}
+
+std::uint64_t MrcEstimator::treeSum(std::uint64_t position) const {
+  std::uint64_t sum = 0;
+  for (; position > 0; position -= position & (~position + 1)) {
+    sum += tree_[position];
+  }
+  return sum;
+}
+
+void MrcEstimator::compact() {
+  std::vector<std::pair<std::uint64_t, std::uint64_t> > by_time;
+  by_time.reserve(last_access_.size());
+  for (std::unordered_map<std::uint64_t, std::uint64_t>::const_iterator it =
+           last_access_.begin();
+       it != last_access_.end(); ++it) {
+    by_time.push_back(std::make_pair(it->second, it->first));
+  }
+  std::sort(by_time.begin(), by_time.end());
+
+  const std::uint64_t size = std::max(MIN_TREE_SIZE, 4 * by_time.size());
+  tree_.assign(size + 1, 0);
+  for (std::uint64_t i = 0; i < by_time.size(); ++i) {
+    last_access_[by_time[i].second] = i + 1;
+    treeAdd(i + 1, 1);
+  }
+  now_ = by_time.size();
+}
+
+}
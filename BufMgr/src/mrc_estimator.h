@@ -0,0 +1,170 @@
+/**
+ * @author See Contributors.txt for code contributors and overview of BadgerDB.
+ *
+ * @section LICENSE
+ * Copyright (c) 2012 Database Group, Computer Sciences Department, University of Wisconsin-Madison.
+ */
+
+#pragma once
+
+#include <cstdint>
+#include <unordered_map>
+#include <vector>
+
+#include "types.h"
+
+namespace badgerdb {
+
+class File;
+
+/**
+ * @brief Online estimator of the miss ratio curve of a page access stream.
+ *
+ * Uses SHARDS (Waldspurger et al., "Efficient MRC Construction with SHARDS",
+ * FAST 2015): a page is tracked only if the hash of its (file, page) key falls
+ * below a threshold, so a fixed fraction of the pages is sampled, and all
+ * accesses to a sampled page are seen.  For those accesses the LRU reuse
+ * distance, i.e. the number of distinct sampled pages touched since the
+ * previous access to the same page, is computed with a Fenwick tree and
+ * scaled up by the sampling rate.  The histogram of scaled distances gives
+ * the hit ratio an LRU pool of any size would have had.  The clock policy
+ * approximates LRU, so this is also a close estimate for BufMgr.
+ *
+ * Unsampled accesses cost one hash and a compare.  Memory is proportional to
+ * the number of sampled pages.
+ */
+class MrcEstimator {
+ public:
+  /**
+   * Constructs an estimator.
+   *
+   * @param sampling_rate  Fraction of pages to track, in (0, 1].  0.01 is
+   *                       usually accurate to within a percent or two for
+   *                       pools of a few thousand frames or more.
+   */
+  explicit MrcEstimator(const double sampling_rate);
+
+  /**
+   * Records an access to a page.
+   *
+   * @param file  File the page belongs to.
+   * @param page  Number of the page within the file.
+   */
+  void recordAccess(const File* file, const PageId page) {
+    ++accesses_;
+    const std::uint64_t key = makeKey(file, page);
+    if ((hashKey(key) & (HASH_MODULUS - 1)) < threshold_) {
+      recordSampledAccess(key);
+    }
+  }
+
+  /**
+   * Forgets a page which was deleted, so that a page later allocated with
+   * the same number counts as a new page.
+   *
+   * @param file  File the page belonged to.
+   * @param page  Number of the page within the file.
+   */
+  void forget(const File* file, const PageId page);
+
+  /**
+   * Returns the hit ratio an LRU buffer pool of the given size would have
+   * had on the accesses recorded so far.
+   *
+   * @param frames  Number of frames in the pool.
+   * @return  Predicted hit ratio between 0 and 1.
+   */
+  double hitRatio(const std::uint64_t frames) const;
+
+  /**
+   * Discards everything recorded.
+   */
+  void clear();
+
+  /**
+   * Returns the fraction of pages tracked.
+   */
+  double samplingRate() const { return sampling_rate_; }
+
+  /**
+   * Returns the number of accesses recorded, sampled or not.
+   */
+  std::uint64_t accesses() const { return accesses_; }
+
+  /**
+   * Returns the number of accesses to sampled pages.
+   */
+  std::uint64_t sampledAccesses() const { return sampled_accesses_; }
+
+  /**
+   * Returns the number of sampled pages currently tracked.
+   */
+  std::uint64_t trackedPages() const { return last_access_.size(); }
+
+ private:
+  /**
+   * Hash values are reduced modulo this power of two before being compared
+   * with the sampling threshold.
+   */
+  static const std::uint64_t HASH_MODULUS = 1 << 24;
+
+  static std::uint64_t makeKey(const File* file, const PageId page) {
+    return reinterpret_cast<std::uintptr_t>(file) ^
+           (static_cast<std::uint64_t>(page) * 0x9e3779b97f4a7c15ULL);
+  }
+
+  /**
+   * Finalizer of SplitMix64; mixes every key bit into the low bits.
+   */
+  static std::uint64_t hashKey(std::uint64_t key) {
+    key = (key ^ (key >> 30)) * 0xbf58476d1ce4e5b9ULL;
+    key = (key ^ (key >> 27)) * 0x94d049bb133111ebULL;
+    return key ^ (key >> 31);
+  }
+
+  void recordSampledAccess(const std::uint64_t key);
+
+  /**
+   * Adds delta at a position of the Fenwick tree.  Positions start at 1.
+   */
+  void treeAdd(std::uint64_t position, const int delta);
+
+  /**
+   * Returns the sum of the Fenwick tree over positions 1 to position.
+   */
+  std::uint64_t treeSum(std::uint64_t position) const;
+
+  /**
+   * Renumbers the last accesses of all tracked pages to 1, 2, ... once the
+   * tree is full, so the tree stays proportional to the tracked pages.
+   */
+  void compact();
+
+  double sampling_rate_;
+  std::uint64_t threshold_;
+  std::uint64_t accesses_;
+  std::uint64_t sampled_accesses_;
+
+  /**
+   * Logical time of each tracked page's last access.
+   */
+  std::unordered_map<std::uint64_t, std::uint64_t> last_access_;
+
+  /**
+   * Fenwick tree over logical time holding a 1 at the last access of every
+   * tracked page.  Element 0 is unused.
+   */
+  std::vector<std::uint32_t> tree_;
+
+  /**
+   * Logical time of the latest sampled access.
+   */
+  std::uint64_t now_;
+
+  /**
+   * Number of sampled accesses by unscaled reuse distance.
+   */
+  std::vector<std::uint64_t> distances_;
+};
+
+}
@@ -27,6 +27,9 @@ void Page::initialize() {
   header_.num_free_slots = 0;
   header_.current_page_number = INVALID_NUMBER;
   header_.next_page_number = INVALID_NUMBER;
+  header_.prev_page_number = INVALID_NUMBER;
+  header_.checksum = 0;
+  header_.lsn = 0;
   data_.assign(DATA_SIZE, char());
 }
 
@@ -57,6 +57,25 @@ struct PageHeader {
    */
   PageId next_page_number;
 
+  /**
+   * Number of the previous used page in the file.
+   */
+  PageId prev_page_number;
+
+  /**
+   * CRC-32C checksum of the page, set when the page is written to its file
+   * and verified when it is read back.  It covers the whole page except the
+   * checksum itself and the next and previous page numbers, which the file
+   * updates in place when neighbouring pages are deleted.
+   */
+  std::uint32_t checksum;
+
+  /**
+   * LSN of the last write-ahead log record applied to the page, or 0 if the
+   * page has never been logged.
+   */
+  Lsn lsn;
+
   /**
    * Returns true if this page header is equal to the other.
    *
@@ -67,7 +86,8 @@ struct PageHeader {
     return num_slots == rhs.num_slots &&
         num_free_slots == rhs.num_free_slots &&
         current_page_number == rhs.current_page_number &&
-        next_page_number == rhs.next_page_number;
+        next_page_number == rhs.next_page_number &&
+        prev_page_number == rhs.prev_page_number;
   }
 };
 
@@ -199,6 +219,20 @@ class Page {
    */
   PageId next_page_number() const { return header_.next_page_number; }
 
+  /**
+   * Returns the number of the used page before this page in its file.
+   *
+   * @return  Page number of previous used page in file.
+   */
+  PageId prev_page_number() const { return header_.prev_page_number; }
+
+  /**
+   * Returns the LSN of the last log record applied to this page.
+   *
+   * @return  LSN of page.
+   */
+  Lsn lsn() const { return header_.lsn; }
+
   /**
    * Returns an iterator at the first record in the page.
    *
@@ -238,6 +272,24 @@ class Page {
     header_.next_page_number = new_next_page_number;
   }
 
+  /**
+   * Sets the number of the used page before this page in its file.
+   *
+   * @param prev_page_number  Page number of previous used page in file.
+   */
+  void set_prev_page_number(const PageId new_prev_page_number) {
+    header_.prev_page_number = new_prev_page_number;
+  }
+
+  /**
+   * Sets the LSN of the last log record applied to this page.
+   *
+   * @param new_lsn   LSN of page.
+   */
+  void set_lsn(const Lsn new_lsn) {
+    header_.lsn = new_lsn;
+  }
+
   /**
    * Deletes the record with the given ID.  Page is compacted upon delete to
    * ensure that data of all records is contiguous.  Slot array is compacted if
@@ -333,6 +385,8 @@ class Page {
   std::string data_;
 
   friend class File;
+  friend class FreeSpaceMap;
+  friend class LogManager;
   friend class PageIterator;
   friend class PageTest;
   friend class BufferTest;
@@ -0,0 +1,87 @@
+/**
+ * @author See Contributors.txt for code contributors and overview of BadgerDB.
+ *
+ * @section LICENSE
+ * Copyright (c) 2012 Database Group, Computer Sciences Department, University of Wisconsin-Madison.
+ */
+
+#pragma once
+
+#include <cstdint>
+
+#include "types.h"
+
+namespace badgerdb {
+
+/**
+ * @brief Cost of one search for a victim frame.
+ */
+struct VictimSearchStats {
+  /**
+   * Number of frames the search examined.
+   */
+  std::uint64_t frames_examined;
+
+  /**
+   * Number of pinned frames the search passed over.
+   */
+  std::uint64_t pinned_skipped;
+};
+
+/**
+ * Finds a frame to hold a new page using the clock algorithm.  A frame that
+ * holds no page is taken immediately.  Otherwise, the hand sweeps the frames,
+ * clearing reference bits as it goes, and stops at the first unpinned frame
+ * whose reference bit is already clear.
+ *
+ * The search only picks the victim; writing it back and forgetting its page
+ * is up to the caller.  Both BufMgr and the trace-driven simulator use this
+ * function, so that simulated hit ratios match what BufMgr would get.
+ *
+ * Frames must provide:
+ * <pre>
+ *   std::uint32_t size() const;        // number of frames
+ *   bool valid(FrameId) const;         // frame holds a page
+ *   int pinCount(FrameId) const;
+ *   bool refbit(FrameId) const;
+ *   void clearRefbit(FrameId);
+ * </pre>
+ *
+ * @param frames  Frames to pick from.
+ * @param hand    Current position of the clock hand; advanced by the search.
+ * @param victim  Set to the frame picked.
+ * @param stats   Set to the cost of the search.
+ * @return  True if a victim was found; false if every frame is pinned.
+ */
+template <class Frames>
+bool clockFindVictim(Frames& frames, FrameId& hand, FrameId& victim,
+                     VictimSearchStats& stats) {
+  const std::uint32_t num_frames = frames.size();
+  std::uint32_t num_pinned = 0;
+  stats.frames_examined = 0;
+  stats.pinned_skipped = 0;
+  for (;;) {
+    hand = (hand + 1) % num_frames;
+    ++stats.frames_examined;
+
+    if (!frames.valid(hand)) {
+      victim = hand;
+      return true;
+    }
+    if (frames.refbit(hand)) {
+      // Recently referenced; give it another pass of the hand.
+      frames.clearRefbit(hand);
+      continue;
+    }
+    if (frames.pinCount(hand) == 0) {
+      victim = hand;
+      return true;
+    }
+    ++stats.pinned_skipped;
+    if (++num_pinned == num_frames) {
+      return false;
+    }
+  }
+}
+
+}
@@ -0,0 +1,60 @@
+/**
+ * @author See Contributors.txt for code contributors and overview of BadgerDB.
+ *
+ * @section LICENSE
+ * Copyright (c) 2012 Database Group, Computer Sciences Department, University of Wisconsin-Madison.
+ */
+
+#include "space_map.h"
+
+namespace badgerdb {
+
+const PageId SpaceMap::PAGES_PER_MAP_PAGE;
+const std::size_t SpaceMap::WORDS_PER_MAP_PAGE;
+
+void SpaceMap::resize(const PageId num_pages) {
+  const std::size_t groups =
+      (num_pages - 1 + PAGES_PER_MAP_PAGE - 1) / PAGES_PER_MAP_PAGE;
+  if (groups * WORDS_PER_MAP_PAGE > words_.size()) {
+    words_.resize(groups * WORDS_PER_MAP_PAGE, 0);
+  }
+}
+
+bool SpaceMap::isUsed(const PageId page_number) const {
+  if (page_number == Page::INVALID_NUMBER || isMapPage(page_number) ||
+      (page_number - 1) / 64 >= words_.size()) {
+    return false;
+  }
+  return (words_[(page_number - 1) / 64] & bitOf(page_number)) != 0;
+}
+
+PageId SpaceMap::findFree(const PageId num_pages) const {
+  for (std::size_t i = 0; i < words_.size(); ++i) {
+    if (words_[i] != ~std::uint64_t(0)) {
+      // Bits past the end of the file are clear, so the first clear bit
+      // found is either a free page or the end of the file.
+      const PageId page_number =
+          i * 64 + __builtin_ctzll(~words_[i]) + 1;
+      return page_number < num_pages ? page_number : Page::INVALID_NUMBER;
+    }
+  }
+  return Page::INVALID_NUMBER;
+}
+
+PageId SpaceMap::nextUsed(const PageId page_number) const {
+  // Bit page_number describes the page after page_number.
+  std::size_t i = page_number / 64;
+  if (i >= words_.size()) {
+    return Page::INVALID_NUMBER;
+  }
+  std::uint64_t word = usedWord(i) & (~std::uint64_t(0) << (page_number % 64));
+  while (word == 0) {
+    if (++i == words_.size()) {
+      return Page::INVALID_NUMBER;
+    }
+    word = usedWord(i);
+  }
+  return i * 64 + __builtin_ctzll(word) + 1;
+}
+
+}
@@ -0,0 +1,165 @@
+/**
+ * @author See Contributors.txt for code contributors and overview of BadgerDB.
+ *
+ * @section LICENSE
+ * Copyright (c) 2012 Database Group, Computer Sciences Department, University of Wisconsin-Madison.
+ */
+
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+#include "page.h"
+#include "types.h"
+
+namespace badgerdb {
+
+/**
+ * @brief In-memory copy of the allocation bitmap of a file which uses the
+ *        space map format.
+ *
+ * The pages of the file are divided into groups of PAGES_PER_MAP_PAGE.  The
+ * first page of each group is a map page whose contents are the bitmap of
+ * the group, one bit per page, set if the page is in use.  The bit of a map
+ * page itself is always set so that it is never handed out, but map pages
+ * are not reported as used.  An 8 KB page covers 512 MB of data.
+ *
+ * Bit i of the map describes page i + 1, so that the bitmap of every group
+ * starts on a word boundary and a map page is a slice of words().  The map
+ * is searched a 64-bit word at a time, skipping full or empty words without
+ * looking at their bits.
+ */
+class SpaceMap {
+ public:
+  /**
+   * Number of pages, including the map page, described by one map page.
+   */
+  static const PageId PAGES_PER_MAP_PAGE = Page::SIZE * 8;
+
+  /**
+   * Number of 64-bit words in one map page.
+   */
+  static const std::size_t WORDS_PER_MAP_PAGE =
+      Page::SIZE / sizeof(std::uint64_t);
+
+  /**
+   * Returns true if the page with the given number is a map page.
+   *
+   * @param page_number   Number of page.
+   */
+  static bool isMapPage(const PageId page_number) {
+    return page_number != Page::INVALID_NUMBER &&
+        (page_number - 1) % PAGES_PER_MAP_PAGE == 0;
+  }
+
+  /**
+   * Returns the number of the map page which describes the given page.
+   *
+   * @param page_number   Number of page.
+   * @return  Number of map page.
+   */
+  static PageId mapPageOf(const PageId page_number) {
+    return page_number - (page_number - 1) % PAGES_PER_MAP_PAGE;
+  }
+
+  /**
+   * Grows the map to cover the given number of pages (including the header
+   * page).  New pages are free.
+   *
+   * @param num_pages   Number of pages in the file.
+   */
+  void resize(const PageId num_pages);
+
+  /**
+   * Returns true if the given page is in use and is not a map page.
+   *
+   * @param page_number   Number of page.
+   */
+  bool isUsed(const PageId page_number) const;
+
+  /**
+   * Marks the given page as in use.
+   *
+   * @param page_number   Number of page.
+   */
+  void set(const PageId page_number) {
+    words_[(page_number - 1) / 64] |= bitOf(page_number);
+  }
+
+  /**
+   * Marks the given page as free.
+   *
+   * @param page_number   Number of page.
+   */
+  void clear(const PageId page_number) {
+    words_[(page_number - 1) / 64] &= ~bitOf(page_number);
+  }
+
+  /**
+   * Returns the lowest numbered free page before the end of the file.
+   *
+   * @param num_pages   Number of pages in the file.
+   * @return  Number of free page, or Page::INVALID_NUMBER if there is none.
+   */
+  PageId findFree(const PageId num_pages) const;
+
+  /**
+   * Returns the lowest numbered used page after the given page.
+   *
+   * @param page_number   Number of page to search after, or
+   *                      Page::INVALID_NUMBER to search from the start.
+   * @return  Number of used page, or Page::INVALID_NUMBER if there is none.
+   */
+  PageId nextUsed(const PageId page_number) const;
+
+  /**
+   * Returns the byte offset, within its map page, of the word holding the
+   * bit of the given page.
+   *
+   * @param page_number   Number of page.
+   */
+  static std::size_t wordOffset(const PageId page_number) {
+    return ((page_number - 1) % PAGES_PER_MAP_PAGE) / 64 *
+        sizeof(std::uint64_t);
+  }
+
+  /**
+   * Returns the word holding the bit of the given page.
+   *
+   * @param page_number   Number of page.
+   */
+  std::uint64_t wordOf(const PageId page_number) const {
+    return words_[(page_number - 1) / 64];
+  }
+
+  /**
+   * Returns the bitmap stored in the given map page.
+   *
+   * @param map_page  Number of map page.
+   * @return  WORDS_PER_MAP_PAGE words.
+   */
+  std::uint64_t* mapPageWords(const PageId map_page) {
+    return &words_[(map_page - 1) / 64];
+  }
+
+ private:
+  static std::uint64_t bitOf(const PageId page_number) {
+    return std::uint64_t(1) << ((page_number - 1) % 64);
+  }
+
+  /**
+   * Returns word i of the map without the bits of map pages.
+   */
+  std::uint64_t usedWord(const std::size_t i) const {
+    return i % WORDS_PER_MAP_PAGE == 0 ? words_[i] & ~std::uint64_t(1)
+                                       : words_[i];
+  }
+
+  /**
+   * Bitmap of all groups of the file, WORDS_PER_MAP_PAGE words per group.
+   */
+  std::vector<std::uint64_t> words_;
+};
+
+}
@@ -0,0 +1,465 @@
+/**
+ * @author See Contributors.txt for code contributors and overview of BadgerDB.
+ *
+ * @section LICENSE
+ * Copyright (c) 2012 Database Group, Computer Sciences Department, University of Wisconsin-Madison.
+ */
+
+/**
+ * Microbenchmarks of the buffer manager and page hot paths.
+ *
+ * Every benchmark is run for a few warmup repetitions, whose results are
+ * thrown away, and then for a number of measured repetitions.  For each one
+ * the mean time per operation is printed together with the half-width of its
+ * 95% confidence interval and the fastest repetition.  Only the operation
+ * being measured is timed; setup such as unpinning the pages a read pinned
+ * happens outside the timed region.
+ *
+ * Page reads and writes go through the OS page cache, so misses measure the
+ * buffer manager and file layer rather than the storage device, unless
+ * --device emulates the latency of one.  With --in-memory the file never
+ * reaches the operating system at all.
+ *
+ * Usage:
+ *   badgerdb_bench [--reps N] [--warmup N] [--frames N] [--ops N]
+ *                  [--filter SUBSTRING] [--device nvme|sata|hdd]
+ *                  [--in-memory yes|no]
+ */
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <functional>
+#include <iomanip>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "buffer.h"
+#include "cycle_clock.h"
+#include "file.h"
+#include "latency_backend.h"
+#include "page.h"
+#include "exceptions/file_not_found_exception.h"
+
+using namespace badgerdb;
+
+namespace {
+
+/**
+ * Name of the scratch file the benchmarks use.
+ */
+const char* const BENCH_FILE = "bench.db";
+
+/**
+ * Size of the records used by the page benchmarks.
+ */
+const std::size_t RECORD_SIZE = 64;
+
+/**
+ * Whether the scratch file is kept in memory, leaving only CPU cost.
+ */
+bool in_memory_files = false;
+
+/**
+ * Accumulates the cycles spent in timed regions.
+ */
+class Timer {
+ public:
+  Timer() : start_(0), elapsed_(0) {}
+  void start() { start_ = readCycleCounter(); }
+  void stop() { elapsed_ += readCycleCounter() - start_; }
+  std::uint64_t elapsed() const { return elapsed_; }
+
+ private:
+  std::uint64_t start_;
+  std::uint64_t elapsed_;
+};
+
+/**
+ * A buffer manager over a freshly created file of a given number of pages.
+ */
+class Fixture {
+ public:
+  Fixture(const std::uint32_t frames, const std::uint32_t pages) {
+    try {
+      File::remove(BENCH_FILE);
+    } catch (FileNotFoundException) {
+    }
+    file_.reset(new File(File::create(BENCH_FILE, in_memory_files)));
+    for (std::uint32_t i = 0; i < pages; ++i) {
+      file_->allocatePage();
+    }
+    buf_mgr_.reset(new BufMgr(frames));
+  }
+
+  ~Fixture() {
+    // The buffer manager writes dirty pages back to the file when destroyed.
+    buf_mgr_.reset();
+    file_.reset();
+    File::remove(BENCH_FILE);
+  }
+
+  File* file() { return file_.get(); }
+  BufMgr* bufMgr() { return buf_mgr_.get(); }
+
+ private:
+  std::unique_ptr<File> file_;
+  std::unique_ptr<BufMgr> buf_mgr_;
+};
+
+/**
+ * Runs one repetition of a benchmark: performs about the requested number of
+ * operations, timing only the operations themselves, and returns the number
+ * actually performed.
+ */
+typedef std::function<std::uint64_t(std::uint64_t ops, Timer& timer)>
+    RepetitionFunction;
+
+/**
+ * A benchmark and the number of operations in one of its repetitions.
+ */
+struct Benchmark {
+  std::string name;
+  std::uint64_t ops;
+  std::function<RepetitionFunction(std::uint32_t frames)> setup;
+};
+
+/**
+ * Two-sided 95% quantiles of Student's t distribution by degrees of freedom.
+ */
+double tQuantile95(const std::uint64_t degrees) {
+  static const double kTable[] = {
+      0,     12.706, 4.303, 3.182, 2.776, 2.571, 2.447, 2.365, 2.306, 2.262,
+      2.228, 2.201,  2.179, 2.160, 2.145, 2.131, 2.120, 2.110, 2.101, 2.093,
+      2.086, 2.080,  2.074, 2.069, 2.064, 2.060, 2.056, 2.052, 2.048, 2.045,
+      2.042};
+  if (degrees < sizeof(kTable) / sizeof(kTable[0])) {
+    return kTable[degrees];
+  }
+  return 1.96;
+}
+
+std::string recordOfSize(const std::size_t size) {
+  return std::string(size, 'r');
+}
+
+/**
+ * Reads every page of the file once so that all of them are resident.
+ */
+void warmPool(Fixture* fixture, const std::uint32_t pages) {
+  Page* page;
+  for (PageId p = 1; p <= pages; ++p) {
+    fixture->bufMgr()->readPage(fixture->file(), p, page);
+    fixture->bufMgr()->unPinPage(fixture->file(), p, false);
+  }
+}
+
+RepetitionFunction setupReadHit(const std::uint32_t frames) {
+  std::shared_ptr<Fixture> fixture(new Fixture(frames, frames));
+  warmPool(fixture.get(), frames);
+  return [fixture, frames](std::uint64_t ops, Timer& timer) {
+    Page* page;
+    timer.start();
+    for (std::uint64_t i = 0; i < ops; ++i) {
+      fixture->bufMgr()->readPage(fixture->file(), i % frames + 1, page);
+    }
+    timer.stop();
+    for (std::uint64_t i = 0; i < ops; ++i) {
+      fixture->bufMgr()->unPinPage(fixture->file(), i % frames + 1, false);
+    }
+    return ops;
+  };
+}
+
+RepetitionFunction setupUnpin(const std::uint32_t frames) {
+  std::shared_ptr<Fixture> fixture(new Fixture(frames, frames));
+  warmPool(fixture.get(), frames);
+  return [fixture, frames](std::uint64_t ops, Timer& timer) {
+    Page* page;
+    for (std::uint64_t i = 0; i < ops; ++i) {
+      fixture->bufMgr()->readPage(fixture->file(), i % frames + 1, page);
+    }
+    timer.start();
+    for (std::uint64_t i = 0; i < ops; ++i) {
+      fixture->bufMgr()->unPinPage(fixture->file(), i % frames + 1, false);
+    }
+    timer.stop();
+    return ops;
+  };
+}
+
+/**
+ * Cycles through twice as many pages as there are frames, so that the clock
+ * policy misses on every read.  With dirty set, every victim has to be
+ * written back first.
+ */
+RepetitionFunction setupReadMiss(const std::uint32_t frames,
+                                 const bool dirty) {
+  const std::uint32_t pages = 2 * frames;
+  std::shared_ptr<Fixture> fixture(new Fixture(frames, pages));
+  std::shared_ptr<PageId> next(new PageId(0));
+  return [fixture, pages, dirty, next](std::uint64_t ops, Timer& timer) {
+    Page* page;
+    for (std::uint64_t i = 0; i < ops; ++i) {
+      const PageId page_no = *next % pages + 1;
+      ++*next;
+      timer.start();
+      fixture->bufMgr()->readPage(fixture->file(), page_no, page);
+      timer.stop();
+      fixture->bufMgr()->unPinPage(fixture->file(), page_no, dirty);
+    }
+    return ops;
+  };
+}
+
+/**
+ * Each repetition starts from a new, empty file, since allocation and
+ * deletion cost depends on how long the page lists of the file are.
+ */
+RepetitionFunction setupAlloc(const std::uint32_t frames) {
+  std::shared_ptr<std::unique_ptr<Fixture> > fixture(
+      new std::unique_ptr<Fixture>);
+  return [fixture, frames](std::uint64_t ops, Timer& timer) {
+    fixture->reset();
+    fixture->reset(new Fixture(frames, 0));
+    Page* page;
+    PageId page_no;
+    for (std::uint64_t i = 0; i < ops; ++i) {
+      timer.start();
+      (*fixture)->bufMgr()->allocPage((*fixture)->file(), page_no, page);
+      timer.stop();
+      (*fixture)->bufMgr()->unPinPage((*fixture)->file(), page_no, false);
+    }
+    return ops;
+  };
+}
+
+RepetitionFunction setupDispose(const std::uint32_t frames) {
+  std::shared_ptr<std::unique_ptr<Fixture> > fixture(
+      new std::unique_ptr<Fixture>);
+  return [fixture, frames](std::uint64_t ops, Timer& timer) {
+    fixture->reset();
+    fixture->reset(new Fixture(frames, 0));
+    Page* page;
+    std::vector<PageId> page_nos(ops);
+    for (std::uint64_t i = 0; i < ops; ++i) {
+      (*fixture)->bufMgr()->allocPage((*fixture)->file(), page_nos[i], page);
+      (*fixture)->bufMgr()->unPinPage((*fixture)->file(), page_nos[i], false);
+    }
+    timer.start();
+    for (std::uint64_t i = 0; i < ops; ++i) {
+      (*fixture)->bufMgr()->disposePage((*fixture)->file(), page_nos[i]);
+    }
+    timer.stop();
+    return ops;
+  };
+}
+
+/**
+ * Each operation flushes a file whose pages fill the pool and are all dirty.
+ */
+RepetitionFunction setupFlush(const std::uint32_t frames) {
+  std::shared_ptr<Fixture> fixture(new Fixture(frames, frames));
+  return [fixture, frames](std::uint64_t ops, Timer& timer) {
+    Page* page;
+    for (std::uint64_t i = 0; i < ops; ++i) {
+      for (PageId p = 1; p <= frames; ++p) {
+        fixture->bufMgr()->readPage(fixture->file(), p, page);
+        fixture->bufMgr()->unPinPage(fixture->file(), p, true);
+      }
+      timer.start();
+      fixture->bufMgr()->flushFile(fixture->file());
+      timer.stop();
+    }
+    return ops;
+  };
+}
+
+RepetitionFunction setupInsertRecord(const std::uint32_t) {
+  const std::string record = recordOfSize(RECORD_SIZE);
+  return [record](std::uint64_t ops, Timer& timer) {
+    std::uint64_t done = 0;
+    while (done < ops) {
+      Page page;
+      timer.start();
+      while (page.hasSpaceForRecord(record)) {
+        page.insertRecord(record);
+        ++done;
+      }
+      timer.stop();
+    }
+    return done;
+  };
+}
+
+RepetitionFunction setupGetRecord(const std::uint32_t) {
+  const std::string record = recordOfSize(RECORD_SIZE);
+  std::shared_ptr<Page> page(new Page);
+  std::shared_ptr<std::vector<RecordId> > record_ids(
+      new std::vector<RecordId>);
+  while (page->hasSpaceForRecord(record)) {
+    record_ids->push_back(page->insertRecord(record));
+  }
+  return [page, record_ids](std::uint64_t ops, Timer& timer) {
+    std::size_t total_size = 0;
+    timer.start();
+    for (std::uint64_t i = 0; i < ops; ++i) {
+      total_size +=
+          page->getRecord((*record_ids)[i % record_ids->size()]).size();
+    }
+    timer.stop();
+    if (total_size != ops * RECORD_SIZE) {
+      std::cerr << "getRecord returned records of the wrong size\n";
+    }
+    return ops;
+  };
+}
+
+RepetitionFunction setupDeleteRecord(const std::uint32_t) {
+  const std::string record = recordOfSize(RECORD_SIZE);
+  return [record](std::uint64_t ops, Timer& timer) {
+    std::uint64_t done = 0;
+    std::vector<RecordId> record_ids;
+    while (done < ops) {
+      Page page;
+      record_ids.clear();
+      while (page.hasSpaceForRecord(record)) {
+        record_ids.push_back(page.insertRecord(record));
+      }
+      timer.start();
+      for (std::size_t i = 0; i < record_ids.size(); ++i) {
+        page.deleteRecord(record_ids[i]);
+      }
+      timer.stop();
+      done += record_ids.size();
+    }
+    return done;
+  };
+}
+
+std::vector<Benchmark> allBenchmarks() {
+  std::vector<Benchmark> benchmarks;
+  Benchmark list[] = {
+      {"readPage/hit", 100000, setupReadHit},
+      {"readPage/miss-clean", 5000,
+       [](std::uint32_t frames) { return setupReadMiss(frames, false); }},
+      {"readPage/miss-dirty", 5000,
+       [](std::uint32_t frames) { return setupReadMiss(frames, true); }},
+      {"allocPage", 1000, setupAlloc},
+      {"unPinPage", 100000, setupUnpin},
+      {"disposePage", 1000, setupDispose},
+      {"flushFile", 50, setupFlush},
+      {"Page::insertRecord", 100000, setupInsertRecord},
+      {"Page::getRecord", 100000, setupGetRecord},
+      {"Page::deleteRecord", 100000, setupDeleteRecord},
+  };
+  benchmarks.assign(list, list + sizeof(list) / sizeof(list[0]));
+  return benchmarks;
+}
+
+void usage() {
+  std::cerr << "Usage: badgerdb_bench [--reps N] [--warmup N] [--frames N]"
+            << " [--ops N]\n"
+            << "         [--filter SUBSTRING] [--device nvme|sata|hdd]\n"
+            << "         [--in-memory yes|no]\n";
+}
+
+}
+
+int main(int argc, char* argv[]) {
+  std::uint64_t reps = 10;
+  std::uint64_t warmup = 2;
+  std::uint32_t frames = 64;
+  std::uint64_t ops = 0;
+  std::string filter;
+
+  for (int i = 1; i < argc; ++i) {
+    const std::string arg = argv[i];
+    if (i + 1 >= argc) {
+      usage();
+      return 1;
+    }
+    const std::string value = argv[++i];
+    if (arg == "--reps") {
+      reps = std::strtoull(value.c_str(), NULL, 10);
+    } else if (arg == "--warmup") {
+      warmup = std::strtoull(value.c_str(), NULL, 10);
+    } else if (arg == "--frames") {
+      frames = std::strtoul(value.c_str(), NULL, 10);
+    } else if (arg == "--ops") {
+      ops = std::strtoull(value.c_str(), NULL, 10);
+    } else if (arg == "--filter") {
+      filter = value;
+    } else if (arg == "--device") {
+      LatencyProfile profile;
+      if (!LatencyProfile::byName(value, profile)) {
+        usage();
+        return 1;
+      }
+      File::setBackendDecorator(LatencyBackend::decorator(profile));
+    } else if (arg == "--in-memory") {
+      in_memory_files = value == "yes";
+    } else {
+      usage();
+      return 1;
+    }
+  }
+  if (reps == 0 || frames == 0) {
+    usage();
+    return 1;
+  }
+
+  const double cycles_per_ns = cyclesPerNanosecond();
+  std::cout << std::left << std::setw(22) << "benchmark" << std::right
+            << std::setw(12) << "ns/op" << std::setw(12) << "+-95%"
+            << std::setw(12) << "min" << std::setw(12) << "ops/rep"
+            << std::endl;
+
+  const std::vector<Benchmark> benchmarks = allBenchmarks();
+  for (std::size_t b = 0; b < benchmarks.size(); ++b) {
+    const Benchmark& benchmark = benchmarks[b];
+    if (!filter.empty() && benchmark.name.find(filter) == std::string::npos) {
+      continue;
+    }
+    const std::uint64_t rep_ops = ops != 0 ? ops : benchmark.ops;
+    RepetitionFunction repetition = benchmark.setup(frames);
+
+    std::vector<double> ns_per_op;
+    std::uint64_t ops_done = 0;
+    for (std::uint64_t r = 0; r < warmup + reps; ++r) {
+      Timer timer;
+      ops_done = repetition(rep_ops, timer);
+      if (r >= warmup) {
+        ns_per_op.push_back(timer.elapsed() / cycles_per_ns / ops_done);
+      }
+    }
+    // Destroys the fixture before the next benchmark creates its own.
+    repetition = RepetitionFunction();
+
+    double mean = 0;
+    for (std::size_t i = 0; i < ns_per_op.size(); ++i) {
+      mean += ns_per_op[i];
+    }
+    mean /= ns_per_op.size();
+    double variance = 0;
+    for (std::size_t i = 0; i < ns_per_op.size(); ++i) {
+      variance += (ns_per_op[i] - mean) * (ns_per_op[i] - mean);
+    }
+    const double half_width =
+        ns_per_op.size() < 2
+            ? 0.0
+            : tQuantile95(ns_per_op.size() - 1) *
+                  std::sqrt(variance / (ns_per_op.size() - 1)) /
+                  std::sqrt(static_cast<double>(ns_per_op.size()));
+
+    std::cout << std::left << std::setw(22) << benchmark.name << std::right
+              << std::fixed << std::setprecision(1) << std::setw(12) << mean
+              << std::setw(12) << half_width << std::setw(12)
+              << *std::min_element(ns_per_op.begin(), ns_per_op.end())
+              << std::setw(12) << ops_done << std::endl;
+  }
+  return 0;
+}
@@ -0,0 +1,388 @@
+/**
+ * @author See Contributors.txt for code contributors and overview of BadgerDB.
+ *
+ * @section LICENSE
+ * Copyright (c) 2012 Database Group, Computer Sciences Department, University of Wisconsin-Madison.
+ */
+
+/**
+ * Trace-driven simulator of the buffer pool.
+ *
+ * Replays a page-access trace recorded by AccessTracer, or a synthetic one,
+ * through the victim selection BufMgr uses, for a range of pool sizes, and
+ * reports hit ratio, write-backs and victim search cost for each.  No pages
+ * are read or written, so sweeping many sizes over a long trace is fast.
+ *
+ * Usage:
+ *   badgerdb_sim [--trace FILE]
+ *                [--synthetic uniform|zipfian|scan] [--pages N]
+ *                [--accesses N] [--theta T] [--write-ratio R] [--seed S]
+ *                [--sizes N,N,...] [--min-frames N] [--max-frames N]
+ *                [--policy clock]
+ */
+
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+#include <iomanip>
+#include <iostream>
+#include <random>
+#include <sstream>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "access_trace.h"
+#include "replacement_policy.h"
+#include "exceptions/file_not_found_exception.h"
+#include "tools/key_distributions.h"
+
+using namespace badgerdb;
+
+namespace {
+
+/**
+ * One page access to replay.
+ */
+struct SimEvent {
+  TraceOp op;
+  std::uint64_t key;
+  bool dirty;
+};
+
+/**
+ * Results of replaying a trace with one pool size.
+ */
+struct SimResult {
+  std::uint32_t frames;
+  std::uint64_t reads;
+  std::uint64_t hits;
+  std::uint64_t writebacks;
+  std::uint64_t victim_searches;
+  std::uint64_t frames_examined;
+  std::uint64_t pinned_stalls;
+};
+
+/**
+ * Frame of the simulated buffer pool.
+ */
+struct SimFrame {
+  std::uint64_t key;
+  bool valid;
+  int pin_count;
+  bool refbit;
+  bool dirty;
+};
+
+/**
+ * Frames of the simulated pool in the form clockFindVictim() expects.
+ */
+class SimFrames {
+ public:
+  explicit SimFrames(std::vector<SimFrame>* frames) : frames_(frames) {}
+  std::uint32_t size() const { return frames_->size(); }
+  bool valid(FrameId frame) const { return (*frames_)[frame].valid; }
+  int pinCount(FrameId frame) const { return (*frames_)[frame].pin_count; }
+  bool refbit(FrameId frame) const { return (*frames_)[frame].refbit; }
+  void clearRefbit(FrameId frame) { (*frames_)[frame].refbit = false; }
+
+ private:
+  std::vector<SimFrame>* frames_;
+};
+
+/**
+ * Replacement policies the simulator can replay with.  New policies are added
+ * here and in Simulator::findVictim().
+ */
+enum Policy {
+  POLICY_CLOCK
+};
+
+/**
+ * Buffer pool without data: tracks which page each frame holds and replays
+ * accesses against it.
+ */
+class Simulator {
+ public:
+  Simulator(const std::uint32_t num_frames, const Policy policy)
+      : frames_(num_frames), hand_(num_frames - 1), policy_(policy) {
+    SimFrame empty = {0, false, 0, false, false};
+    std::fill(frames_.begin(), frames_.end(), empty);
+    std::memset(&result_, 0, sizeof(result_));
+    result_.frames = num_frames;
+  }
+
+  void replay(const SimEvent& event) {
+    std::unordered_map<std::uint64_t, FrameId>::iterator resident =
+        page_table_.find(event.key);
+    switch (event.op) {
+      case TRACE_READ:
+        ++result_.reads;
+        if (resident != page_table_.end()) {
+          ++result_.hits;
+          SimFrame& frame = frames_[resident->second];
+          frame.refbit = true;
+          ++frame.pin_count;
+        } else {
+          load(event.key);
+        }
+        break;
+      case TRACE_ALLOC:
+        if (resident == page_table_.end()) {
+          load(event.key);
+        }
+        break;
+      case TRACE_UNPIN:
+        if (resident != page_table_.end()) {
+          SimFrame& frame = frames_[resident->second];
+          if (frame.pin_count > 0) {
+            --frame.pin_count;
+          }
+          frame.dirty = frame.dirty || event.dirty;
+        }
+        break;
+      case TRACE_DISPOSE:
+        if (resident != page_table_.end()) {
+          frames_[resident->second].valid = false;
+          page_table_.erase(resident);
+        }
+        break;
+    }
+  }
+
+  const SimResult& result() const { return result_; }
+
+ private:
+  bool findVictim(FrameId& victim) {
+    VictimSearchStats search = {0, 0};
+    bool found = false;
+    switch (policy_) {
+      case POLICY_CLOCK: {
+        SimFrames frames(&frames_);
+        found = clockFindVictim(frames, hand_, victim, search);
+        break;
+      }
+    }
+    ++result_.victim_searches;
+    result_.frames_examined += search.frames_examined;
+    return found;
+  }
+
+  void load(const std::uint64_t key) {
+    FrameId victim;
+    if (!findVictim(victim)) {
+      // BufMgr would throw BufferExceededException here.
+      ++result_.pinned_stalls;
+      return;
+    }
+    SimFrame& frame = frames_[victim];
+    if (frame.valid) {
+      if (frame.dirty) {
+        ++result_.writebacks;
+      }
+      page_table_.erase(frame.key);
+    }
+    frame.key = key;
+    frame.valid = true;
+    frame.pin_count = 1;
+    frame.refbit = true;
+    frame.dirty = false;
+    page_table_[key] = victim;
+  }
+
+  std::vector<SimFrame> frames_;
+  std::unordered_map<std::uint64_t, FrameId> page_table_;
+  FrameId hand_;
+  Policy policy_;
+  SimResult result_;
+};
+
+std::uint64_t makeKey(const std::uint32_t file, const PageId page) {
+  return (static_cast<std::uint64_t>(file) << 32) | page;
+}
+
+/**
+ * Reads a recorded trace, ordering the events of all threads by time.
+ */
+std::vector<SimEvent> loadTrace(const std::string& path) {
+  std::vector<TraceEvent> recorded;
+  AccessTraceReader reader(path);
+  TraceEvent event;
+  while (reader.next(event)) {
+    recorded.push_back(event);
+  }
+  std::stable_sort(recorded.begin(), recorded.end(),
+                   [](const TraceEvent& a, const TraceEvent& b) {
+                     return a.record.timestamp < b.record.timestamp;
+                   });
+
+  // File numbers are per trace; names identify files across traces.
+  std::unordered_map<std::string, std::uint32_t> file_numbers;
+  std::vector<SimEvent> events;
+  events.reserve(recorded.size());
+  for (std::size_t i = 0; i < recorded.size(); ++i) {
+    const std::uint32_t file = file_numbers.insert(
+        std::make_pair(recorded[i].filename, file_numbers.size())).first->second;
+    SimEvent sim_event = {static_cast<TraceOp>(recorded[i].record.op),
+                          makeKey(file, recorded[i].record.page),
+                          (recorded[i].record.flags & TRACE_DIRTY) != 0};
+    events.push_back(sim_event);
+  }
+  return events;
+}
+
+/**
+ * Generates a read-and-unpin trace over one file.
+ */
+std::vector<SimEvent> makeSyntheticTrace(const std::string& distribution,
+                                         const std::uint64_t pages,
+                                         const std::uint64_t accesses,
+                                         const double theta,
+                                         const double write_ratio,
+                                         const std::uint64_t seed) {
+  std::mt19937_64 rng(seed);
+  std::uniform_real_distribution<double> coin(0.0, 1.0);
+  std::uniform_int_distribution<std::uint64_t> uniform(0, pages - 1);
+  ZipfianGenerator zipfian(distribution == "zipfian" ? pages : 2, theta,
+                           true /* scrambled */);
+
+  std::vector<SimEvent> events;
+  events.reserve(2 * accesses);
+  for (std::uint64_t i = 0; i < accesses; ++i) {
+    std::uint64_t page;
+    if (distribution == "zipfian") {
+      page = zipfian.next(rng);
+    } else if (distribution == "scan") {
+      page = i % pages;
+    } else {
+      page = uniform(rng);
+    }
+    const std::uint64_t key = makeKey(0, page + 1);
+    SimEvent read = {TRACE_READ, key, false};
+    SimEvent unpin = {TRACE_UNPIN, key, coin(rng) < write_ratio};
+    events.push_back(read);
+    events.push_back(unpin);
+  }
+  return events;
+}
+
+std::vector<std::uint32_t> parseSizes(const std::string& list) {
+  std::vector<std::uint32_t> sizes;
+  std::stringstream ss(list);
+  std::string item;
+  while (std::getline(ss, item, ',')) {
+    sizes.push_back(std::strtoul(item.c_str(), NULL, 10));
+  }
+  return sizes;
+}
+
+void usage() {
+  std::cerr << "Usage: badgerdb_sim [--trace FILE]\n"
+            << "         [--synthetic uniform|zipfian|scan] [--pages N]\n"
+            << "         [--accesses N] [--theta T] [--write-ratio R]"
+            << " [--seed S]\n"
+            << "         [--sizes N,N,...] [--min-frames N] [--max-frames N]\n"
+            << "         [--policy clock]\n";
+}
+
+}
+
+int main(int argc, char* argv[]) {
+  std::string trace_path;
+  std::string distribution = "zipfian";
+  std::uint64_t pages = 10000;
+  std::uint64_t accesses = 1000000;
+  double theta = 0.99;
+  double write_ratio = 0.1;
+  std::uint64_t seed = 42;
+  std::vector<std::uint32_t> sizes;
+  std::uint32_t min_frames = 16;
+  std::uint32_t max_frames = 0;
+  Policy policy = POLICY_CLOCK;
+
+  for (int i = 1; i < argc; ++i) {
+    const std::string arg = argv[i];
+    if (i + 1 >= argc) {
+      usage();
+      return 1;
+    }
+    const std::string value = argv[++i];
+    if (arg == "--trace") {
+      trace_path = value;
+    } else if (arg == "--synthetic") {
+      distribution = value;
+    } else if (arg == "--pages") {
+      pages = std::strtoull(value.c_str(), NULL, 10);
+    } else if (arg == "--accesses") {
+      accesses = std::strtoull(value.c_str(), NULL, 10);
+    } else if (arg == "--theta") {
+      theta = std::strtod(value.c_str(), NULL);
+    } else if (arg == "--write-ratio") {
+      write_ratio = std::strtod(value.c_str(), NULL);
+    } else if (arg == "--seed") {
+      seed = std::strtoull(value.c_str(), NULL, 10);
+    } else if (arg == "--sizes") {
+      sizes = parseSizes(value);
+    } else if (arg == "--min-frames") {
+      min_frames = std::strtoul(value.c_str(), NULL, 10);
+    } else if (arg == "--max-frames") {
+      max_frames = std::strtoul(value.c_str(), NULL, 10);
+    } else if (arg == "--policy" && value == "clock") {
+      policy = POLICY_CLOCK;
+    } else {
+      usage();
+      return 1;
+    }
+  }
+
+  std::vector<SimEvent> events;
+  try {
+    events = trace_path.empty()
+        ? makeSyntheticTrace(distribution, pages, accesses, theta, write_ratio,
+                             seed)
+        : loadTrace(trace_path);
+  } catch (const FileNotFoundException& e) {
+    std::cerr << "Cannot read trace " << trace_path << "\n";
+    return 1;
+  }
+
+  if (sizes.empty()) {
+    // Default sweep: doubling pool sizes up to the number of distinct pages.
+    if (max_frames == 0) {
+      std::unordered_map<std::uint64_t, bool> distinct;
+      for (std::size_t i = 0; i < events.size(); ++i) {
+        distinct[events[i].key] = true;
+      }
+      max_frames = distinct.size() > min_frames ? distinct.size() : min_frames;
+    }
+    for (std::uint64_t size = min_frames; size <= max_frames; size *= 2) {
+      sizes.push_back(size);
+    }
+  }
+
+  std::cout << std::setw(10) << "frames" << std::setw(12) << "reads"
+            << std::setw(10) << "hit%" << std::setw(12) << "writebacks"
+            << std::setw(16) << "examined/search" << std::setw(10)
+            << "stalls" << "\n";
+  for (std::size_t s = 0; s < sizes.size(); ++s) {
+    if (sizes[s] == 0) {
+      continue;
+    }
+    Simulator simulator(sizes[s], policy);
+    for (std::size_t i = 0; i < events.size(); ++i) {
+      simulator.replay(events[i]);
+    }
+    const SimResult& result = simulator.result();
+    std::cout << std::setw(10) << result.frames << std::setw(12)
+              << result.reads << std::setw(10) << std::fixed
+              << std::setprecision(2)
+              << (result.reads == 0 ? 0.0 : 100.0 * result.hits / result.reads)
+              << std::setw(12) << result.writebacks << std::setw(16)
+              << (result.victim_searches == 0
+                      ? 0.0
+                      : static_cast<double>(result.frames_examined) /
+                            result.victim_searches)
+              << std::setw(10) << result.pinned_stalls << "\n";
+  }
+  return 0;
+}
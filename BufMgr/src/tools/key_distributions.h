@@ -0,0 +1,96 @@
+/**
+ * @author See Contributors.txt for code contributors and overview of BadgerDB.
+ *
+ * @section LICENSE
+ * Copyright (c) 2012 Database Group, Computer Sciences Department, University of Wisconsin-Madison.
+ */
+
+#pragma once
+
+#include <cmath>
+#include <cstdint>
+#include <random>
+
+namespace badgerdb {
+
+/**
+ * @brief Generates keys in [0, items) following a Zipfian distribution.
+ *
+ * This is the generator of Gray et al., "Quickly Generating Billion-Record
+ * Synthetic Databases", as used by YCSB.  Key 0 is the most popular.  With
+ * <code>scrambled</code> set, popular keys are scattered over the key space
+ * by hashing instead of being clustered at the start.
+ */
+class ZipfianGenerator {
+ public:
+  /**
+   * Constructs a generator.  Takes time linear in the number of items.
+   *
+   * @param items       Number of distinct keys.
+   * @param theta       Skew; 0 is uniform and values close to 1 are very
+   *                    skewed.  Must not be 1.
+   * @param scrambled   Whether to scatter popular keys over the key space.
+   */
+  ZipfianGenerator(const std::uint64_t items, const double theta,
+                   const bool scrambled)
+      : items_(items), theta_(theta), scrambled_(scrambled) {
+    zetan_ = zeta(items_, theta_);
+    const double zeta2 = zeta(2, theta_);
+    alpha_ = 1.0 / (1.0 - theta_);
+    eta_ = (1.0 - std::pow(2.0 / items_, 1.0 - theta_)) /
+        (1.0 - zeta2 / zetan_);
+  }
+
+  /**
+   * Returns the next key.
+   *
+   * @param rng   Source of randomness.
+   * @return  Key in [0, items).
+   */
+  template <class Rng>
+  std::uint64_t next(Rng& rng) {
+    const double u = std::uniform_real_distribution<double>(0.0, 1.0)(rng);
+    const double uz = u * zetan_;
+    std::uint64_t key;
+    if (uz < 1.0) {
+      key = 0;
+    } else if (uz < 1.0 + std::pow(0.5, theta_)) {
+      key = 1;
+    } else {
+      key = static_cast<std::uint64_t>(
+          items_ * std::pow(eta_ * u - eta_ + 1.0, alpha_));
+      if (key >= items_) {
+        key = items_ - 1;
+      }
+    }
+    return scrambled_ ? fnvHash(key) % items_ : key;
+  }
+
+ private:
+  static double zeta(const std::uint64_t n, const double theta) {
+    double sum = 0;
+    for (std::uint64_t i = 1; i <= n; ++i) {
+      sum += 1.0 / std::pow(static_cast<double>(i), theta);
+    }
+    return sum;
+  }
+
+  static std::uint64_t fnvHash(std::uint64_t value) {
+    std::uint64_t hash = 0xcbf29ce484222325ULL;
+    for (int i = 0; i < 8; ++i) {
+      hash ^= value & 0xff;
+      hash *= 0x100000001b3ULL;
+      value >>= 8;
+    }
+    return hash;
+  }
+
+  std::uint64_t items_;
+  double theta_;
+  bool scrambled_;
+  double zetan_;
+  double alpha_;
+  double eta_;
+};
+
+}
@@ -0,0 +1,516 @@
+/**
+ * @author See Contributors.txt for code contributors and overview of BadgerDB.
+ *
+ * @section LICENSE
+ * Copyright (c) 2012 Database Group, Computer Sciences Department, University of Wisconsin-Madison.
+ */
+
+/**
+ * YCSB-style workload driver for the buffer manager.
+ *
+ * Loads a number of fixed-size records, spread round-robin over several
+ * files, and then runs a mix of reads, updates, inserts and short scans
+ * against them from several threads.  Keys are picked uniformly, from a
+ * Zipfian distribution, or favouring the most recently inserted keys.  At the
+ * end the driver prints throughput, the buffer pool hit ratio, page I/O and
+ * latency percentiles for each kind of operation.
+ *
+ * BufMgr is not thread-safe, so every operation holds one lock while it
+ * touches the buffer pool.  Threads therefore overlap only in key generation
+ * and in waiting for the lock; the latencies reported include that wait, as a
+ * client would see it.
+ *
+ * The --workload presets follow the YCSB core workloads:
+ *   a  50% reads, 50% updates, zipfian
+ *   b  95% reads, 5% updates, zipfian
+ *   c  100% reads, zipfian
+ *   d  95% reads, 5% inserts, latest
+ *   e  95% scans, 5% inserts, zipfian
+ *   f  50% reads, 50% read-modify-writes, zipfian
+ * Options given after --workload override the preset.  --device emulates
+ * the latency of a storage device under every file.
+ *
+ * Usage:
+ *   badgerdb_ycsb [--workload a|b|c|d|e|f] [--records N] [--operations N]
+ *                 [--record-size N] [--files N] [--frames N] [--threads N]
+ *                 [--distribution uniform|zipfian|latest] [--theta T]
+ *                 [--read-ratio R] [--update-ratio R] [--insert-ratio R]
+ *                 [--scan-ratio R] [--scan-length N] [--seed S]
+ *                 [--device nvme|sata|hdd] [--in-memory yes|no]
+ */
+
+#include <atomic>
+#include <cstdio>
+#include <cstdlib>
+#include <iomanip>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <random>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "buffer.h"
+#include "cycle_clock.h"
+#include "file.h"
+#include "latency_backend.h"
+#include "latency_histogram.h"
+#include "page.h"
+#include "exceptions/file_not_found_exception.h"
+#include "tools/key_distributions.h"
+
+using namespace badgerdb;
+
+namespace {
+
+/**
+ * Kinds of operations in a workload.
+ */
+enum OpType {
+  OP_READ = 0,
+  OP_UPDATE = 1,
+  OP_INSERT = 2,
+  OP_SCAN = 3,
+  OP_READ_MODIFY_WRITE = 4,
+  NUM_OP_TYPES = 5
+};
+
+const char* const OP_NAMES[NUM_OP_TYPES] = {"read", "update", "insert",
+                                            "scan", "rmw"};
+
+/**
+ * Parameters of a run.
+ */
+struct WorkloadConfig {
+  std::uint64_t records;
+  std::uint64_t operations;
+  std::size_t record_size;
+  std::uint32_t files;
+  std::uint32_t frames;
+  std::uint32_t threads;
+  std::string distribution;
+  double theta;
+  double ratios[NUM_OP_TYPES];
+  std::uint64_t scan_length;
+  std::uint64_t seed;
+  bool in_memory;
+};
+
+/**
+ * State shared by all threads.  Everything but loaded_keys is protected by
+ * lock.
+ */
+struct Database {
+  std::mutex lock;
+  std::unique_ptr<BufMgr> buf_mgr;
+  std::vector<std::unique_ptr<File> > files;
+
+  /**
+   * Location of every record by key; key k lives in file k % files.
+   */
+  std::vector<RecordId> records;
+
+  /**
+   * Page inserts go to in each file.
+   */
+  std::vector<PageId> tail_pages;
+
+  /**
+   * Number of records inserted; keys are handed out in order under the lock,
+   * so every key below this one exists.
+   */
+  std::atomic<std::uint64_t> loaded_keys;
+};
+
+std::string fileName(const std::uint32_t file) {
+  std::ostringstream name;
+  name << "ycsb." << file;
+  return name.str();
+}
+
+/**
+ * Builds the record of a key; it starts with the key so reads can be checked.
+ */
+std::string makeRecord(const std::uint64_t key, const std::size_t size,
+                       const char fill) {
+  char prefix[32];
+  std::snprintf(prefix, sizeof(prefix), "user%016llu",
+                static_cast<unsigned long long>(key));
+  std::string record(prefix);
+  record.resize(size < record.size() ? record.size() : size, fill);
+  return record;
+}
+
+bool recordMatchesKey(const std::string& record, const std::uint64_t key) {
+  char prefix[32];
+  std::snprintf(prefix, sizeof(prefix), "user%016llu",
+                static_cast<unsigned long long>(key));
+  return record.compare(0, std::string(prefix).size(), prefix) == 0;
+}
+
+/**
+ * Appends the record of the next key to the tail page of its file, starting a
+ * new page when the tail is full.  Must be called with the lock held.
+ */
+void insertRecord(Database* db, const std::size_t record_size,
+                  const char fill) {
+  const std::uint64_t key = db->records.size();
+  const std::string record = makeRecord(key, record_size, fill);
+  const std::uint32_t file_no = key % db->files.size();
+  File* file = db->files[file_no].get();
+  Page* page;
+  PageId page_no = db->tail_pages[file_no];
+  bool fits = false;
+  if (page_no != Page::INVALID_NUMBER) {
+    db->buf_mgr->readPage(file, page_no, page);
+    fits = page->hasSpaceForRecord(record);
+    if (!fits) {
+      db->buf_mgr->unPinPage(file, page_no, false);
+    }
+  }
+  if (!fits) {
+    db->buf_mgr->allocPage(file, page_no, page);
+    db->tail_pages[file_no] = page_no;
+  }
+  db->records.push_back(page->insertRecord(record));
+  db->buf_mgr->unPinPage(file, page_no, true);
+}
+
+/**
+ * Operation mix and key chooser of one thread.
+ */
+class Workload {
+ public:
+  Workload(const WorkloadConfig& config, const std::uint64_t seed)
+      : config_(config),
+        rng_(seed),
+        zipfian_(config.records, config.theta,
+                 config.distribution == "zipfian" /* scrambled */) {}
+
+  OpType nextOp() {
+    double choice = std::uniform_real_distribution<double>(0.0, 1.0)(rng_);
+    for (int op = 0; op < NUM_OP_TYPES; ++op) {
+      if (choice < config_.ratios[op]) {
+        return static_cast<OpType>(op);
+      }
+      choice -= config_.ratios[op];
+    }
+    return OP_READ;
+  }
+
+  /**
+   * Picks an existing key.
+   *
+   * @param loaded  Number of keys inserted so far.
+   */
+  std::uint64_t nextKey(const std::uint64_t loaded) {
+    std::uint64_t key;
+    if (config_.distribution == "uniform") {
+      key = std::uniform_int_distribution<std::uint64_t>(0, loaded - 1)(rng_);
+    } else if (config_.distribution == "latest") {
+      // Most popular key is the latest one inserted.
+      const std::uint64_t back = zipfian_.next(rng_);
+      key = back < loaded ? loaded - 1 - back : 0;
+    } else {
+      key = zipfian_.next(rng_);
+    }
+    return key < loaded ? key : loaded - 1;
+  }
+
+  std::uint64_t nextScanLength() {
+    return std::uniform_int_distribution<std::uint64_t>(
+        1, config_.scan_length)(rng_);
+  }
+
+  char nextFill() {
+    return 'a' + std::uniform_int_distribution<int>(0, 25)(rng_);
+  }
+
+ private:
+  const WorkloadConfig& config_;
+  std::mt19937_64 rng_;
+  ZipfianGenerator zipfian_;
+};
+
+/**
+ * Results of one thread.
+ */
+struct ThreadResult {
+  LatencyHistogram latency[NUM_OP_TYPES];
+  std::uint64_t bad_records;
+};
+
+/**
+ * Reads a record, replaces it with one of the same size, or both.  Returns
+ * false if a record read did not hold the expected key.
+ */
+bool accessRecord(Database* db, const std::uint64_t key, const bool read,
+                  const bool update, const std::string& new_record) {
+  File* file = db->files[key % db->files.size()].get();
+  const RecordId rid = db->records[key];
+  Page* page;
+  db->buf_mgr->readPage(file, rid.page_number, page);
+  const bool good = !read || recordMatchesKey(page->getRecord(rid), key);
+  if (update) {
+    page->updateRecord(rid, new_record);
+  }
+  db->buf_mgr->unPinPage(file, rid.page_number, update);
+  return good;
+}
+
+void runThread(Database* db, const WorkloadConfig& config,
+               const std::uint64_t operations, const std::uint32_t thread,
+               ThreadResult* result) {
+  Workload workload(config, config.seed + thread + 1);
+  result->bad_records = 0;
+  for (std::uint64_t i = 0; i < operations; ++i) {
+    const OpType op = workload.nextOp();
+    const std::uint64_t start = readCycleCounter();
+    if (op == OP_INSERT) {
+      const char fill = workload.nextFill();
+      std::lock_guard<std::mutex> guard(db->lock);
+      insertRecord(db, config.record_size, fill);
+      ++db->loaded_keys;
+    } else {
+      const std::uint64_t loaded = db->loaded_keys;
+      const std::uint64_t key = workload.nextKey(loaded);
+      if (op == OP_SCAN) {
+        // Consecutive records of one file, in the order they were loaded.
+        const std::uint64_t length = workload.nextScanLength();
+        std::lock_guard<std::mutex> guard(db->lock);
+        for (std::uint64_t j = 0; j < length; ++j) {
+          const std::uint64_t scan_key = key + j * db->files.size();
+          if (scan_key >= db->records.size()) {
+            break;
+          }
+          if (!accessRecord(db, scan_key, true, false, std::string())) {
+            ++result->bad_records;
+          }
+        }
+      } else {
+        const bool update = op != OP_READ;
+        const std::string record =
+            update ? makeRecord(key, config.record_size, workload.nextFill())
+                   : std::string();
+        std::lock_guard<std::mutex> guard(db->lock);
+        if (!accessRecord(db, key, op != OP_UPDATE, update, record)) {
+          ++result->bad_records;
+        }
+      }
+    }
+    result->latency[op].record(readCycleCounter() - start);
+  }
+}
+
+void setPreset(WorkloadConfig* config, const std::string& workload) {
+  for (int op = 0; op < NUM_OP_TYPES; ++op) {
+    config->ratios[op] = 0;
+  }
+  config->distribution = "zipfian";
+  if (workload == "a") {
+    config->ratios[OP_READ] = 0.5;
+    config->ratios[OP_UPDATE] = 0.5;
+  } else if (workload == "b") {
+    config->ratios[OP_READ] = 0.95;
+    config->ratios[OP_UPDATE] = 0.05;
+  } else if (workload == "c") {
+    config->ratios[OP_READ] = 1.0;
+  } else if (workload == "d") {
+    config->ratios[OP_READ] = 0.95;
+    config->ratios[OP_INSERT] = 0.05;
+    config->distribution = "latest";
+  } else if (workload == "e") {
+    config->ratios[OP_SCAN] = 0.95;
+    config->ratios[OP_INSERT] = 0.05;
+  } else {
+    config->ratios[OP_READ] = 0.5;
+    config->ratios[OP_READ_MODIFY_WRITE] = 0.5;
+  }
+}
+
+void usage() {
+  std::cerr
+      << "Usage: badgerdb_ycsb [--workload a|b|c|d|e|f] [--records N]"
+      << " [--operations N]\n"
+      << "         [--record-size N] [--files N] [--frames N] [--threads N]\n"
+      << "         [--distribution uniform|zipfian|latest] [--theta T]\n"
+      << "         [--read-ratio R] [--update-ratio R] [--insert-ratio R]\n"
+      << "         [--scan-ratio R] [--scan-length N] [--seed S]\n"
+      << "         [--device nvme|sata|hdd] [--in-memory yes|no]\n";
+}
+
+}
+
+int main(int argc, char* argv[]) {
+  WorkloadConfig config;
+  config.records = 100000;
+  config.operations = 1000000;
+  config.record_size = 100;
+  config.files = 4;
+  config.frames = 1000;
+  config.threads = 4;
+  config.theta = 0.99;
+  config.scan_length = 100;
+  config.seed = 42;
+  config.in_memory = false;
+  setPreset(&config, "a");
+
+  for (int i = 1; i < argc; ++i) {
+    const std::string arg = argv[i];
+    if (i + 1 >= argc) {
+      usage();
+      return 1;
+    }
+    const std::string value = argv[++i];
+    if (arg == "--workload") {
+      setPreset(&config, value);
+    } else if (arg == "--records") {
+      config.records = std::strtoull(value.c_str(), NULL, 10);
+    } else if (arg == "--operations") {
+      config.operations = std::strtoull(value.c_str(), NULL, 10);
+    } else if (arg == "--record-size") {
+      config.record_size = std::strtoul(value.c_str(), NULL, 10);
+    } else if (arg == "--files") {
+      config.files = std::strtoul(value.c_str(), NULL, 10);
+    } else if (arg == "--frames") {
+      config.frames = std::strtoul(value.c_str(), NULL, 10);
+    } else if (arg == "--threads") {
+      config.threads = std::strtoul(value.c_str(), NULL, 10);
+    } else if (arg == "--distribution") {
+      config.distribution = value;
+    } else if (arg == "--theta") {
+      config.theta = std::strtod(value.c_str(), NULL);
+    } else if (arg == "--read-ratio") {
+      config.ratios[OP_READ] = std::strtod(value.c_str(), NULL);
+    } else if (arg == "--update-ratio") {
+      config.ratios[OP_UPDATE] = std::strtod(value.c_str(), NULL);
+    } else if (arg == "--insert-ratio") {
+      config.ratios[OP_INSERT] = std::strtod(value.c_str(), NULL);
+    } else if (arg == "--scan-ratio") {
+      config.ratios[OP_SCAN] = std::strtod(value.c_str(), NULL);
+    } else if (arg == "--scan-length") {
+      config.scan_length = std::strtoull(value.c_str(), NULL, 10);
+    } else if (arg == "--seed") {
+      config.seed = std::strtoull(value.c_str(), NULL, 10);
+    } else if (arg == "--device") {
+      LatencyProfile profile;
+      if (!LatencyProfile::byName(value, profile)) {
+        usage();
+        return 1;
+      }
+      File::setBackendDecorator(LatencyBackend::decorator(profile));
+    } else if (arg == "--in-memory") {
+      config.in_memory = value == "yes";
+    } else {
+      usage();
+      return 1;
+    }
+  }
+  if (config.records == 0 || config.files == 0 || config.threads == 0 ||
+      config.scan_length == 0 || config.frames <= config.files) {
+    usage();
+    return 1;
+  }
+
+  Database db;
+  for (std::uint32_t f = 0; f < config.files; ++f) {
+    try {
+      File::remove(fileName(f));
+    } catch (FileNotFoundException) {
+    }
+    db.files.push_back(
+        std::unique_ptr<File>(
+            new File(File::create(fileName(f), config.in_memory))));
+  }
+  db.buf_mgr.reset(new BufMgr(config.frames));
+  db.tail_pages.assign(config.files, PageId(Page::INVALID_NUMBER));
+  db.records.reserve(config.records);
+
+  // Load phase.
+  for (std::uint64_t key = 0; key < config.records; ++key) {
+    insertRecord(&db, config.record_size, 'a' + key % 26);
+  }
+  db.loaded_keys = config.records;
+  db.buf_mgr->checkpoint();
+
+  // Run phase.
+  const BufStats before = db.buf_mgr->snapshotBufStats();
+  const std::map<std::string, FileStats> files_before = File::openFileStats();
+  std::vector<ThreadResult> results(config.threads);
+  std::vector<std::thread> threads;
+  const std::uint64_t start = readCycleCounter();
+  for (std::uint32_t t = 0; t < config.threads; ++t) {
+    const std::uint64_t operations =
+        config.operations / config.threads +
+        (t < config.operations % config.threads ? 1 : 0);
+    threads.push_back(
+        std::thread(runThread, &db, std::cref(config), operations, t,
+                    &results[t]));
+  }
+  for (std::size_t t = 0; t < threads.size(); ++t) {
+    threads[t].join();
+  }
+  const double seconds =
+      (readCycleCounter() - start) / cyclesPerNanosecond() / 1e9;
+  const BufStats run = db.buf_mgr->snapshotBufStats().delta(before);
+  const std::map<std::string, FileStats> files_after = File::openFileStats();
+
+  LatencyHistogram latency[NUM_OP_TYPES];
+  std::uint64_t bad_records = 0;
+  for (std::size_t t = 0; t < results.size(); ++t) {
+    for (int op = 0; op < NUM_OP_TYPES; ++op) {
+      latency[op].merge(results[t].latency[op]);
+    }
+    bad_records += results[t].bad_records;
+  }
+  std::uint64_t page_reads = 0;
+  std::uint64_t page_writes = 0;
+  for (std::map<std::string, FileStats>::const_iterator it =
+           files_after.begin();
+       it != files_after.end(); ++it) {
+    const FileStats& earlier = files_before.find(it->first)->second;
+    page_reads += it->second.page_reads - earlier.page_reads;
+    page_writes += it->second.page_writes - earlier.page_writes;
+  }
+
+  std::cout << std::fixed << std::setprecision(2);
+  std::cout << "operations     " << config.operations << "\n"
+            << "threads        " << config.threads << "\n"
+            << "seconds        " << seconds << "\n"
+            << "ops/sec        " << config.operations / seconds << "\n"
+            << "hit ratio      " << 100.0 * run.hitRatio() << "%\n"
+            << "buffer reads   " << run.diskreads << "\n"
+            << "buffer writes  " << run.diskwrites << "\n"
+            << "file reads     " << page_reads << "\n"
+            << "file writes    " << page_writes << "\n";
+  if (bad_records != 0) {
+    std::cout << "BAD RECORDS    " << bad_records << "\n";
+  }
+  std::cout << "\n"
+            << std::left << std::setw(8) << "op" << std::right
+            << std::setw(10) << "count" << std::setw(11) << "p50 us"
+            << std::setw(11) << "p95 us" << std::setw(11) << "p99 us"
+            << std::setw(11) << "p999 us" << std::setw(11) << "max us"
+            << "\n";
+  for (int op = 0; op < NUM_OP_TYPES; ++op) {
+    if (latency[op].count() == 0) {
+      continue;
+    }
+    std::cout << std::left << std::setw(8) << OP_NAMES[op] << std::right
+              << std::setw(10) << latency[op].count() << std::setw(11)
+              << latency[op].percentileNanos(0.50) / 1000 << std::setw(11)
+              << latency[op].percentileNanos(0.95) / 1000 << std::setw(11)
+              << latency[op].percentileNanos(0.99) / 1000 << std::setw(11)
+              << latency[op].percentileNanos(0.999) / 1000 << std::setw(11)
+              << latency[op].max() / cyclesPerNanosecond() / 1000 << "\n";
+  }
+
+  db.buf_mgr.reset();
+  for (std::uint32_t f = 0; f < config.files; ++f) {
+    db.files[f].reset();
+    File::remove(fileName(f));
+  }
+  return bad_records == 0 ? 0 : 1;
+}
@@ -24,6 +24,17 @@ typedef std::uint16_t SlotId;
  */
 typedef std::uint32_t FrameId;
 
+/**
+ * @brief Identifier for a file backed by a stream on disk.
+ */
+typedef std::uint32_t FileId;
+
+/**
+ * @brief Log sequence number: position in a write-ahead log just past a log
+ *        record.
+ */
+typedef std::uint64_t Lsn;
+
 /**
  * @brief Identifier for a record in a page.
  */